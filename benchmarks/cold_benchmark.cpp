@@ -54,21 +54,15 @@ int main(int argc, char ** argv)
   auto start = std::chrono::high_resolution_clock::now();
   for(int i = 0; i < settings.benchmark.repetitions;++i) {
 
-    // Allow the lease information to be propagated
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-
     spdlog::info("Begin iteration {}", i);
 
-    auto leased_executor = instance.lease(settings.benchmark.numcores, settings.benchmark.memory, *settings.device);
+    auto leased_executor = instance.lease(settings.benchmark.numcores, settings.benchmark.memory, *settings.device, opts.flib);
     if (!leased_executor.has_value()) {
       spdlog::error("Couldn't acquire a lease!");
       return 1;
     }
     rfaas::executor executor = std::move(leased_executor.value());
 
-    // Allow the lease information to be propagated
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-
     std::vector<rdmalib::Buffer<char>> in;
     std::vector<rdmalib::Buffer<char>> out;
     for(int i = 0; i < settings.benchmark.numcores; ++i) {
@@ -46,7 +46,7 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  auto leased_executor = instance.lease(settings.benchmark.numcores, settings.benchmark.memory, *settings.device);
+  auto leased_executor = instance.lease(settings.benchmark.numcores, settings.benchmark.memory, *settings.device, opts.flib);
   if (!leased_executor.has_value()) {
     spdlog::error("Couldn't acquire a lease!");
     return 1;
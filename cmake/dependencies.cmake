@@ -53,7 +53,7 @@ endif()
 ###
 # google test
 ###
-if(${RFAAS_WITH_TESTING})
+if(${RFAAS_WITH_TESTING} OR ${RFAAS_WITH_UNIT_TESTS})
   include(FetchContent)
   message(STATUS "Downloading and building gtest")
   FetchContent_Declare(
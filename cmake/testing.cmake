@@ -81,4 +81,3 @@ foreach(target ${tests_targets})
   #set_tests_properties(${target} PROPERTIES FIXTURES_REQUIRED localserver)
 endforeach()
 
-
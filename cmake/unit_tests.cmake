@@ -0,0 +1,52 @@
+
+enable_testing()
+include(GoogleTest)
+
+###
+# Unit tests of the resource manager - nodes are not connected to executor managers.
+###
+add_library(
+  resource_manager_testlib STATIC
+  server/resource_manager/executor.cpp
+  server/resource_manager/capacity_index.cpp
+  server/resource_manager/placement.cpp
+  server/resource_manager/journal.cpp
+  server/resource_manager/db.cpp
+  server/resource_manager/lease_queue.cpp
+)
+add_dependencies(resource_manager_testlib rfaaslib)
+target_include_directories(resource_manager_testlib PUBLIC server/)
+target_include_directories(resource_manager_testlib PUBLIC $<TARGET_PROPERTY:rfaaslib,INTERFACE_INCLUDE_DIRECTORIES>)
+target_include_directories(resource_manager_testlib PUBLIC $<TARGET_PROPERTY:rdmalib,INTERFACE_INCLUDE_DIRECTORIES>)
+target_link_libraries(resource_manager_testlib PUBLIC spdlog::spdlog)
+target_link_libraries(resource_manager_testlib PUBLIC rdmalib)
+target_link_libraries(resource_manager_testlib PUBLIC rfaaslib)
+target_link_libraries(resource_manager_testlib PUBLIC Threads::Threads)
+
+add_executable(
+  capacity_index_test
+  tests/capacity_index_test.cpp
+)
+add_executable(
+  placement_test
+  tests/placement_test.cpp
+)
+add_executable(
+  executor_db_test
+  tests/executor_db_test.cpp
+)
+add_executable(
+  journal_test
+  tests/journal_test.cpp
+)
+add_executable(
+  lease_queue_test
+  tests/lease_queue_test.cpp
+)
+
+set(unit_tests_targets "capacity_index_test" "placement_test" "executor_db_test" "journal_test" "lease_queue_test")
+foreach(target ${unit_tests_targets})
+  target_link_libraries(${target} PRIVATE resource_manager_testlib gtest_main)
+  set_target_properties(${target} PROPERTIES RUNTIME_OUTPUT_DIRECTORY tests)
+  gtest_discover_tests(${target})
+endforeach()
@@ -8,8 +8,8 @@ extern "C" uint32_t thumbnailer(void* args, uint32_t size, void* res)
 {
   char* input = static_cast<char*>(args);
   char * output = static_cast<char*>(res);
-  std::vector<unsigned char> vectordata(input, input + size);
-  cv::Mat image = imdecode(cv::Mat(vectordata), 1);
+  // Decode directly from the input buffer - no copy.
+  cv::Mat image = imdecode(cv::Mat(1, size, CV_8UC1, input), 1);
   cv::Mat image2;
   thumbnailer(image, image2);
   //fprintf(stderr, "%d %d\n", image2.rows, image2.cols);
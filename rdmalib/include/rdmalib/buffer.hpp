@@ -34,8 +34,8 @@ namespace rdmalib {
       bool _own_memory;
 
       Buffer();
-      Buffer(void* ptr, uint32_t size, uint32_t byte_size);
-      Buffer(uint32_t size, uint32_t byte_size, uint32_t header);
+      Buffer(void* ptr, size_t size, size_t byte_size);
+      Buffer(size_t size, size_t byte_size, size_t header);
       Buffer(Buffer &&);
       Buffer & operator=(Buffer && obj);
       ~Buffer();
@@ -50,6 +50,9 @@ namespace rdmalib {
       uint32_t lkey() const;
       uint32_t rkey() const;
       ScatterGatherElement sge(uint32_t size, uint32_t offset) const;
+
+      // Memory regions and SGEs have 32-bit lengths.
+      static uint32_t checked_bytes(size_t elements, size_t byte_size, size_t header = 0);
     };
 
   }
@@ -154,7 +157,7 @@ namespace rdmalib {
     void add(const Buffer<T> & buf, int elements)
     {
       //emplace_back for structs will be supported in C++20
-      _sges.push_back({buf.address(), sizeof(T) * elements, buf.lkey()});
+      _sges.push_back({buf.address(), impl::Buffer::checked_bytes(elements, sizeof(T)), buf.lkey()});
     }
 
     template<typename T>
@@ -149,6 +149,7 @@ namespace rdmalib {
       bool force_inline = false,
       bool solicited = false
     );
+    int32_t post_read(ScatterGatherElement && elems, const RemoteBuffer & buf);
     int32_t post_cas(ScatterGatherElement && elems, const RemoteBuffer & buf, uint64_t compare, uint64_t swap);
     int32_t post_atomic_fadd(ScatterGatherElement && elems, const RemoteBuffer & rbuf, uint64_t add);
 
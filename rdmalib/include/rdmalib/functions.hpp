@@ -2,6 +2,7 @@
 #ifndef __RDMALIB_FUNCTIONS_HPP__
 #define __RDMALIB_FUNCTIONS_HPP__
 
+#include <cstdint>
 #include <unordered_map>
 #include <string>
 
@@ -15,6 +16,62 @@ namespace rdmalib { namespace functions {
 
   constexpr int Submission::DATA_HEADER_SIZE;
 
+  // Functions executed back to back on the same executor thread, as a single invocation.
+  // Intermediate results stay on the executor; only the final output is written back.
+  // Submitted with FUNCTION_ID instead of the function index.
+  // The chain is stored at the beginning of the payload, and the input follows it.
+  struct Chain {
+    static constexpr int MAX_LENGTH = 7;
+    static constexpr uint32_t FUNCTION_ID = 0x7FFF;
+    uint16_t length;
+    uint16_t functions[MAX_LENGTH];
+  };
+
+  // Output of a function written by the executor directly to the input buffer of
+  // a downstream executor thread, connected before with PEER_LISTEN and PEER_CONNECT.
+  // The client receives only an empty completion notice from the upstream executor,
+  // and the result of the downstream function is written to r_address.
+  // The downstream thread has a single input buffer for forwarded invocations - the upstream
+  // thread waits for a credit, a send without data, before writing the next one.
+  // Submitted with FUNCTION_ID; the descriptor is stored at the beginning of the payload.
+  struct Forward {
+    static constexpr uint32_t FUNCTION_ID = 0x7FFE;
+    // Output buffer of the downstream function, registered with the downstream PD.
+    uint64_t r_address;
+    uint32_t r_key;
+    // Function executed on this thread.
+    uint16_t function;
+    // Immediate value of the downstream invocation.
+    uint32_t submission;
+  };
+
+  // Control invocations connecting two executor threads.
+  // The downstream thread opens a listener and replies with PeerInformation,
+  // then the client passes it as the payload of PEER_CONNECT to the upstream thread.
+  constexpr uint32_t PEER_LISTEN = 0x7FFD;
+  constexpr uint32_t PEER_CONNECT = 0x7FFC;
+
+  struct PeerInformation {
+    char address[16];
+    uint32_t port;
+    uint32_t r_key;
+    uint64_t r_addr;
+  };
+
+  // Control invocations are not counted as executions of the lease.
+  inline bool is_control(uint32_t func_id)
+  {
+    return func_id == PEER_LISTEN || func_id == PEER_CONNECT;
+  }
+
+  // Return value of an invocation with invalid function indices.
+  constexpr uint32_t INVALID_INVOCATION = 2;
+
+  // The functions library is transferred once per executor process.
+  // The executor thread receiving it connects with this private data,
+  // and the client sends the code only over that connection.
+  constexpr uint32_t LIBRARY_RECEIVER = 1;
+
 
   typedef void (*FuncType)(void*, void*);
 
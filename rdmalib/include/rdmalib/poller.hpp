@@ -2,9 +2,13 @@
 #ifndef __RDMALIB_COMPLETION_POLLER_HPP__
 #define __RDMALIB_COMPLETION_POLLER_HPP__
 
+#include <atomic>
+#include <chrono>
 #include <fcntl.h>
+#include <functional>
 #include <iostream>
 #include <ostream>
+#include <vector>
 #include <sys/epoll.h>
 
 #include <infiniband/verbs.h>
@@ -106,6 +110,20 @@ namespace rdmalib {
       return true;
     }
 
+    // Any other pollable file descriptor, e.g., an eventfd.
+    bool add_fd(int fd, uint32_t data)
+    {
+      epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.u32 = data;
+
+      if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        spdlog::error("Failed to add a file descriptor to epoll, fd: {}", fd);
+        return false;
+      }
+      return true;
+    }
+
     std::tuple<epoll_event*, int> poll(int timeout_ms)
     {
       int events = epoll_wait(_epoll_fd, _events.data(), MAX_EVENTS, timeout_ms);
@@ -121,6 +139,97 @@ namespace rdmalib {
     std::array<epoll_event, MAX_EVENTS> _events;
   };
 
+  // Runs handlers of completion queues and other event sources on a single thread.
+  // Handlers are called in the order of registration, and return the number of processed events.
+  // While there is work, the queues are polled without blocking. After spin_us without any work,
+  // CQ notifications are armed and the thread sleeps in epoll until an event or the timeout.
+  struct Reactor {
+
+    typedef std::function<int()> handler_t;
+
+    Reactor(int spin_us):
+      _spin(spin_us)
+    {}
+
+    // The CQ of the poller must have a completion channel.
+    bool add_channel(Poller & poller, handler_t && handler)
+    {
+      if(!_events.add_channel(poller, _sources.size()))
+        return false;
+      _sources.push_back({&poller, std::move(handler)});
+      return true;
+    }
+
+    // The descriptor only wakes up the reactor; the handler is called on every iteration.
+    bool add_fd(int fd, handler_t && handler)
+    {
+      if(!_events.add_fd(fd, _sources.size()))
+        return false;
+      _sources.push_back({nullptr, std::move(handler)});
+      return true;
+    }
+
+    // Sources without a descriptor, e.g., queues of new connections.
+    void add_task(handler_t && handler)
+    {
+      _sources.push_back({nullptr, std::move(handler)});
+    }
+
+    void run(const std::atomic<bool> & shutdown, int timeout_ms)
+    {
+      auto last_work = std::chrono::steady_clock::now();
+      while(!shutdown.load()) {
+
+        if(_process()) {
+          last_work = std::chrono::steady_clock::now();
+          continue;
+        }
+        if(std::chrono::steady_clock::now() - last_work < _spin)
+          continue;
+
+        // Completions that arrived before arming do not generate an event.
+        for(auto & source : _sources)
+          if(source.poller)
+            source.poller->notify_events(false);
+        if(_process()) {
+          last_work = std::chrono::steady_clock::now();
+          continue;
+        }
+
+        auto [events, count] = _events.poll(timeout_ms);
+        for(int i = 0; i < count; ++i) {
+          Poller* poller = _sources[events[i].data.u32].poller;
+          if(!poller)
+            continue;
+          ibv_cq* cq = poller->wait_events();
+          if(cq)
+            poller->ack_events(cq, 1);
+        }
+        last_work = std::chrono::steady_clock::now();
+      }
+    }
+
+  private:
+
+    struct Source
+    {
+      Poller* poller;
+      handler_t handler;
+    };
+
+    EventPoller _events;
+    std::vector<Source> _sources;
+    std::chrono::microseconds _spin;
+
+    int _process()
+    {
+      int work = 0;
+      for(auto & source : _sources)
+        work += source.handler();
+      return work;
+    }
+  };
+
 } // namespace rdmalib
 
 #endif
@@ -46,11 +46,11 @@ namespace rdmalib { namespace impl {
     return *this;
   }
 
-  Buffer::Buffer(uint32_t size, uint32_t byte_size, uint32_t header):
-    _size(size),
-    _header(header),
-    _bytes(size * byte_size + header),
-    _byte_size(byte_size),
+  Buffer::Buffer(size_t size, size_t byte_size, size_t header):
+    _size(static_cast<uint32_t>(size)),
+    _header(static_cast<uint32_t>(header)),
+    _bytes(checked_bytes(size, byte_size, header)),
+    _byte_size(static_cast<uint32_t>(byte_size)),
     _mr(nullptr),
     _own_memory(true)
   {
@@ -67,11 +67,11 @@ namespace rdmalib { namespace impl {
     );
   }
 
-  Buffer::Buffer(void* ptr, uint32_t size, uint32_t byte_size):
-    _size(size),
+  Buffer::Buffer(void* ptr, size_t size, size_t byte_size):
+    _size(static_cast<uint32_t>(size)),
     _header(0),
-    _bytes(size * byte_size),
-    _byte_size(byte_size),
+    _bytes(checked_bytes(size, byte_size)),
+    _byte_size(static_cast<uint32_t>(byte_size)),
     _ptr(ptr),
     _mr(nullptr),
     _own_memory(false)
@@ -82,6 +82,13 @@ namespace rdmalib { namespace impl {
     );
   }
   
+  uint32_t Buffer::checked_bytes(size_t elements, size_t byte_size, size_t header)
+  {
+    bool fits = header <= UINT32_MAX && (!byte_size || elements <= (UINT32_MAX - header) / byte_size);
+    expect_true(fits, false, "Buffer size exceeds 32 bits");
+    return static_cast<uint32_t>(elements * byte_size + header);
+  }
+
   Buffer::~Buffer()
   {
     SPDLOG_DEBUG(
@@ -173,10 +173,15 @@ namespace rdmalib {
       );
       return -1;
     }
-    SPDLOG_DEBUG(
-      "Post send succesfull, sges_count {}, sge[0].addr {}, sge[0].size {}, wr_id {}, wr.send_flags {}",
-      wr.num_sge, wr.sg_list[0].addr, wr.sg_list[0].length, wr.wr_id, wr.send_flags
-    );
+    // Sends without data only carry the immediate value.
+    if(wr.num_sge > 0) {
+      SPDLOG_DEBUG(
+        "Post send succesfull, sges_count {}, sge[0].addr {}, sge[0].size {}, wr_id {}, wr.send_flags {}",
+        wr.num_sge, wr.sg_list[0].addr, wr.sg_list[0].length, wr.wr_id, wr.send_flags
+      );
+    } else {
+      SPDLOG_DEBUG("Post send succesfull, no sges, wr_id {}, wr.send_flags {}", wr.wr_id, wr.send_flags);
+    }
     return _req_count - 1;
   }
 
@@ -269,6 +274,30 @@ namespace rdmalib {
     return _post_write(std::forward<ScatterGatherElement>(elems), wr, force_inline, force_solicited);
   }
 
+  int32_t Connection::post_read(ScatterGatherElement && elems, const RemoteBuffer & rbuf)
+  {
+    ibv_send_wr wr, *bad;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = _req_count++;
+    wr.next = nullptr;
+    wr.sg_list = elems.array();
+    wr.num_sge = elems.size();
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = rbuf.addr;
+    wr.wr.rdma.rkey = rbuf.rkey;
+
+    int ret = ibv_post_send(_qp, &wr, &bad);
+    if(ret) {
+      spdlog::error("Post read unsuccesful, reason {} {}", errno, strerror(errno));
+      return -1;
+    }
+    SPDLOG_DEBUG(
+        "Post read succesfull id: {}, remote addr {}, remote rkey {}", wr.wr_id,  wr.wr.rdma.remote_addr, wr.wr.rdma.rkey
+    );
+    return _req_count - 1;
+  }
+
   int32_t Connection::post_cas(ScatterGatherElement && elems, const RemoteBuffer & rbuf, uint64_t compare, uint64_t swap)
   {
     ibv_send_wr wr, *bad;
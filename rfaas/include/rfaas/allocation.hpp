@@ -2,32 +2,111 @@
 #ifndef __RFAAS_ALLOCATION_HPP__
 #define __RFAAS_ALLOCATION_HPP__
 
+#include <climits>
 #include <cstdint>
 
 namespace rfaas {
 
   struct LeaseRequest {
+    // Requests sent together in one message, answered with a single LeaseBatchResponse.
+    static constexpr int MAX_BATCH = 16;
+    // Sent by other shards of the resource manager to release a lease granted after they stopped waiting.
+    static constexpr int16_t CANCEL = -2;
+
     // > 0: Number of cores to be allocated
+    // CANCEL: release of lease_id, accepted only from other shards
     // < 0: client_id with negative sign, deallocation & disconnect request
     int16_t cores;
     int32_t memory;
+    // Content hash of the functions library, used for placement; 0 when unknown.
+    uint64_t func_hash;
+    // The lease can be split across up to this many nodes; 0 and 1 request a single node.
+    int16_t max_nodes;
+    // Time the request can wait in the resource manager for resources to be released;
+    // 0 answers immediately. Batches are always answered immediately.
+    int32_t wait_ms;
+    // Waiting requests of higher priority are granted first.
+    int16_t priority;
+    // Share of released resources among clients of the same priority; 0 counts as 1.
+    int16_t weight;
+    // Lease released by a CANCEL request.
+    int32_t lease_id;
   };
 
+  // Part of a lease placed on a single node, with its own lease ID for the executor manager.
   struct LeasedNode {
+    int32_t lease_id;
     int32_t port;
     int16_t cores;
+    int32_t memory;
     char address[16];
   };
 
   struct LeaseResponse {
+    static constexpr int MAX_NODES_PER_LEASE = 16;
 
+    // First node of the lease.
     int32_t lease_id;
     int32_t port;
     char address[16];
-    //LeasedNode nodes[MAX_NODES_PER_LEASE];
+    // All nodes of the lease, their number is sent as the immediate value.
+    LeasedNode nodes[MAX_NODES_PER_LEASE];
+  };
+
+  // Response to a batch of requests, each placed on a single node.
+  // The number of granted leases is sent as the immediate value,
+  // and requests that couldn't be satisfied have lease_id -1.
+  struct LeaseBatchResponse {
+    LeasedNode leases[LeaseRequest::MAX_BATCH];
+  };
+
+  // Received in the same buffers as single responses.
+  static_assert(sizeof(LeaseBatchResponse) <= sizeof(LeaseResponse), "Batch response must fit the response buffer");
+
+  // Slot of the capacity table exposed by the resource manager.
+  // Each node delegates some of its cores to the table, and clients claim them
+  // with RDMA compare-and-swap without involving the resource manager.
+  struct NodeCapacity {
+    // Free cores in the low 32 bits, and the epoch of the counter in the high 32 bits.
+    // Cores are taken by clients, and returned by the executor manager with RDMA fetch-and-add.
+    // The executor manager periodically resets the counter under a new epoch - cores claimed
+    // in an older epoch without a lease request are returned, and such requests are rejected.
+    uint64_t counter;
+    // Zero for empty slots and nodes that stopped sending heartbeats.
+    int32_t available;
+    int32_t port;
+    char address[16];
+
+    static uint64_t make_counter(uint32_t epoch, uint32_t cores)
+    {
+      return static_cast<uint64_t>(epoch) << 32 | cores;
+    }
+
+    static uint32_t cores(uint64_t counter)
+    {
+      return static_cast<uint32_t>(counter);
+    }
+
+    static uint32_t epoch(uint64_t counter)
+    {
+      return static_cast<uint32_t>(counter >> 32);
+    }
+  };
+
+  // Response to a request with zero cores; the immediate value is 1 when the table is enabled.
+  struct CapacityTableResponse {
+    uint64_t address;
+    uint32_t rkey;
+    // Slots in use start at the beginning of the table.
+    int32_t slots;
   };
 
+  static_assert(sizeof(CapacityTableResponse) <= sizeof(LeaseResponse), "Table response must fit the response buffer");
+
   struct AllocationRequest {
+    // Lease with cores claimed by the client from the capacity table.
+    static constexpr int32_t DIRECT_LEASE = INT32_MAX;
+
     // > 0: Lease identificator
     // < 0: client_id with negative sign, deallocation & disconnect request
     int32_t lease_id;
@@ -39,6 +118,13 @@ namespace rfaas {
     uint32_t func_buf_size;
     int32_t listen_port;
     char listen_address[16];
+    // Content hash of the functions library; 0 disables caching.
+    uint64_t func_hash;
+    // Resources of the lease, used by the executor manager only for direct leases.
+    int16_t cores;
+    int32_t memory;
+    // Epoch of the capacity counter in which the cores of a direct lease were claimed.
+    uint32_t claim_epoch;
   };
 
   struct LeaseStatus {
@@ -53,6 +139,9 @@ namespace rfaas {
     // = 4: Lease will be terminated soon
     // = 5: Executor crashed
     int32_t status;
+    // != 0: executor loads the library from the manager's cache,
+    // and the client must not send the code.
+    int32_t library_cached;
   };
 
 } // namespace rdmalib
@@ -2,6 +2,13 @@
 #ifndef __RFAAS_RFAAS_HPP__
 #define __RFAAS_RFAAS_HPP__
 
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <string>
+
+#include <unistd.h>
+
 #include <rdmalib/connection.hpp>
 #include <spdlog/spdlog.h>
 
@@ -9,6 +16,8 @@
 #include <rfaas/connection.hpp>
 #include <rfaas/devices.hpp>
 #include <rfaas/executor.hpp>
+#include <rfaas/executor_group.hpp>
+#include <rfaas/library.hpp>
 #include <rfaas/resources.hpp>
 
 namespace rfaas {
@@ -17,6 +26,9 @@ namespace rfaas {
 
     client(std::string address, int port, device_data & dev):
       _resource_mgr(address, port, dev.default_receive_buffer_size, dev.max_inline_data),
+      _wait_ms(0),
+      _priority(0),
+      _weight(1),
       _device(dev)
     {}
 
@@ -25,43 +37,153 @@ namespace rfaas {
       return _resource_mgr.connect();
     }
 
+    // Index of the resource manager shard this client should connect to.
+    // Clients are spread across shards by the hash of their host and process.
+    static int home_shard(int shards)
+    {
+      if(shards <= 1) {
+        return 0;
+      }
+      char hostname[HOST_NAME_MAX + 1] = {};
+      gethostname(hostname, HOST_NAME_MAX);
+      size_t hash = std::hash<std::string>{}(std::string{hostname} + ":" + std::to_string(getpid()));
+      return hash % shards;
+    }
+
     void disconnect()
     {
       _resource_mgr.disconnect();
     }
 
-    std::optional<rfaas::executor> lease(int16_t cores, int32_t memory, device_data & dev)
+    // Leases that can't be placed wait in the resource manager up to wait_ms,
+    // instead of failing immediately. The manager limits the waiting time and queue length.
+    void queue_leases(int32_t wait_ms, int16_t priority = 0, int16_t weight = 1)
+    {
+      _wait_ms = wait_ms;
+      _priority = priority;
+      _weight = weight;
+    }
+
+    // The library hash lets the resource manager prefer nodes that already hold the library.
+    std::optional<rfaas::executor> lease(int16_t cores, int32_t memory, device_data & dev, uint64_t func_hash = 0)
     { 
-      if(!_resource_mgr.connected()) {
-        return {};
+      int nodes = 0;
+      const rfaas::LeaseResponse* response = _request(cores, memory, func_hash, 1, nodes);
+      if(!response) {
+        return std::nullopt;
       }
 
-      _resource_mgr.request() = (rfaas::LeaseRequest) {
+      return rfaas::executor{
+        std::string{response->address},
+        response->port,
         cores,
-        memory
+        memory,
+        response->lease_id,
+        dev
       };
-      _resource_mgr.submit();
+    }
 
-      auto [responses, response_count] = _resource_mgr.connection().poll_wc(rdmalib::QueueType::RECV, true);
+    // The resource manager can split the cores across nodes when no single node has them.
+    std::optional<rfaas::executor_group> lease_group(int16_t cores, int32_t memory, device_data & dev, uint64_t func_hash = 0)
+    {
+      int nodes = 0;
+      const rfaas::LeaseResponse* response = _request(
+        cores, memory, func_hash, rfaas::LeaseResponse::MAX_NODES_PER_LEASE, nodes
+      );
+      if(!response) {
+        return std::nullopt;
+      }
 
-      if(response_count > 1) {
-        spdlog::warn("Received unexpected responses from resource manager, ignoring {} responses", response_count - 1);
+      std::vector<rfaas::executor> executors;
+      executors.reserve(nodes);
+      for(int i = 0; i < nodes; ++i) {
+        const rfaas::LeasedNode & node = response->nodes[i];
+        executors.emplace_back(std::string{node.address}, node.port, node.cores, node.memory, node.lease_id, dev);
+      }
+      return std::make_optional<rfaas::executor_group>(std::move(executors));
+    }
+
+    std::optional<rfaas::executor_group> lease_group(int16_t cores, int32_t memory, device_data & dev, const std::string & functions_path)
+    {
+      auto lib = libraries::instance().load(functions_path);
+      return lease_group(cores, memory, dev, lib ? lib->hash : 0);
+    }
+
+    // Sends the hash of the functions library that will be allocated on the executor.
+    std::optional<rfaas::executor> lease(int16_t cores, int32_t memory, device_data & dev, const std::string & functions_path)
+    {
+      auto lib = libraries::instance().load(functions_path);
+      return lease(cores, memory, dev, lib ? lib->hash : 0);
+    }
+
+    // Requests are sent in batches of up to MAX_BATCH, and each lease is placed on a single node.
+    // Requests that couldn't be satisfied have no executor.
+    std::vector<std::optional<rfaas::executor>> lease_batch(const std::vector<rfaas::LeaseRequest> & requests, device_data & dev)
+    {
+      std::vector<std::optional<rfaas::executor>> executors;
+      executors.reserve(requests.size());
+
+      for(size_t begin = 0; begin < requests.size(); begin += rfaas::LeaseRequest::MAX_BATCH) {
+
+        int count = std::min<size_t>(requests.size() - begin, rfaas::LeaseRequest::MAX_BATCH);
+        // The resource manager answers a single request with a regular response.
+        if(count == 1) {
+          const rfaas::LeaseRequest & request = requests[begin];
+          executors.push_back(lease(request.cores, request.memory, dev, request.func_hash));
+          continue;
+        }
+
+        const rfaas::LeaseBatchResponse* response = _request_batch(&requests[begin], count);
+        for(int i = 0; i < count; ++i) {
+
+          const rfaas::LeaseRequest & request = requests[begin + i];
+          if(!response || response->leases[i].lease_id == -1) {
+            executors.emplace_back(std::nullopt);
+            continue;
+          }
+
+          const rfaas::LeasedNode & node = response->leases[i];
+          executors.emplace_back(
+            std::in_place, std::string{node.address}, node.port,
+            request.cores, request.memory, node.lease_id, dev
+          );
+        }
       }
+      return executors;
+    }
 
-      int executors = ntohl(responses[0].imm_data);
-      if(executors == 0) {
+    // Claims cores from the capacity table of the resource manager with RDMA atomics,
+    // and the executor manager is notified by the executor allocation.
+    // Only cores delegated to the table by each node are available, and nullopt
+    // means the caller should fall back to a regular lease.
+    std::optional<rfaas::executor> lease_direct(int16_t cores, int32_t memory, device_data & dev)
+    {
+      if(!_resource_mgr._capacity_table.slots && !_resource_mgr.capacity_table()) {
         return std::nullopt;
       }
 
-      int response_id = responses[0].wr_id;
-      return rfaas::executor{
-        std::string{_resource_mgr.response(response_id).address},
-        _resource_mgr.response(response_id).port,
+      int slot = _resource_mgr.claim(cores);
+      // Nodes registered after the last request are not in our copy of the table.
+      if(slot == -1 && _resource_mgr.capacity_table()) {
+        slot = _resource_mgr.claim(cores);
+      }
+      if(slot == -1) {
+        return std::nullopt;
+      }
+
+      // The manager rejects the request when the claim expired in the meantime.
+      const rfaas::NodeCapacity & node = _resource_mgr.node(slot);
+      std::optional<rfaas::executor> executor{
+        std::in_place,
+        std::string{node.address},
+        node.port,
         cores,
         memory,
-        _resource_mgr.response(response_id).lease_id,
+        rfaas::AllocationRequest::DIRECT_LEASE,
         dev
       };
+      executor->_claim_epoch = rfaas::NodeCapacity::epoch(node.counter);
+      return executor;
     }
 
     std::optional<rfaas::executor> lease(servers & nodes_data, int16_t cores, int32_t memory)
@@ -77,6 +199,70 @@ namespace rfaas {
 
   private:
     resource_mgr_connection _resource_mgr;
+    int32_t _wait_ms;
+    int16_t _priority;
+    int16_t _weight;
+
+    // Returns nullptr when the lease couldn't be allocated.
+    const rfaas::LeaseResponse* _request(int16_t cores, int32_t memory, uint64_t func_hash, int16_t max_nodes, int & nodes)
+    {
+      if(!_resource_mgr.connected()) {
+        return nullptr;
+      }
+
+      rfaas::LeaseRequest & request = _resource_mgr.request();
+      request = rfaas::LeaseRequest{};
+      request.cores = cores;
+      request.memory = memory;
+      request.func_hash = func_hash;
+      request.max_nodes = max_nodes;
+      request.wait_ms = _wait_ms;
+      request.priority = _priority;
+      request.weight = _weight;
+      _resource_mgr.submit();
+
+      auto [responses, response_count] = _resource_mgr.connection().poll_wc(rdmalib::QueueType::RECV, true);
+
+      if(response_count > 1) {
+        spdlog::warn("Received unexpected responses from resource manager, ignoring {} responses", response_count - 1);
+      }
+
+      nodes = ntohl(responses[0].imm_data);
+      if(nodes == 0) {
+        return nullptr;
+      }
+
+      int response_id = responses[0].wr_id;
+      return &_resource_mgr.response(response_id);
+    }
+
+    // Returns nullptr when none of the leases could be allocated.
+    const rfaas::LeaseBatchResponse* _request_batch(const rfaas::LeaseRequest* requests, int count)
+    {
+      if(!_resource_mgr.connected()) {
+        return nullptr;
+      }
+
+      for(int i = 0; i < count; ++i) {
+        _resource_mgr.request(i) = requests[i];
+        _resource_mgr.request(i).max_nodes = 1;
+      }
+      _resource_mgr.submit(count);
+
+      auto [responses, response_count] = _resource_mgr.connection().poll_wc(rdmalib::QueueType::RECV, true);
+
+      if(response_count > 1) {
+        spdlog::warn("Received unexpected responses from resource manager, ignoring {} responses", response_count - 1);
+      }
+
+      int granted = ntohl(responses[0].imm_data);
+      if(granted == 0) {
+        return nullptr;
+      }
+
+      int response_id = responses[0].wr_id;
+      return &_resource_mgr.batch_response(response_id);
+    }
 
     device_data _device;
   };
@@ -22,6 +22,7 @@ namespace rfaas {
     rdmalib::RDMAActive _active;
     rdmalib::Buffer<char> _allocation_buffer;
     rdmalib::Poller _poller;
+    bool _library_cached;
 
     manager_connection(std::string address, int port, int rcv_buf,
                       int max_inline_data);
@@ -32,12 +33,16 @@ namespace rfaas {
     bool connect();
     void disconnect();
     bool submit();
+    // Valid after a succesful submission.
+    bool library_cached() const;
     LeaseStatus* poll_response();
   };
 
   struct resource_mgr_connection {
 
     static constexpr int CLIENT_ID = 2;
+    // Compare-and-swap retries after losing a race for the cores of a node.
+    static constexpr int CLAIM_ATTEMPTS = 8;
 
     std::string _address;
     int _port;
@@ -46,17 +51,33 @@ namespace rfaas {
     rdmalib::Buffer<rfaas::LeaseRequest> _send_buffer;
     rdmalib::Buffer<rfaas::LeaseResponse> _receive_buffer;
     int _max_inline_data;
+    // Copy of the capacity table, and the result of atomic operations on it.
+    rfaas::CapacityTableResponse _capacity_table;
+    rdmalib::Buffer<rfaas::NodeCapacity> _capacity;
+    rdmalib::Buffer<uint64_t> _atomic_result;
 
     resource_mgr_connection(std::string address, int port, int rcv_buf,
                       int max_inline_data);
 
     rdmalib::Connection &connection();
-    rfaas::LeaseRequest &request();
+    // Requests of a batch are stored one after another.
+    rfaas::LeaseRequest &request(int idx = 0);
     const rfaas::LeaseResponse& response(int idx) const;
-    bool connect();
+    // Received in the same slots as single responses.
+    const rfaas::LeaseBatchResponse& batch_response(int idx) const;
+    // Other shards of the resource manager connect with their own private data.
+    bool connect(uint32_t secret = (CLIENT_ID << 24));
     bool connected() const;
     void disconnect();
-    bool submit();
+    // Sends the first count requests in one message.
+    bool submit(int count = 1);
+    // Requests the location of the capacity table, and updates the number of its slots.
+    // Returns false when the resource manager doesn't expose the table.
+    bool capacity_table();
+    // Takes cores of a node directly from the capacity table.
+    // Returns the slot of the node, or -1 when no node has enough delegated cores.
+    int claim(int16_t cores);
+    const rfaas::NodeCapacity & node(int slot) const;
   };
 
 } // namespace rfaas
@@ -10,10 +10,12 @@
 #include <rdmalib/benchmarker.hpp>
 #include <rdmalib/connection.hpp>
 #include <rdmalib/buffer.hpp>
+#include <rdmalib/functions.hpp>
 #include <rdmalib/rdmalib.hpp>
 
 #include <rfaas/connection.hpp>
 #include <rfaas/devices.hpp>
+#include <rfaas/library.hpp>
 
 #include <spdlog/spdlog.h>
 
@@ -59,10 +61,15 @@ namespace rfaas {
     int _executions;
     int _invoc_id;
     int _lease_id;
+    // Set for direct leases only.
+    uint32_t _claim_epoch;
+    uint64_t _func_hash;
     // FIXME: global settings
     std::vector<executor_state> _connections;
     std::unique_ptr<manager_connection> _exec_manager;
     std::vector<std::string> _func_names;
+    // Keeps the registered code valid when the library is reloaded.
+    std::shared_ptr<const library> _library;
 
     // manage async executions
     std::atomic<bool> _end_requested;
@@ -87,16 +94,98 @@ namespace rfaas {
     rdmalib::Buffer<char> load_library(std::string path);
     void poll_queue();
 
-    template<typename T, typename U>
-    std::future<int> async(std::string fname, const rdmalib::Buffer<T> & in, rdmalib::Buffer<U> & out, int64_t size = -1)
+    // Index of the function in the deployed library, or -1.
+    int function_index(const std::string & fname) const
     {
       auto it = std::find(_func_names.begin(), _func_names.end(), fname);
       if(it == _func_names.end()) {
         spdlog::error("Function {} not found in the deployed library!", fname);
-        return std::future<int>{};
+        return -1;
       }
-      int func_idx = std::distance(_func_names.begin(), it);
+      return std::distance(_func_names.begin(), it);
+    }
+
+    // Functions of a chain are executed back to back on the executor, and only
+    // the output of the last one is written back.
+    // The chain descriptor is stored at the beginning of the payload - the input
+    // of the first function starts sizeof(rdmalib::functions::Chain) bytes after in.data().
+    template<typename T>
+    bool write_chain(const std::vector<std::string> & fnames, const rdmalib::Buffer<T> & in)
+    {
+      using rdmalib::functions::Chain;
+      if(fnames.empty() || fnames.size() > Chain::MAX_LENGTH) {
+        spdlog::error("Function chain must have between 1 and {} functions!", Chain::MAX_LENGTH);
+        return false;
+      }
+      Chain chain{};
+      chain.length = fnames.size();
+      for(size_t i = 0; i < fnames.size(); ++i) {
+        int idx = function_index(fnames[i]);
+        if(idx == -1)
+          return false;
+        chain.functions[i] = idx;
+      }
+      memcpy(in.data(), &chain, sizeof(Chain));
+      return true;
+    }
+
+    template<typename T, typename U>
+    std::future<int> async(std::string fname, const rdmalib::Buffer<T> & in, rdmalib::Buffer<U> & out, int64_t size = -1)
+    {
+      int func_idx = function_index(fname);
+      if(func_idx == -1)
+        return std::future<int>{};
+      return _async(func_idx, in, out, size);
+    }
 
+    // Size includes the chain descriptor.
+    template<typename T, typename U>
+    std::future<int> async_chain(const std::vector<std::string> & fnames, const rdmalib::Buffer<T> & in, rdmalib::Buffer<U> & out, int64_t size = -1)
+    {
+      if(!write_chain(fnames, in))
+        return std::future<int>{};
+      return _async(rdmalib::functions::Chain::FUNCTION_ID, in, out, size);
+    }
+
+    // Direct transfers between executors - connects the first thread of this executor
+    // to the first thread of the downstream one. Requires executor managers with
+    // peer transfers enabled.
+    bool connect_peer(executor & downstream);
+
+    // The output of fname is written by the executor directly to the downstream executor,
+    // which executes next_fname and writes the result to out. We receive only an empty notice
+    // from this executor. The out buffer must be registered with the PD of the downstream executor.
+    // The forward descriptor is stored at the beginning of the payload - the input starts
+    // sizeof(rdmalib::functions::Forward) bytes after in.data(). Size includes the descriptor.
+    template<typename T, typename U>
+    std::future<int> async_forward(std::string fname, const rdmalib::Buffer<T> & in,
+        executor & downstream, std::string next_fname, rdmalib::Buffer<U> & out, int64_t size = -1)
+    {
+      using rdmalib::functions::Forward;
+      int func_idx = function_index(fname);
+      int next_idx = downstream.function_index(next_fname);
+      if(func_idx == -1 || next_idx == -1)
+        return std::future<int>{};
+
+      int next_invoc_id = downstream._invoc_id++;
+      downstream._futures[next_invoc_id] = std::make_tuple(1, std::promise<int>{});
+      downstream._connections[0].conn->receive_wcs().refill();
+
+      Forward forward{};
+      forward.r_address = out.address();
+      forward.r_key = out.rkey();
+      forward.function = func_idx;
+      forward.submission = (next_invoc_id << 16) | (1 << 15) | next_idx;
+      memcpy(in.data(), &forward, sizeof(Forward));
+
+      // The notice is a zero-length write, and its future is not needed.
+      _async(Forward::FUNCTION_ID, in, out, size);
+      return std::get<1>(downstream._futures[next_invoc_id]).get_future();
+    }
+
+    template<typename T, typename U>
+    std::future<int> _async(int func_idx, const rdmalib::Buffer<T> & in, rdmalib::Buffer<U> & out, int64_t size = -1)
+    {
       // FIXME: here get a future for async
       char* data = static_cast<char*>(in.ptr());
       // TODO: we assume here uintptr_t is 8 bytes
@@ -135,8 +224,9 @@ namespace rfaas {
       return std::get<1>(_futures[invoc_id]).get_future();
     }
 
+    // One invocation per thread, with buffers starting at index first.
     template<typename T,typename U>
-    std::future<int> async(std::string fname, const std::vector<rdmalib::Buffer<T>> & in, std::vector<rdmalib::Buffer<U>> & out)
+    std::future<int> async(std::string fname, const std::vector<rdmalib::Buffer<T>> & in, std::vector<rdmalib::Buffer<U>> & out, size_t first = 0)
     {
       auto it = std::find(_func_names.begin(), _func_names.end(), fname);
       if(it == _func_names.end()) {
@@ -152,17 +242,17 @@ namespace rfaas {
       uint32_t submission_id = (invoc_id << 16) | (1 << 15) | func_idx;
       for(int i = 0; i < numcores; ++i) {
         // FIXME: here get a future for async
-        char* data = static_cast<char*>(in[i].ptr());
+        char* data = static_cast<char*>(in[first + i].ptr());
         // TODO: we assume here uintptr_t is 8 bytes
-        *reinterpret_cast<uint64_t*>(data) = out[i].address();
-        *reinterpret_cast<uint32_t*>(data + 8) = out[i].rkey();
+        *reinterpret_cast<uint64_t*>(data) = out[first + i].address();
+        *reinterpret_cast<uint32_t*>(data + 8) = out[first + i].rkey();
 
         SPDLOG_DEBUG("Invoke function {} with invocation id {}", func_idx, _invoc_id);
         _connections[i].conn->post_write(
-          in[i],
+          in[first + i],
           _connections[i].remote_input,
           submission_id,
-          in[i].bytes() <= _device.max_inline_data,
+          in[first + i].bytes() <= _device.max_inline_data,
           true
         );
       }
@@ -202,13 +292,23 @@ namespace rfaas {
     template<typename T, typename U>
     std::tuple<bool, int> execute(std::string fname, const rdmalib::Buffer<T> & in, rdmalib::Buffer<U> & out)
     {
-      auto it = std::find(_func_names.begin(), _func_names.end(), fname);
-      if(it == _func_names.end()) {
-        spdlog::error("Function {} not found in the deployed library!", fname);
+      int func_idx = function_index(fname);
+      if(func_idx == -1)
         return std::make_tuple(false, 0);
-      }
-      int func_idx = std::distance(_func_names.begin(), it);
+      return _execute(func_idx, in, out);
+    }
+
+    template<typename T, typename U>
+    std::tuple<bool, int> execute_chain(const std::vector<std::string> & fnames, const rdmalib::Buffer<T> & in, rdmalib::Buffer<U> & out)
+    {
+      if(!write_chain(fnames, in))
+        return std::make_tuple(false, 0);
+      return _execute(rdmalib::functions::Chain::FUNCTION_ID, in, out);
+    }
 
+    template<typename T, typename U>
+    std::tuple<bool, int> _execute(int func_idx, const rdmalib::Buffer<T> & in, rdmalib::Buffer<U> & out)
+    {
       // FIXME: here get a future for async
       char* data = static_cast<char*>(in.ptr());
       // TODO: we assume here uintptr_t is 8 bytes
@@ -0,0 +1,81 @@
+
+#ifndef __RFAAS_EXECUTOR_GROUP_HPP__
+#define __RFAAS_EXECUTOR_GROUP_HPP__
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include <rdmalib/buffer.hpp>
+
+#include <rfaas/executor.hpp>
+
+#include <spdlog/spdlog.h>
+
+namespace rfaas {
+
+  // Executors of a lease split by the resource manager across multiple nodes,
+  // used as a single executor with the cores of all nodes.
+  // Worker i of the group is a thread of the executor whose cores start at or before i.
+  // Buffers of a worker must be registered with the PD of its executor.
+  struct executor_group {
+
+    std::vector<executor> _executors;
+    // First worker of each executor.
+    std::vector<int> _offsets;
+    int _numcores;
+
+    executor_group(std::vector<executor> && executors);
+
+    size_t size() const;
+    int numcores() const;
+    executor & operator[](size_t idx);
+    executor & executor_of(int worker);
+    ibv_pd* pd(int worker);
+
+    // Executors are allocated concurrently, and the library is read once.
+    bool allocate(std::string functions_path, int max_input_size, int hot_timeout, bool skip_manager = false);
+    void deallocate();
+
+    // One invocation per worker - in and out hold numcores() buffers.
+    // The future becomes ready when all workers finished, with the first non-zero return value.
+    template<typename T, typename U>
+    std::future<int> async(std::string fname, const std::vector<rdmalib::Buffer<T>> & in, std::vector<rdmalib::Buffer<U>> & out)
+    {
+      if(in.size() < static_cast<size_t>(_numcores) || out.size() < static_cast<size_t>(_numcores)) {
+        spdlog::error("Executor group with {} workers received {} inputs and {} outputs", _numcores, in.size(), out.size());
+        return std::future<int>{};
+      }
+
+      std::vector<std::future<int>> futures;
+      for(size_t i = 0; i < _executors.size(); ++i) {
+        futures.push_back(_executors[i].async(fname, in, out, _offsets[i]));
+        if(!futures.back().valid())
+          return std::future<int>{};
+      }
+
+      return std::async(std::launch::deferred,
+        [futures = std::move(futures)]() mutable {
+          int result = 0;
+          for(auto & future : futures) {
+            int ret = future.get();
+            if(!result)
+              result = ret;
+          }
+          return result;
+        }
+      );
+    }
+
+    template<typename T, typename U>
+    bool execute(std::string fname, const std::vector<rdmalib::Buffer<T>> & in, std::vector<rdmalib::Buffer<U>> & out)
+    {
+      auto future = async(fname, in, out);
+      return future.valid() && future.get() == 0;
+    }
+  };
+
+}
+
+#endif
+
@@ -0,0 +1,49 @@
+
+#ifndef __RFAAS_FUNCTION_HPP__
+#define __RFAAS_FUNCTION_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+// Header for functions libraries - no dependencies on rdmalib or rfaas.
+//
+// Functions use by default the following signature:
+//   extern "C" uint32_t name(void* args, uint32_t size, void* res);
+//
+// Libraries declaring RFAAS_FUNCTIONS_V2 are called with an additional context:
+//   extern "C" uint32_t name(void* args, uint32_t size, void* res, rfaas::function_context* ctx);
+// The convention applies to all functions in the library.
+
+namespace rfaas {
+
+  struct function_context
+  {
+    // Scratch memory of the executor thread, reset after each invocation.
+    // Memory is valid only until the function returns and it must not be freed.
+    void* arena;
+    void* (*arena_allocate)(void* arena, size_t size, size_t alignment);
+    size_t arena_size;
+    uint32_t thread_id;
+
+    // Returns nullptr when the arena is exhausted.
+    inline void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+      return arena_allocate(arena, size, alignment);
+    }
+
+    template<typename T>
+    inline T* allocate_array(size_t count)
+    {
+      return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+  };
+
+  constexpr uint32_t FUNCTIONS_VERSION_V2 = 2;
+}
+
+// Not a function - does not change the indices of functions in the library.
+#define RFAAS_FUNCTIONS_V2 \
+  extern "C" __attribute__((visibility("default"))) const uint32_t rfaas_functions_version = rfaas::FUNCTIONS_VERSION_V2;
+
+#endif
+
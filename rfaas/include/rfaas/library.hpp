@@ -0,0 +1,59 @@
+
+#ifndef __RFAAS_LIBRARY_HPP__
+#define __RFAAS_LIBRARY_HPP__
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rdmalib/buffer.hpp>
+
+namespace rfaas {
+
+  // Functions library read from the disk.
+  // The code buffer is not registered - each executor registers it with its own PD.
+  struct library
+  {
+    std::string path;
+    // With nanoseconds - a file replaced within the same second is loaded again.
+    timespec modification_time;
+    // Content hash, used by executor managers to identify cached libraries.
+    // First 64 bits of the SHA-256 digest of the code.
+    uint64_t hash;
+    rdmalib::Buffer<char> code;
+    std::vector<std::string> functions;
+
+    library(const std::string & path, const timespec & modification_time, size_t size);
+    // Compares the modification time and the size of the file.
+    bool modified(const timespec & modification_time, size_t size) const;
+
+    static uint64_t content_hash(const char* data, size_t size);
+  };
+
+  // Process-wide cache of functions libraries.
+  // Repeated allocations of the same library do not read and parse the file again.
+  struct libraries
+  {
+    static libraries & instance();
+
+    // Thread-safe; the library is loaded again when the file has been modified.
+    // Returns nullptr when the library cannot be read.
+    // Callers keep the library alive - a reload replaces it only in the cache.
+    std::shared_ptr<const library> load(const std::string & path);
+
+  private:
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<const library>> _libraries;
+
+    libraries() {}
+    static void _extract_functions(library & lib);
+  };
+
+}
+
+#endif
+
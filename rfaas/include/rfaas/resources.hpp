@@ -8,6 +8,7 @@
 #include <memory>
 #include <cstring>
 
+#include <cereal/details/helpers.hpp>
 #include <cereal/types/vector.hpp> 
 #include <cereal/types/string.hpp>
 
@@ -21,23 +22,31 @@ namespace rfaas {
     int32_t port;
     int16_t cores;
     int32_t memory;
+    // Cores are split evenly between sockets.
+    int16_t sockets;
     std::string address;
     std::string node;
 
     server_data();
-    server_data(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory);
+    server_data(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets = 1);
 
     template <class Archive>
     void save(Archive & ar) const
     {
       std::string addr{address};
       ar(CEREAL_NVP(node), CEREAL_NVP(port), CEREAL_NVP(cores), CEREAL_NVP(memory), cereal::make_nvp("address", addr));
+      ar(CEREAL_NVP(sockets));
     }
 
     template <class Archive>
     void load(Archive & ar )
     {
       ar(CEREAL_NVP(node), CEREAL_NVP(port), CEREAL_NVP(cores), CEREAL_NVP(memory), CEREAL_NVP(address));
+      // Optional - databases without it describe single-socket nodes.
+      sockets = 1;
+      try {
+        ar(CEREAL_NVP(sockets));
+      } catch(cereal::Exception &) {}
     }
   };
 
@@ -4,4 +4,5 @@
 #include <rfaas/connection.hpp>
 #include <rfaas/devices.hpp>
 #include <rfaas/executor.hpp>
+#include <rfaas/executor_group.hpp>
 #include <rfaas/resources.hpp>
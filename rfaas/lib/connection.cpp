@@ -18,7 +18,8 @@ namespace rfaas {
     _rcv_buf_size(rcv_buf),
     _max_inline_data(max_inline_data),
     _active(_address, _port, rcv_buf),
-    _allocation_buffer(sizeof(LeaseStatus)*rcv_buf + sizeof(AllocationRequest))
+    _allocation_buffer(sizeof(LeaseStatus)*rcv_buf + sizeof(AllocationRequest)),
+    _library_cached(false)
   {
     _active.allocate();
     _poller.initialize(_active.connection().qp()->recv_cq);
@@ -45,7 +46,7 @@ namespace rfaas {
     SPDLOG_DEBUG("Disconnecting from manager at {}:{}", _address, _port);
     // Send deallocation request only if we're connected
     if(_active.is_connected()) {
-      request() = (rfaas::AllocationRequest) {-1, 0, 0, 0, 0, 0, 0, ""};
+      request() = (rfaas::AllocationRequest) {-1, 0, 0, 0, 0, 0, 0, "", 0, 0, 0, 0};
       rdmalib::ScatterGatherElement sge;
       size_t obj_size = sizeof(rfaas::AllocationRequest);
       sge.add(_allocation_buffer, obj_size, sizeof(LeaseStatus)*_rcv_buf_size);
@@ -70,6 +71,11 @@ namespace rfaas {
     return reinterpret_cast<LeaseStatus*>(_allocation_buffer.data() + idx * sizeof(LeaseStatus));
   }
 
+  bool manager_connection::library_cached() const
+  {
+    return _library_cached;
+  }
+
   LeaseStatus* manager_connection::poll_response()
   {
     auto [wcs, count] = _poller.poll(true);
@@ -97,6 +103,7 @@ namespace rfaas {
     }
 
     if(response->status == LeaseStatus::ALLOCATED) {
+      _library_cached = response->library_cached;
       return true;
     }
 
@@ -124,18 +131,19 @@ namespace rfaas {
     _port(port),
     _active(_address, _port, rcv_buf),
     _rcv_buf_size(rcv_buf),
-    _send_buffer(1),
+    _send_buffer(LeaseRequest::MAX_BATCH),
     _receive_buffer(rcv_buf),
-    _max_inline_data(max_inline_data)
+    _max_inline_data(max_inline_data),
+    _capacity_table{0, 0, 0},
+    _atomic_result(1)
   {
     _active.allocate();
   }
 
-  bool resource_mgr_connection::connect()
+  bool resource_mgr_connection::connect(uint32_t secret)
   {
     SPDLOG_DEBUG("Connecting to resource manager at {}:{}", _address, _port);
 
-    uint32_t secret = (CLIENT_ID << 24);
     bool ret = _active.connect(secret);
     if(!ret) {
       spdlog::error("Couldn't connect to manager at {}:{}", _address, _port);
@@ -143,6 +151,7 @@ namespace rfaas {
     }
     _send_buffer.register_memory(_active.pd(), IBV_ACCESS_LOCAL_WRITE); 
     _receive_buffer.register_memory(_active.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE); 
+    _atomic_result.register_memory(_active.pd(), IBV_ACCESS_LOCAL_WRITE);
 
     // Initialize batch receive WCs
     _active.connection().receive_wcs().initialize(_receive_buffer);
@@ -155,7 +164,8 @@ namespace rfaas {
 
     // Send deallocation request only if we're connected
     if(_active.is_connected()) {
-      request() = (rfaas::LeaseRequest) {-1, 0};
+      request() = rfaas::LeaseRequest{};
+      request().cores = -1;
       rdmalib::ScatterGatherElement sge;
       size_t obj_size = sizeof(rfaas::LeaseRequest);
       sge.add(_send_buffer, obj_size, 0);
@@ -170,9 +180,9 @@ namespace rfaas {
     return _active.connection();
   }
 
-  rfaas::LeaseRequest & resource_mgr_connection::request()
+  rfaas::LeaseRequest & resource_mgr_connection::request(int idx)
   {
-    return *(_send_buffer.data());
+    return _send_buffer.data()[idx];
   }
 
   const rfaas::LeaseResponse& resource_mgr_connection::response(int idx) const
@@ -180,10 +190,15 @@ namespace rfaas {
     return _receive_buffer.data()[idx];
   }
 
-  bool resource_mgr_connection::submit()
+  const rfaas::LeaseBatchResponse& resource_mgr_connection::batch_response(int idx) const
+  {
+    return *reinterpret_cast<const rfaas::LeaseBatchResponse*>(&_receive_buffer.data()[idx]);
+  }
+
+  bool resource_mgr_connection::submit(int count)
   {
     rdmalib::ScatterGatherElement sge;
-    size_t obj_size = sizeof(rfaas::LeaseRequest);
+    size_t obj_size = sizeof(rfaas::LeaseRequest) * count;
     sge.add(_send_buffer, obj_size, 0);
     _active.connection().post_send(sge);
     _active.connection().poll_wc(rdmalib::QueueType::SEND, true);
@@ -192,6 +207,95 @@ namespace rfaas {
     return true;
   }
 
+  bool resource_mgr_connection::capacity_table()
+  {
+    if(!connected()) {
+      return false;
+    }
+
+    // Zero cores ask for the capacity table.
+    request() = rfaas::LeaseRequest{};
+    submit();
+
+    auto [responses, response_count] = _active.connection().poll_wc(rdmalib::QueueType::RECV, true);
+    if(response_count > 1) {
+      spdlog::warn("Received unexpected responses from resource manager, ignoring {} responses", response_count - 1);
+    }
+    if(!ntohl(responses[0].imm_data)) {
+      SPDLOG_DEBUG("Resource manager at {}:{} doesn't expose the capacity table", _address, _port);
+      return false;
+    }
+    _capacity_table = *reinterpret_cast<const rfaas::CapacityTableResponse*>(&response(responses[0].wr_id));
+
+    // Nodes registered since the last request are appended to the table.
+    if(_capacity.size() < static_cast<size_t>(_capacity_table.slots)) {
+      _capacity = rdmalib::Buffer<rfaas::NodeCapacity>(_capacity_table.slots);
+      _capacity.register_memory(_active.pd(), IBV_ACCESS_LOCAL_WRITE);
+    }
+    return true;
+  }
+
+  int resource_mgr_connection::claim(int16_t cores)
+  {
+    int slots = _capacity_table.slots;
+    if(!connected() || slots <= 0) {
+      return -1;
+    }
+    rdmalib::Connection & conn = _active.connection();
+
+    // A single read of all slots - counters change all the time, and are checked by the swap.
+    rdmalib::ScatterGatherElement table;
+    table.add(_capacity, slots);
+    conn.post_read(std::move(table), rdmalib::RemoteBuffer{_capacity_table.address, _capacity_table.rkey});
+    auto [wcs, count] = conn.poll_wc(rdmalib::QueueType::SEND, true, 1);
+    if(count == 0 || wcs[0].status != IBV_WC_SUCCESS) {
+      spdlog::error("Couldn't read the capacity table of resource manager at {}:{}", _address, _port);
+      return -1;
+    }
+
+    // Clients start at different slots, and don't contend for the same node.
+    int first = conn.qp()->qp_num % slots;
+    for(int attempt = 0; attempt < CLAIM_ATTEMPTS; ++attempt) {
+
+      int slot = -1;
+      for(int i = 0; i < slots && slot == -1; ++i) {
+        int pos = (first + i) % slots;
+        if(_capacity[pos].available && rfaas::NodeCapacity::cores(_capacity[pos].counter) >= static_cast<uint32_t>(cores)) {
+          slot = pos;
+        }
+      }
+      if(slot == -1) {
+        return -1;
+      }
+
+      // Cores are in the low bits, the epoch stays the same.
+      uint64_t expected = _capacity[slot].counter;
+      conn.post_cas(
+        rdmalib::ScatterGatherElement{_atomic_result},
+        rdmalib::RemoteBuffer{_capacity_table.address + slot * sizeof(rfaas::NodeCapacity), _capacity_table.rkey},
+        expected, expected - cores
+      );
+      std::tie(wcs, count) = conn.poll_wc(rdmalib::QueueType::SEND, true, 1);
+      if(count == 0 || wcs[0].status != IBV_WC_SUCCESS) {
+        spdlog::error("Compare-and-swap on the capacity table failed");
+        return -1;
+      }
+
+      // Another client changed the counter - retry with its current value.
+      uint64_t found = *_atomic_result.data();
+      if(found == expected) {
+        return slot;
+      }
+      _capacity[slot].counter = found;
+    }
+    return -1;
+  }
+
+  const rfaas::NodeCapacity & resource_mgr_connection::node(int slot) const
+  {
+    return _capacity[slot];
+  }
+
   bool resource_mgr_connection::connected() const
   {
     return _active.is_connected();
@@ -4,18 +4,15 @@
 #include <rdmalib/rdmalib.hpp>
 #include <rdmalib/connection.hpp>
 #include <rdmalib/buffer.hpp>
+#include <rdmalib/functions.hpp>
 #include <rdmalib/util.hpp>
 
 #include <rfaas/allocation.hpp>
 #include <rfaas/connection.hpp>
 #include <rfaas/executor.hpp>
+#include <rfaas/library.hpp>
 #include <rfaas/resources.hpp>
 
-// FIXME: same function as in server/functions.cpp - merge?
-#include <sys/mman.h>
-#include <dlfcn.h>
-#include <elf.h>
-#include <link.h>
 #include <poll.h>
 
 namespace rfaas {
@@ -45,7 +42,9 @@ namespace rfaas {
     _memory(memory),
     _executions(0),
     _invoc_id(0),
-    _lease_id(lease_id)
+    _lease_id(lease_id),
+    _claim_epoch(0),
+    _func_hash(0)
   {
     _execs_buf.register_memory(_state.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
     events = 0;
@@ -79,9 +78,12 @@ namespace rfaas {
     _executions(std::move(obj._executions)),
     _invoc_id(std::move(obj._invoc_id)),
     _lease_id(std::move(obj._lease_id)),
+    _claim_epoch(std::move(obj._claim_epoch)),
+    _func_hash(std::move(obj._func_hash)),
     _connections(std::move(obj._connections)),
     _exec_manager(std::move(obj._exec_manager)),
     _func_names(std::move(obj._func_names)),
+    _library(std::move(obj._library)),
     _futures(std::move(obj._futures)),
     _background_thread(std::move(obj._background_thread))
   {
@@ -95,61 +97,17 @@ namespace rfaas {
   rdmalib::Buffer<char> executor::load_library(std::string path)
   {
     _func_names.clear();
-    // Load the shared library with functions code
-    FILE* file = fopen(path.c_str(), "rb");
-    fseek (file, 0 , SEEK_END);
-    size_t len = ftell(file);
-    rewind(file);
-    rdmalib::Buffer<char> functions(len);
-    rdmalib::impl::expect_true(fread(functions.data(), 1, len, file) == len);
-    functions.register_memory(_state.pd(), IBV_ACCESS_LOCAL_WRITE);
-    fclose(file);
-
-    // FIXME: same function as in server/functions.cpp - merge?
-    // https://stackoverflow.com/questions/25270275/get-functions-names-in-a-shared-library-programmatically
-    void* library_handle;
-    rdmalib::impl::expect_nonnull(
-      library_handle = dlopen(
-        path.c_str(),
-        RTLD_NOW
-      ),
-      [](){ spdlog::error(dlerror()); }
-    );
-    struct link_map * map = nullptr;
-    dlinfo(library_handle, RTLD_DI_LINKMAP, &map);
-
-    Elf64_Sym * symtab = nullptr;
-    char * strtab = nullptr;
-    int symentries = 0;
-    for (auto section = map->l_ld; section->d_tag != DT_NULL; ++section)
-    {
-      if (section->d_tag == DT_SYMTAB)
-      {
-        symtab = (Elf64_Sym *)section->d_un.d_ptr;
-      }
-      if (section->d_tag == DT_STRTAB)
-      {
-        strtab = (char*)section->d_un.d_ptr;
-      }
-      if (section->d_tag == DT_SYMENT)
-      {
-        symentries = section->d_un.d_val;
-      }
+    auto lib = libraries::instance().load(path);
+    if(!lib) {
+      return rdmalib::Buffer<char>{};
     }
-    int size = strtab - (char *)symtab;
-    for (int k = 0; k < size / symentries; ++k)
-    {
-      auto sym = &symtab[k];
-      // If sym is function
-      if (ELF64_ST_TYPE(symtab[k].st_info) == STT_FUNC)
-      {
-        //str is name of each symbol
-        _func_names.emplace_back(&strtab[sym->st_name]);
-      }
-    }
-    std::sort(_func_names.begin(), _func_names.end());
-    dlclose(library_handle);
+    _library = lib;
+    _func_names = lib->functions;
+    _func_hash = lib->hash;
 
+    // The code is owned by the process-wide cache; we only register it with our PD.
+    rdmalib::Buffer<char> functions(lib->code.data(), lib->code.data_size());
+    functions.register_memory(_state.pd(), IBV_ACCESS_LOCAL_WRITE);
     return functions;
   }
 
@@ -264,10 +222,43 @@ namespace rfaas {
     //spdlog::info("Background thread stops waiting for events");
   }
 
+  bool executor::connect_peer(executor & downstream)
+  {
+    using rdmalib::functions::PeerInformation;
+    using rdmalib::functions::Submission;
+
+    // The downstream thread replies with its address, and waits for the connection.
+    rdmalib::Buffer<char> listen_in(sizeof(PeerInformation), Submission::DATA_HEADER_SIZE), listen_out(sizeof(PeerInformation));
+    listen_in.register_memory(downstream._state.pd(), IBV_ACCESS_LOCAL_WRITE);
+    listen_out.register_memory(downstream._state.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+    auto listening = downstream._execute(rdmalib::functions::PEER_LISTEN, listen_in, listen_out);
+    if(!std::get<0>(listening) || std::get<1>(listening) != sizeof(PeerInformation)) {
+      spdlog::error("Downstream executor does not accept connections from other executors");
+      return false;
+    }
+
+    rdmalib::Buffer<char> connect_in(sizeof(PeerInformation), Submission::DATA_HEADER_SIZE), connect_out(1);
+    connect_in.register_memory(_state.pd(), IBV_ACCESS_LOCAL_WRITE);
+    connect_out.register_memory(_state.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+    memcpy(connect_in.data(), listen_out.data(), sizeof(PeerInformation));
+    auto connected = _execute(rdmalib::functions::PEER_CONNECT, connect_in, connect_out);
+    if(!std::get<0>(connected)) {
+      spdlog::error("Executor couldn't connect to the downstream executor");
+      return false;
+    }
+    SPDLOG_DEBUG("Connected executor to the downstream executor at {}", listen_out.data());
+    return true;
+  }
+
   bool executor::allocate(std::string functions_path, int max_input_size,
       int hot_timeout, bool skip_manager, rdmalib::Benchmarker<5> * benchmarker)
   {
     rdmalib::Buffer<char> functions = load_library(functions_path);
+    if(!functions.ptr()) {
+      return false;
+    }
+    // The code is transferred only when the executor manager does not have it cached.
+    bool send_library = true;
 
     if(!skip_manager) {
 
@@ -292,13 +283,19 @@ namespace rfaas {
         max_input_size,
         functions.data_size(),
         _state.listen_port(),
-        ""
+        "",
+        _func_hash,
+        static_cast<int16_t>(_numcores),
+        _memory,
+        _claim_epoch
       };
       strcpy(_exec_manager->request().listen_address, _device.ip_address.c_str());
 
       if(!_exec_manager->submit()) {
         return false;
       }
+      send_library = !_exec_manager->library_cached();
+      SPDLOG_DEBUG("Functions library {:x} cached by the manager? {}", _func_hash, !send_library);
       // Measure submission time
       if(benchmarker) {
         benchmarker->end(1);
@@ -341,8 +338,13 @@ namespace rfaas {
           "[Executor] Established connection to executor {}, connection {}",
           established + 1, fmt::ptr(conn)
         );
-        conn->post_send(functions);
-        SPDLOG_DEBUG("Connected thread {}/{} and submitted function code.", established + 1, _numcores);
+        // Only one thread receives the code - the executor shares it between threads.
+        if(send_library && conn->private_data() == rdmalib::functions::LIBRARY_RECEIVER) {
+          conn->post_send(functions);
+          SPDLOG_DEBUG("Connected thread {}/{} and submitted function code.", established + 1, _numcores);
+        } else {
+          SPDLOG_DEBUG("Connected thread {}/{}.", established + 1, _numcores);
+        }
         ++established;
       }
       // FIXME: fix handling of disconnection
@@ -387,7 +389,8 @@ namespace rfaas {
         this
       }
     );
-    while(received < _numcores) {
+    int expected_sends = send_library ? 1 : 0;
+    while(received < expected_sends) {
       auto wcs = this->_connections[0].conn->poll_wc(rdmalib::QueueType::SEND, true);
       received += std::get<1>(wcs);
     }
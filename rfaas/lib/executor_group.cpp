@@ -0,0 +1,77 @@
+
+#include <algorithm>
+#include <future>
+
+#include <spdlog/spdlog.h>
+
+#include <rfaas/executor_group.hpp>
+
+namespace rfaas {
+
+  executor_group::executor_group(std::vector<executor> && executors):
+    _executors(std::move(executors)),
+    _numcores(0)
+  {
+    for(auto & exec : _executors) {
+      _offsets.push_back(_numcores);
+      _numcores += exec._numcores;
+    }
+  }
+
+  size_t executor_group::size() const
+  {
+    return _executors.size();
+  }
+
+  int executor_group::numcores() const
+  {
+    return _numcores;
+  }
+
+  executor & executor_group::operator[](size_t idx)
+  {
+    return _executors[idx];
+  }
+
+  executor & executor_group::executor_of(int worker)
+  {
+    auto it = std::upper_bound(_offsets.begin(), _offsets.end(), worker);
+    return _executors[std::distance(_offsets.begin(), it) - 1];
+  }
+
+  ibv_pd* executor_group::pd(int worker)
+  {
+    return executor_of(worker)._state.pd();
+  }
+
+  bool executor_group::allocate(std::string functions_path, int max_input_size, int hot_timeout, bool skip_manager)
+  {
+    std::vector<std::future<bool>> allocations;
+    for(auto & exec : _executors)
+      allocations.push_back(
+        std::async(std::launch::async,
+          [&exec, &functions_path, max_input_size, hot_timeout, skip_manager]() {
+            return exec.allocate(functions_path, max_input_size, hot_timeout, skip_manager);
+          }
+        )
+      );
+
+    bool success = true;
+    for(size_t i = 0; i < allocations.size(); ++i) {
+      if(!allocations[i].get()) {
+        spdlog::error("Couldn't allocate executor {} of the group, lease {}", i, _executors[i]._lease_id);
+        success = false;
+      }
+    }
+    if(!success)
+      deallocate();
+    return success;
+  }
+
+  void executor_group::deallocate()
+  {
+    for(auto & exec : _executors)
+      exec.deallocate();
+  }
+
+}
@@ -0,0 +1,206 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <link.h>
+
+#include <spdlog/spdlog.h>
+
+#include <rdmalib/util.hpp>
+
+#include <rfaas/library.hpp>
+
+namespace rfaas {
+
+  library::library(const std::string & path, const timespec & modification_time, size_t size):
+    path(path),
+    modification_time(modification_time),
+    hash(0),
+    code(size)
+  {}
+
+  bool library::modified(const timespec & modification_time, size_t size) const
+  {
+    return this->modification_time.tv_sec != modification_time.tv_sec ||
+      this->modification_time.tv_nsec != modification_time.tv_nsec ||
+      code.data_size() != size;
+  }
+
+  // SHA-256 (FIPS 180-4).
+  struct sha256
+  {
+    static constexpr uint32_t K[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    uint32_t state[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    static uint32_t rotr(uint32_t x, int n)
+    {
+      return (x >> n) | (x << (32 - n));
+    }
+
+    void block(const unsigned char* data)
+    {
+      uint32_t w[64];
+      for(int i = 0; i < 16; ++i)
+        w[i] = uint32_t(data[4*i]) << 24 | uint32_t(data[4*i+1]) << 16 | uint32_t(data[4*i+2]) << 8 | data[4*i+3];
+      for(int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+        uint32_t s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+      }
+
+      uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+      uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+      for(int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+      }
+      state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+      state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    void digest(const char* data, size_t size)
+    {
+      auto bytes = reinterpret_cast<const unsigned char*>(data);
+      size_t full = size - size % 64;
+      for(size_t i = 0; i < full; i += 64)
+        block(bytes + i);
+
+      // Padding: a single one bit, zeros, and the length in bits.
+      unsigned char tail[128] = {};
+      size_t rest = size - full;
+      memcpy(tail, bytes + full, rest);
+      tail[rest] = 0x80;
+      size_t tail_size = rest < 56 ? 64 : 128;
+      uint64_t bits = static_cast<uint64_t>(size) * 8;
+      for(int i = 0; i < 8; ++i)
+        tail[tail_size - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+      for(size_t i = 0; i < tail_size; i += 64)
+        block(tail + i);
+    }
+  };
+
+  constexpr uint32_t sha256::K[64];
+
+  uint64_t library::content_hash(const char* data, size_t size)
+  {
+    // SHA-256 - executors verify the received library against it before caching,
+    // so a client can't place other code under the hash of a known library.
+    sha256 hash;
+    hash.digest(data, size);
+    uint64_t prefix = static_cast<uint64_t>(hash.state[0]) << 32 | hash.state[1];
+    // Zero is reserved for "no hash".
+    return prefix ? prefix : 1;
+  }
+
+  libraries & libraries::instance()
+  {
+    static libraries _instance;
+    return _instance;
+  }
+
+  std::shared_ptr<const library> libraries::load(const std::string & path)
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    struct stat st;
+    if(stat(path.c_str(), &st)) {
+      spdlog::error("Couldn't access functions library {}, reason {}", path, strerror(errno));
+      return nullptr;
+    }
+
+    auto it = _libraries.find(path);
+    if(it != _libraries.end() && !it->second->modified(st.st_mtim, st.st_size)) {
+      SPDLOG_DEBUG("Reusing cached functions library {}", path);
+      return it->second;
+    }
+
+    auto lib = std::make_shared<library>(path, st.st_mtim, static_cast<size_t>(st.st_size));
+
+    // Load the shared library with functions code
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file) {
+      spdlog::error("Couldn't open functions library {}, reason {}", path, strerror(errno));
+      return nullptr;
+    }
+    size_t len = st.st_size;
+    rdmalib::impl::expect_true(fread(lib->code.data(), 1, len, file) == len);
+    fclose(file);
+
+    lib->hash = library::content_hash(lib->code.data(), len);
+    _extract_functions(*lib);
+    SPDLOG_DEBUG(
+      "Loaded functions library {} of size {}, hash {:x}, {} functions",
+      path, len, lib->hash, lib->functions.size()
+    );
+
+    _libraries[path] = lib;
+    return lib;
+  }
+
+  void libraries::_extract_functions(library & lib)
+  {
+    // FIXME: same function as in server/functions.cpp - merge?
+    // https://stackoverflow.com/questions/25270275/get-functions-names-in-a-shared-library-programmatically
+    void* library_handle;
+    rdmalib::impl::expect_nonnull(
+      library_handle = dlopen(
+        lib.path.c_str(),
+        RTLD_NOW
+      ),
+      [](){ spdlog::error(dlerror()); }
+    );
+    struct link_map * map = nullptr;
+    dlinfo(library_handle, RTLD_DI_LINKMAP, &map);
+
+    Elf64_Sym * symtab = nullptr;
+    char * strtab = nullptr;
+    int symentries = 0;
+    for (auto section = map->l_ld; section->d_tag != DT_NULL; ++section)
+    {
+      if (section->d_tag == DT_SYMTAB)
+      {
+        symtab = (Elf64_Sym *)section->d_un.d_ptr;
+      }
+      if (section->d_tag == DT_STRTAB)
+      {
+        strtab = (char*)section->d_un.d_ptr;
+      }
+      if (section->d_tag == DT_SYMENT)
+      {
+        symentries = section->d_un.d_val;
+      }
+    }
+    int size = strtab - (char *)symtab;
+    for (int k = 0; k < size / symentries; ++k)
+    {
+      auto sym = &symtab[k];
+      // If sym is function
+      if (ELF64_ST_TYPE(symtab[k].st_info) == STT_FUNC)
+      {
+        //str is name of each symbol
+        lib.functions.emplace_back(&strtab[sym->st_name]);
+      }
+    }
+    std::sort(lib.functions.begin(), lib.functions.end());
+    dlclose(library_handle);
+  }
+
+}
+
@@ -12,13 +12,15 @@ namespace rfaas {
   server_data::server_data():
     port(-1),
     cores(-1),
-    memory(-1)
+    memory(-1),
+    sockets(1)
   {}
 
-  server_data::server_data(const std::string & node, const std::string & ip, int32_t port, int16_t cores, int32_t memory):
+  server_data::server_data(const std::string & node, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets):
     port(port),
     cores(cores),
     memory(memory),
+    sockets(sockets),
     address(ip),
     node(node)
   {}
@@ -0,0 +1,165 @@
+
+#ifndef __COMMON_ACCOUNTING_PAGE_HPP__
+#define __COMMON_ACCOUNTING_PAGE_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace rfaas { namespace common {
+
+  // Counters of a single executor thread, on its own cache line.
+  // Written only by the thread, and read by the manager at any time.
+  struct alignas(64) AccountingSlot {
+    std::atomic<uint64_t> hot_polling_time;
+    std::atomic<uint64_t> execution_time;
+    std::atomic<uint64_t> invocations;
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "Accounting counters must be lock-free in shared memory");
+
+  // Accounting of executor threads in a memfd shared by the manager and the executor process.
+  // The manager creates the page for a lease and passes the descriptor to the executor.
+  struct AccountingPage {
+
+    // Passed to executors started as new processes at this descriptor.
+    static constexpr int EXECUTOR_FD = 3;
+
+    AccountingPage():
+      _fd(-1),
+      _threads(0),
+      _slots(nullptr)
+    {}
+
+    AccountingPage(const AccountingPage &) = delete;
+    AccountingPage& operator=(const AccountingPage &) = delete;
+
+    AccountingPage(AccountingPage && obj):
+      _fd(obj._fd),
+      _threads(obj._threads),
+      _slots(obj._slots)
+    {
+      obj._fd = -1;
+      obj._slots = nullptr;
+    }
+
+    AccountingPage& operator=(AccountingPage && obj)
+    {
+      if(this != &obj) {
+        _release();
+        _fd = obj._fd;
+        _threads = obj._threads;
+        _slots = obj._slots;
+        obj._fd = -1;
+        obj._slots = nullptr;
+      }
+      return *this;
+    }
+
+    ~AccountingPage()
+    {
+      _release();
+    }
+
+    // Manager side - zeroed counters for the threads of a lease.
+    bool create(int threads)
+    {
+      int fd = memfd_create("rfaas_accounting", MFD_CLOEXEC);
+      if(fd < 0)
+        return false;
+      if(ftruncate(fd, _size(threads))) {
+        close(fd);
+        return false;
+      }
+      return map(fd, threads);
+    }
+
+    // Takes ownership of the descriptor.
+    bool map(int fd, int threads)
+    {
+      _release();
+      if(threads <= 0) {
+        close(fd);
+        return false;
+      }
+      void* ptr = mmap(nullptr, _size(threads), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if(ptr == MAP_FAILED) {
+        close(fd);
+        return false;
+      }
+      _fd = fd;
+      _threads = threads;
+      _slots = static_cast<AccountingSlot*>(ptr);
+      return true;
+    }
+
+    bool valid() const
+    {
+      return _slots != nullptr;
+    }
+
+    int fd() const
+    {
+      return _fd;
+    }
+
+    int threads() const
+    {
+      return _threads;
+    }
+
+    AccountingSlot* slot(int thread) const
+    {
+      return _slots && thread < _threads ? &_slots[thread] : nullptr;
+    }
+
+    uint64_t hot_polling_time() const
+    {
+      return _sum(&AccountingSlot::hot_polling_time);
+    }
+
+    uint64_t execution_time() const
+    {
+      return _sum(&AccountingSlot::execution_time);
+    }
+
+    uint64_t invocations() const
+    {
+      return _sum(&AccountingSlot::invocations);
+    }
+
+  private:
+    int _fd;
+    int _threads;
+    AccountingSlot* _slots;
+
+    static size_t _size(int threads)
+    {
+      return sizeof(AccountingSlot) * threads;
+    }
+
+    uint64_t _sum(std::atomic<uint64_t> AccountingSlot::* counter) const
+    {
+      uint64_t sum = 0;
+      for(int i = 0; i < _threads && _slots; ++i)
+        sum += (_slots[i].*counter).load(std::memory_order_relaxed);
+      return sum;
+    }
+
+    void _release()
+    {
+      if(_slots)
+        munmap(_slots, _size(_threads));
+      if(_fd != -1)
+        close(_fd);
+      _slots = nullptr;
+      _fd = -1;
+    }
+  };
+
+}}
+
+#endif
+
@@ -10,7 +10,12 @@ namespace rfaas { namespace common {
   enum class MessageIDs: uint32_t {
     NODE_REGISTRATION = 1,
     LEASE_ALLOCATION = 2,
-    LEASE_DEALLOCATION = 3
+    LEASE_DEALLOCATION = 3,
+    NODE_LIVENESS = 4,
+    NODE_CAPACITY = 5,
+    NODE_SUSPENDED = 6,
+    LEASE_REPORT = 7,
+    LEASE_CANCEL = 8
   };
 
   constexpr auto id_to_int(MessageIDs id) noexcept
@@ -29,6 +34,9 @@ namespace rfaas { namespace common {
 
   struct LeaseAllocation {
 
+    // Allocations sent to one executor manager in a single message.
+    static constexpr int MAX_BATCH = 16;
+
     const uint32_t message_id = id_to_int(MessageIDs::LEASE_ALLOCATION);
     int memory;
     int cores;
@@ -36,6 +44,68 @@ namespace rfaas { namespace common {
 
   };
 
+  // Sent by the resource manager to a registered executor manager.
+  // The manager writes its heartbeat to the slot with RDMA write every heartbeat_ms,
+  // and leases it holds are reclaimed when heartbeats stop for lease_ttl_ms.
+  // Leases not claimed by a client within lease_ttl_ms are returned by the executor manager.
+  struct NodeLiveness {
+
+    const uint32_t message_id = id_to_int(MessageIDs::NODE_LIVENESS);
+    uint32_t rkey;
+    uint64_t address;
+    int32_t heartbeat_ms;
+    int32_t lease_ttl_ms;
+
+  };
+
+  // Slot of the liveness table, advanced by each heartbeat.
+  struct NodeHeartbeat {
+
+    uint64_t sequence;
+
+  };
+
+  // Sent by the resource manager when it delegates cores of the node to the capacity table.
+  // Clients take them with RDMA atomics and allocate direct leases, and the executor manager
+  // returns cores of a finished direct lease with RDMA fetch-and-add on the counter.
+  struct NodeCapacitySlot {
+
+    const uint32_t message_id = id_to_int(MessageIDs::NODE_CAPACITY);
+    uint32_t rkey;
+    uint64_t address;
+    // Delegated resources - a direct lease can't take more than its share of the memory.
+    int32_t cores;
+    int32_t memory;
+
+  };
+
+  // Sent by the resource manager when heartbeats of a node resume after its leases were reclaimed.
+  // The executor manager reports each lease it still holds and sends the message back;
+  // the node receives new leases only then, and its running executors don't lose their cores.
+  struct NodeSuspended {
+
+    const uint32_t message_id = id_to_int(MessageIDs::NODE_SUSPENDED);
+
+  };
+
+  struct LeaseReport {
+
+    const uint32_t message_id = id_to_int(MessageIDs::LEASE_REPORT);
+    int32_t lease_id;
+    int32_t cores;
+    int32_t memory;
+
+  };
+
+  // Sent by the resource manager for an unclaimed lease that no client will receive.
+  // The executor manager drops it without a deallocation - its resources were already released.
+  struct LeaseCancel {
+
+    const uint32_t message_id = id_to_int(MessageIDs::LEASE_CANCEL);
+    int32_t lease_id;
+
+  };
+
   struct LeaseDeallocation {
 
     uint32_t message_id = id_to_int(MessageIDs::LEASE_DEALLOCATION);
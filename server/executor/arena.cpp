@@ -0,0 +1,77 @@
+
+#include <sys/mman.h>
+
+#include <spdlog/spdlog.h>
+
+#include "arena.hpp"
+
+namespace server {
+
+  Arena::Arena():
+    _memory(nullptr),
+    _size(0),
+    _offset(0),
+    _huge_pages(false)
+  {}
+
+  Arena::Arena(Arena && obj):
+    _memory(obj._memory),
+    _size(obj._size),
+    _offset(obj._offset),
+    _huge_pages(obj._huge_pages)
+  {
+    obj._memory = nullptr;
+    obj._size = obj._offset = 0;
+  }
+
+  Arena::~Arena()
+  {
+#ifdef RFAAS_ARENA_MALLOC
+    remove_malloc_arena(this);
+#endif
+    if(_memory)
+      munmap(_memory, _size);
+  }
+
+  bool Arena::map(size_t size)
+  {
+    if(!size)
+      return true;
+
+    // Explicit huge pages first - available only when reserved by the administrator.
+    constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    size_t huge_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void* ptr = mmap(
+      nullptr, huge_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0
+    );
+    if(ptr != MAP_FAILED) {
+      _huge_pages = true;
+      size = huge_size;
+    } else {
+      ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(ptr == MAP_FAILED) {
+        spdlog::error("Couldn't allocate arena of size {}, reason {}", size, strerror(errno));
+        return false;
+      }
+      // Transparent huge pages, if enabled; then pre-fault.
+      madvise(ptr, size, MADV_HUGEPAGE);
+      madvise(ptr, size, MADV_WILLNEED);
+      for(size_t i = 0; i < size; i += 4096)
+        static_cast<volatile char*>(ptr)[i] = 0;
+    }
+
+    _memory = static_cast<char*>(ptr);
+    _size = size;
+    _offset = 0;
+    SPDLOG_DEBUG("Allocated arena of size {}, huge pages {}", _size, _huge_pages);
+    return true;
+  }
+
+  void* Arena::allocate(void* arena, size_t size, size_t alignment)
+  {
+    return static_cast<Arena*>(arena)->allocate(size, alignment);
+  }
+
+}
+
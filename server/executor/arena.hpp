@@ -0,0 +1,75 @@
+
+#ifndef __SERVER_ARENA_HPP__
+#define __SERVER_ARENA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace server {
+
+  // Bump allocator for scratch memory of functions.
+  // Memory is mapped once per thread, backed by huge pages when possible,
+  // and pre-faulted. Reset after each invocation is O(1).
+  struct Arena
+  {
+    char* _memory;
+    size_t _size;
+    size_t _offset;
+    bool _huge_pages;
+
+    Arena();
+    Arena(Arena &&);
+    Arena(const Arena &) = delete;
+    Arena& operator=(const Arena &) = delete;
+    ~Arena();
+
+    // Should be called by the thread using the arena - first touch places pages on its NUMA node.
+    bool map(size_t size);
+
+    // Returns nullptr when the arena is exhausted.
+    inline void* allocate(size_t size, size_t alignment)
+    {
+      size_t begin = (reinterpret_cast<uintptr_t>(_memory) + _offset + alignment - 1) & ~(alignment - 1);
+      begin -= reinterpret_cast<uintptr_t>(_memory);
+      if(begin > _size || size > _size - begin)
+        return nullptr;
+      _offset = begin + size;
+      return _memory + begin;
+    }
+
+    inline void reset()
+    {
+      _offset = 0;
+    }
+
+    inline bool contains(const void* ptr) const
+    {
+      return ptr >= _memory && ptr < _memory + _size;
+    }
+
+    inline size_t size() const
+    {
+      return _size;
+    }
+
+    inline size_t used() const
+    {
+      return _offset;
+    }
+
+    static void* allocate(void* arena, size_t size, size_t alignment);
+  };
+
+#ifdef RFAAS_ARENA_MALLOC
+  // Registers the arena of the current thread; its pointers are recognized in all threads.
+  void set_malloc_arena(Arena* arena);
+  // Called before the arena is unmapped.
+  void remove_malloc_arena(const Arena* arena);
+  // Enabled only for the duration of an invocation.
+  void enable_malloc_arena(bool enabled);
+#endif
+
+}
+
+#endif
+
@@ -0,0 +1,252 @@
+
+// Serves malloc calls from the per-invocation arena, without LD_PRELOAD.
+// Symbols defined in the executor binary take precedence over libc,
+// including calls made from dlopened functions libraries.
+//
+// Only allocations made during an invocation are placed in the arena.
+// They are released in bulk after the invocation, and functions must
+// not keep such allocations, e.g., in static caches.
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "arena.hpp"
+
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void __libc_free(void* ptr);
+}
+
+namespace server {
+
+  namespace {
+
+    // No constructors - safe to access from malloc.
+    // The arena stays registered after the invocation to recognize its pointers in free.
+    __thread Arena* thread_arena = nullptr;
+    __thread bool arena_active = false;
+
+    // Arenas of all threads - their pointers can be freed by other threads of the process.
+    // Zero-initialized, and updated without locks; a range is published by its begin.
+    constexpr int MAX_ARENAS = 1024;
+    struct ArenaRange
+    {
+      std::atomic<const Arena*> owner;
+      std::atomic<uintptr_t> begin;
+      std::atomic<uintptr_t> end;
+    };
+    ArenaRange arenas[MAX_ARENAS];
+    std::atomic<int> arenas_count{0};
+
+    // Size stored before each allocation, to support realloc.
+    constexpr size_t HEADER_SIZE = 16;
+
+    void* arena_allocate(size_t size, size_t alignment)
+    {
+      if(alignment < HEADER_SIZE)
+        alignment = HEADER_SIZE;
+      if(size > SIZE_MAX - alignment)
+        return nullptr;
+      char* ptr = static_cast<char*>(thread_arena->allocate(size + alignment, alignment));
+      if(!ptr)
+        return nullptr;
+      ptr += alignment;
+      reinterpret_cast<size_t*>(ptr)[-1] = size;
+      return ptr;
+    }
+
+    size_t arena_size(void* ptr)
+    {
+      return reinterpret_cast<size_t*>(ptr)[-1];
+    }
+
+    bool in_arena(void* ptr)
+    {
+      if(thread_arena && thread_arena->contains(ptr))
+        return true;
+
+      uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+      int count = arenas_count.load(std::memory_order_acquire);
+      for(int i = 0; i < count; ++i) {
+        uintptr_t begin = arenas[i].begin.load(std::memory_order_acquire);
+        if(begin && address >= begin && address < arenas[i].end.load(std::memory_order_relaxed))
+          return true;
+      }
+      return false;
+    }
+
+    ArenaRange* find_range(const Arena* arena)
+    {
+      int count = arenas_count.load(std::memory_order_acquire);
+      for(int i = 0; i < count; ++i)
+        if(arenas[i].owner.load(std::memory_order_relaxed) == arena)
+          return &arenas[i];
+      return nullptr;
+    }
+
+    void register_range(const Arena* arena)
+    {
+      ArenaRange* range = find_range(arena);
+      for(int i = 0; !range && i < MAX_ARENAS; ++i) {
+        const Arena* expected = nullptr;
+        if(arenas[i].owner.compare_exchange_strong(expected, arena)) {
+          range = &arenas[i];
+          int count = arenas_count.load(std::memory_order_relaxed);
+          while(count < i + 1 && !arenas_count.compare_exchange_weak(count, i + 1));
+        }
+      }
+      // Pointers of a full table are freed only by their own thread.
+      if(!range)
+        return;
+
+      uintptr_t begin = reinterpret_cast<uintptr_t>(arena->_memory);
+      range->begin.store(0, std::memory_order_release);
+      range->end.store(begin + arena->size(), std::memory_order_relaxed);
+      range->begin.store(begin, std::memory_order_release);
+    }
+
+  }
+
+  void set_malloc_arena(Arena* arena)
+  {
+    thread_arena = arena;
+    if(arena)
+      register_range(arena);
+  }
+
+  void remove_malloc_arena(const Arena* arena)
+  {
+    if(thread_arena == arena)
+      thread_arena = nullptr;
+    if(ArenaRange* range = find_range(arena)) {
+      range->begin.store(0, std::memory_order_release);
+      range->end.store(0, std::memory_order_relaxed);
+      range->owner.store(nullptr, std::memory_order_release);
+    }
+  }
+
+  void enable_malloc_arena(bool enabled)
+  {
+    arena_active = enabled && thread_arena;
+  }
+
+}
+
+extern "C" {
+
+  void* malloc(size_t size)
+  {
+    if(server::arena_active) {
+      if(void* ptr = server::arena_allocate(size, 0))
+        return ptr;
+    }
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t n, size_t size)
+  {
+    if(size && n > SIZE_MAX / size) {
+      errno = ENOMEM;
+      return nullptr;
+    }
+    if(server::arena_active) {
+      // Arena pages are not zeroed after reset.
+      if(void* ptr = server::arena_allocate(n * size, 0)) {
+        memset(ptr, 0, n * size);
+        return ptr;
+      }
+    }
+    return __libc_calloc(n, size);
+  }
+
+  // Arena pointers are recognized in any thread, also outside of invocations.
+  void* realloc(void* ptr, size_t size)
+  {
+    if(ptr && server::in_arena(ptr)) {
+      size_t old_size = server::arena_size(ptr);
+      if(size <= old_size)
+        return ptr;
+      void* new_ptr = malloc(size);
+      if(new_ptr)
+        memcpy(new_ptr, ptr, old_size);
+      return new_ptr;
+    }
+    if(!ptr)
+      return malloc(size);
+    return __libc_realloc(ptr, size);
+  }
+
+  void free(void* ptr)
+  {
+    if(!ptr || server::in_arena(ptr))
+      return;
+    __libc_free(ptr);
+  }
+
+  void* memalign(size_t alignment, size_t size)
+  {
+    if(server::arena_active) {
+      if(void* ptr = server::arena_allocate(size, alignment))
+        return ptr;
+    }
+    return __libc_memalign(alignment, size);
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size)
+  {
+    return memalign(alignment, size);
+  }
+
+  void* valloc(size_t size)
+  {
+    return memalign(getpagesize(), size);
+  }
+
+  void* pvalloc(size_t size)
+  {
+    size_t page_size = getpagesize();
+    if(size > SIZE_MAX - page_size + 1) {
+      errno = ENOMEM;
+      return nullptr;
+    }
+    return memalign(page_size, (size + page_size - 1) & ~(page_size - 1));
+  }
+
+  // Arena allocations have no chunk header of glibc - report the requested size.
+  size_t malloc_usable_size(void* ptr)
+  {
+    if(!ptr)
+      return 0;
+    if(server::in_arena(ptr))
+      return server::arena_size(ptr);
+
+    // glibc exports no internal alias of this function.
+    using usable_size_t = size_t (*)(void*);
+    static std::atomic<usable_size_t> libc_usable_size{nullptr};
+    usable_size_t func = libc_usable_size.load(std::memory_order_relaxed);
+    if(!func) {
+      func = reinterpret_cast<usable_size_t>(dlsym(RTLD_NEXT, "malloc_usable_size"));
+      libc_usable_size.store(func, std::memory_order_relaxed);
+    }
+    return func ? func(ptr) : 0;
+  }
+
+  int posix_memalign(void** memptr, size_t alignment, size_t size)
+  {
+    void* ptr = memalign(alignment, size);
+    if(!ptr)
+      return ENOMEM;
+    *memptr = ptr;
+    return 0;
+  }
+
+}
+
@@ -1,11 +1,15 @@
 
+#include <atomic>
 #include <chrono>
 #include <stdexcept>
 #include <thread>
 #include <climits>
+#include <memory>
+#include <cstring>
 #include <sys/time.h>
 
 #include <signal.h>
+#include <unistd.h>
 #include <cxxopts.hpp>
 #include <spdlog/spdlog.h>
 
@@ -14,52 +18,156 @@
 #include "rdmalib/connection.hpp"
 #include "server.hpp"
 #include "fast_executor.hpp"
+#include "zygote.hpp"
+
+// Ends the lease of a kept-alive executor - threads stop polling and the zygote waits again.
+static void finish_lease(int)
+{
+  server::lease_finished.store(true);
+}
 
 int main(int argc, char ** argv)
 {
-  //server::SignalHandler sighandler;
-  auto opts = server::opts(argc, argv);
-  if(opts.verbose)
-    spdlog::set_level(spdlog::level::debug);
-  else
-    spdlog::set_level(spdlog::level::info);
-  spdlog::set_pattern("[%H:%M:%S:%f] [T %t] [%l] %v ");
-  spdlog::info(
-    "Executing serverless-rdma executor with {} cores! Waiting for client at {}:{}",
-    opts.fast_executors, opts.address, opts.port
-  );
-  spdlog::info(
-    "Configuration options: expecting function size {}, function payloads {},"
-    " receive WCs buffer size {}, max inline data {}, hot polling timeout {}",
-    opts.func_size, opts.msg_size, opts.recv_buffer_size, opts.max_inline_data,
-    opts.timeout
-  );
-  spdlog::info(
-    "My manager runs at {}:{}, its secret is {}, the accounting buffer is at {} with rkey {}",
-    opts.mgr_address, opts.mgr_port, opts.mgr_secret,
-    opts.accounting_buffer_addr, opts.accounting_buffer_rkey
-  );
+  // Zygotes are started by the manager ahead of leases: the arguments of
+  // a lease arrive over the standard input, once the runtime is initialized.
+  server::Zygote zygote;
+  std::vector<std::string> zygote_args;
+  std::vector<char*> zygote_argv;
+  char* program = argv[0];
+  bool is_zygote = argc == 3 && !strcmp(argv[1], "--zygote");
+  if(is_zygote) {
+    spdlog::set_pattern("[%H:%M:%S:%f] [T %t] [%l] %v ");
+    if(!zygote.prepare(argv[2]))
+      return 1;
+    // Restart the blocking read of arguments when the signal arrives late.
+    struct sigaction action{};
+    action.sa_handler = finish_lease;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR2, &action, nullptr);
+  }
+
+  // Kept-alive executors retain the library, and the device opened by the zygote, across leases.
+  std::unique_ptr<server::Functions> functions;
+  int accounting_fd = -1;
+  for(int lease = 0;; ++lease) {
+
+    if(is_zygote) {
+      zygote_args = server::Zygote::wait(STDIN_FILENO, accounting_fd);
+      if(zygote_args.empty()) {
+        spdlog::info("Zygote closed after {} leases", lease);
+        return 0;
+      }
+      // The signal ending the previous lease is always delivered before the manager sends new arguments.
+      server::lease_finished.store(false);
+      zygote_argv.clear();
+      zygote_argv.push_back(program);
+      for(auto & arg : zygote_args)
+        zygote_argv.push_back(arg.data());
+      zygote_argv.push_back(nullptr);
+      argc = zygote_argv.size() - 1;
+      argv = zygote_argv.data();
+    }
+
+    //server::SignalHandler sighandler;
+    auto opts = server::opts(argc, argv);
+    // The descriptor number passed by the manager is valid only for new processes.
+    if(is_zygote)
+      opts.accounting_fd = accounting_fd;
+    if(opts.verbose)
+      spdlog::set_level(spdlog::level::debug);
+    else
+      spdlog::set_level(spdlog::level::info);
+    spdlog::set_pattern("[%H:%M:%S:%f] [T %t] [%l] %v ");
+    spdlog::info(
+      "Executing serverless-rdma executor with {} cores! Waiting for client at {}:{}",
+      opts.fast_executors, opts.address, opts.port
+    );
+    spdlog::info(
+      "Configuration options: expecting function size {}, function payloads {},"
+      " receive WCs buffer size {}, max inline data {}, hot polling timeout {}",
+      opts.func_size, opts.msg_size, opts.recv_buffer_size, opts.max_inline_data,
+      opts.timeout
+    );
+    if(!opts.func_library.empty())
+      spdlog::info("Loading cached functions library {}", opts.func_library);
+#ifndef RFAAS_ARENA_MALLOC
+    if(opts.arena_malloc) {
+      spdlog::warn("Executor built without arena malloc support, option is ignored.");
+      opts.arena_malloc = false;
+    }
+#endif
+    spdlog::info(
+      "My manager runs at {}:{}, its secret is {}, the accounting buffer is at {} with rkey {}",
+      opts.mgr_address, opts.mgr_port, opts.mgr_secret,
+      opts.accounting_buffer_addr, opts.accounting_buffer_rkey
+    );
+    if(opts.accounting_fd != -1)
+      spdlog::info("Accounting is shared with the manager through descriptor {}", opts.accounting_fd);
+
+    executor::ManagerConnection mgr{
+      opts.mgr_address,
+      opts.mgr_port,
+      opts.mgr_secret,
+      opts.accounting_buffer_addr,
+      opts.accounting_buffer_rkey
+    };
+    // A lease that failed before loading the library leaves nothing to reuse.
+    if(!functions || functions->failed())
+      functions.reset(new server::Functions(opts.func_size, opts.func_library, opts.func_cache, opts.func_hash));
+    server::FastExecutors executor(
+      opts.address, opts.port,
+      *functions,
+      opts.fast_executors,
+      opts.msg_size,
+      opts.recv_buffer_size,
+      opts.max_inline_data,
+      opts.pin_threads,
+      opts.pin_cores,
+      opts.arena_size,
+      opts.arena_malloc,
+      opts.peer_transfers,
+      opts.keep_alive,
+      opts.trace_size,
+      opts.trace_file,
+      opts.accounting_fd,
+      mgr
+    );
 
-  executor::ManagerConnection mgr{
-    opts.mgr_address,
-    opts.mgr_port,
-    opts.mgr_secret,
-    opts.accounting_buffer_addr,
-    opts.accounting_buffer_rkey
-  };
-  server::FastExecutors executor(
-    opts.address, opts.port,
-    opts.func_size,
-    opts.fast_executors,
-    opts.msg_size,
-    opts.recv_buffer_size,
-    opts.max_inline_data,
-    opts.pin_threads,
-    mgr
-  );
+#ifdef RFAAS_TRACING
+    // Dump traces on demand - block the signal before creating threads, and wait for it in a single thread.
+    // Kept-alive executors write traces only at the end of each lease.
+    // The thread is stopped before the executor is destroyed.
+    std::thread trace_dumper;
+    std::atomic<bool> stop_dumper{false};
+    if(!opts.trace_file.empty() && !opts.keep_alive) {
+      sigset_t set;
+      sigemptyset(&set);
+      sigaddset(&set, SIGUSR1);
+      pthread_sigmask(SIG_BLOCK, &set, nullptr);
+      trace_dumper = std::thread{[set, &executor, &stop_dumper]() {
+        int sig;
+        while(!sigwait(&set, &sig) && !stop_dumper.load())
+          executor.dump_traces();
+      }};
+    }
+#endif
 
-  executor.allocate_threads(opts.timeout, opts.repetitions + opts.warmup_iters);
+    executor.allocate_threads(opts.timeout, opts.repetitions + opts.warmup_iters);
 
-  executor.close();
-  return 0;
+    executor.close();
+#ifdef RFAAS_TRACING
+    if(trace_dumper.joinable()) {
+      stop_dumper.store(true);
+      pthread_kill(trace_dumper.native_handle(), SIGUSR1);
+      trace_dumper.join();
+    }
+#endif
+    if(!is_zygote || !opts.keep_alive)
+      return 0;
+    // The manager parks the executor only after the acknowledgement.
+    if(!server::Zygote::acknowledge(STDIN_FILENO))
+      return 1;
+    spdlog::info("Lease finished, executor waits for the next one");
+  }
 }
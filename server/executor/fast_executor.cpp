@@ -1,6 +1,8 @@
 
 #include <chrono>
 #include <atomic>
+#include <cerrno>
+#include <cstring>
 #include <ostream>
 #include <sys/time.h>
 #include <sys/time.h>
@@ -20,34 +22,299 @@
 #include "server.hpp"
 #include "fast_executor.hpp"
 
+#include <poll.h>
 #include <sched.h>
 
 namespace server {
 
-  Accounting::timepoint_t Thread::work(int invoc_id, int func_id, bool solicited, uint32_t in_size)
+  std::atomic<bool> lease_finished{false};
+
+  uint32_t Thread::call(int func_id, void* in, uint32_t in_size, void* out)
+  {
+    // Only the user function allocates from the arena - not the chaining and forwarding around it.
+#ifdef RFAAS_ARENA_MALLOC
+    if(_arena_malloc)
+      enable_malloc_arena(true);
+#endif
+    uint32_t out_size = _functions.uses_context() ?
+      (*_functions.function_v2(func_id))(in, in_size, out, &_context) :
+      (*_functions.function(func_id))(in, in_size, out);
+#ifdef RFAAS_ARENA_MALLOC
+    if(_arena_malloc)
+      enable_malloc_arena(false);
+#endif
+    return out_size;
+  }
+
+  uint32_t Thread::execute_chain(const rdmalib::Buffer<char> & input, uint32_t in_size, uint32_t & status)
+  {
+    using rdmalib::functions::Chain;
+    const Chain* chain = reinterpret_cast<const Chain*>(input.data());
+    if(in_size < sizeof(Chain) || chain->length < 1 || chain->length > Chain::MAX_LENGTH) {
+      spdlog::error("Thread {} received an invalid function chain of size {}", id, in_size);
+      status = rdmalib::functions::INVALID_INVOCATION;
+      return 0;
+    }
+    for(int i = 0; i < chain->length; ++i) {
+      if(chain->functions[i] >= _functions._names.size()) {
+        spdlog::error("Thread {} received chain with unknown function {}", id, chain->functions[i]);
+        status = rdmalib::functions::INVALID_INVOCATION;
+        return 0;
+      }
+    }
+
+    // Ping-pong between two intermediate buffers; the last function writes to the send buffer.
+    uint32_t buf_size = send.size();
+    if(chain->length > 1 && !_chain_buffers)
+      _chain_buffers.reset(new char[2 * buf_size]);
+
+    void* in = input.data() + sizeof(Chain);
+    uint32_t size = in_size - sizeof(Chain);
+    for(int i = 0; i < chain->length; ++i) {
+      void* out = i == chain->length - 1 ? send.ptr() : _chain_buffers.get() + (i % 2) * buf_size;
+      SPDLOG_DEBUG("Thread {} executes chain stage {}, function {}, input size {}", id, i, _functions._names[chain->functions[i]], size);
+      size = call(chain->functions[i], in, size, out);
+      in = out;
+    }
+    return size;
+  }
+
+  uint32_t Thread::execute_forward(const rdmalib::Buffer<char> & input, uint32_t in_size, uint32_t & status)
+  {
+    using rdmalib::functions::Forward;
+    using rdmalib::functions::Submission;
+    const Forward* forward = reinterpret_cast<const Forward*>(input.data());
+    if(!_peer_out || in_size < sizeof(Forward) || forward->function >= _functions._names.size()) {
+      spdlog::error("Thread {} cannot forward an invocation of size {}, peer connected? {}", id, in_size, _peer_out != nullptr);
+      status = rdmalib::functions::INVALID_INVOCATION;
+      return 0;
+    }
+
+    uint32_t out_size = call(forward->function, input.data() + sizeof(Forward), in_size - sizeof(Forward), send.ptr());
+
+    // The downstream thread writes its result to the client's buffer.
+    Submission* header = reinterpret_cast<Submission*>(_peer_header.data());
+    header->r_address = forward->r_address;
+    header->r_key = forward->r_key;
+    rdmalib::ScatterGatherElement sge;
+    sge.add(_peer_header, Submission::DATA_HEADER_SIZE, 0);
+    sge.add(_peer_send, out_size, 0);
+    rdmalib::Connection & peer = _peer_out->connection();
+    // Wait until the downstream thread consumed the previous invocation.
+    while(_peer_credits == 0) {
+      auto wcs = peer.receive_wcs().poll(true);
+      _peer_credits += std::get<1>(wcs);
+      peer.receive_wcs().refill();
+    }
+    --_peer_credits;
+    peer.post_write(
+      std::move(sge),
+      _peer_input,
+      forward->submission,
+      out_size + Submission::DATA_HEADER_SIZE <= max_inline_data,
+      true
+    );
+    peer.poll_wc(rdmalib::QueueType::SEND, true);
+    SPDLOG_DEBUG("Thread {} forwarded {} bytes to the downstream executor", id, out_size);
+
+    // Only the completion notice goes back to the client.
+    return 0;
+  }
+
+  Accounting::timepoint_t Thread::control(const rdmalib::Buffer<char> & input, int invoc_id, int func_id, bool solicited, uint32_t in_size)
+  {
+    rdmalib::functions::Submission* header = reinterpret_cast<rdmalib::functions::Submission*>(input.ptr());
+    uint32_t status = rdmalib::functions::INVALID_INVOCATION;
+    uint32_t out_size = 0;
+    bool listen = static_cast<uint32_t>(func_id) == rdmalib::functions::PEER_LISTEN;
+
+    if(!_peer_transfers)
+      spdlog::error("Thread {} received a peer request, but direct transfers are disabled", id);
+    else if(listen)
+      status = peer_listen(out_size);
+    else if(in_size >= sizeof(rdmalib::functions::PeerInformation))
+      status = peer_connect(*reinterpret_cast<rdmalib::functions::PeerInformation*>(input.data()));
+
+    conn->post_write(
+      send.sge(out_size, 0),
+      {header->r_address, header->r_key},
+      (invoc_id << 16) | status,
+      out_size <= max_inline_data,
+      solicited
+    );
+
+    // The client connects the upstream thread after receiving our address.
+    if(listen && !status)
+      peer_accept();
+    return std::chrono::high_resolution_clock::now();
+  }
+
+  uint32_t Thread::peer_listen(uint32_t & out_size)
+  {
+    using rdmalib::functions::PeerInformation;
+    if(_peer_in || send.size() < sizeof(PeerInformation)) {
+      spdlog::error("Thread {} cannot accept another upstream executor", id);
+      return rdmalib::functions::INVALID_INVOCATION;
+    }
+
+    // The manager runs on the same node, and other executors can reach its address.
+    if(!_peer_listener) {
+      _peer_listener.reset(new rdmalib::RDMAPassive(_mgr_conn.addr, 0, _recv_buffer_size, true, max_inline_data));
+      _peer_rcv = rdmalib::Buffer<char>(rcv.data_size(), rdmalib::functions::Submission::DATA_HEADER_SIZE);
+      _peer_rcv.register_memory(_peer_listener->pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+    }
+
+    PeerInformation* info = reinterpret_cast<PeerInformation*>(send.ptr());
+    memset(info->address, 0, sizeof(info->address));
+    strncpy(info->address, _mgr_conn.addr.c_str(), sizeof(info->address) - 1);
+    info->port = _peer_listener->listen_port();
+    info->r_addr = _peer_rcv.address();
+    info->r_key = _peer_rcv.rkey();
+    out_size = sizeof(PeerInformation);
+    SPDLOG_DEBUG("Thread {} waits for an upstream executor at {}:{}", id, info->address, info->port);
+    return 0;
+  }
+
+  bool Thread::peer_accept()
+  {
+    while(true) {
+
+      if(!_peer_listener->nonblocking_poll_events(PEER_ACCEPT_TIMEOUT_MS)) {
+        spdlog::error("Thread {} timed out waiting for the upstream executor", id);
+        _peer_in.reset();
+        return false;
+      }
+
+      auto [peer, status] = _peer_listener->poll_events();
+      if(status == rdmalib::ConnectionStatus::REQUESTED) {
+        _peer_in.reset(peer);
+        _peer_in->receive_wcs().refill();
+        _peer_listener->accept(peer);
+      } else if(status == rdmalib::ConnectionStatus::ESTABLISHED) {
+        break;
+      } else {
+        spdlog::error("Thread {} unhandled connection event {} from the upstream executor", id, status);
+      }
+    }
+
+    // From now on, warm polling waits on both channels.
+    _client_poller = rdmalib::Poller{conn->qp()->recv_cq};
+    _peer_poller = rdmalib::Poller{_peer_in->qp()->recv_cq};
+    _peer_events.reset(new rdmalib::EventPoller{});
+    _peer_events->add_channel(_client_poller, 0);
+    _peer_events->add_channel(_peer_poller, 1);
+    _peer_in->notify_events();
+    spdlog::info("Thread {} Established connection to the upstream executor!", id);
+    return true;
+  }
+
+  uint32_t Thread::peer_connect(const rdmalib::functions::PeerInformation & info)
+  {
+    if(_peer_out) {
+      spdlog::error("Thread {} is already connected to a downstream executor", id);
+      return rdmalib::functions::INVALID_INVOCATION;
+    }
+
+    std::string address{info.address, strnlen(info.address, sizeof(info.address))};
+    _peer_out.reset(new rdmalib::RDMAActive(address, info.port, _recv_buffer_size, max_inline_data));
+    _peer_out->allocate();
+    // Credits arrive as sends without data.
+    _peer_out->connection().receive_wcs().refill();
+    if(!_peer_out->connect()) {
+      spdlog::error("Thread {} couldn't connect to the downstream executor at {}:{}", id, address, info.port);
+      _peer_out.reset();
+      return rdmalib::functions::INVALID_INVOCATION;
+    }
+
+    _peer_send = rdmalib::Buffer<char>(send.ptr(), send.bytes());
+    _peer_send.register_memory(_peer_out->pd(), IBV_ACCESS_LOCAL_WRITE);
+    _peer_header = rdmalib::Buffer<char>(rdmalib::functions::Submission::DATA_HEADER_SIZE);
+    _peer_header.register_memory(_peer_out->pd(), IBV_ACCESS_LOCAL_WRITE);
+    _peer_input = rdmalib::RemoteBuffer(info.r_addr, info.r_key);
+    _peer_credits = 1;
+    spdlog::info("Thread {} Established connection to the downstream executor {}:{}!", id, address, info.port);
+    return 0;
+  }
+
+  void Thread::peer_credit()
+  {
+    _peer_in->post_send(rdmalib::ScatterGatherElement{}, -1, false, 0);
+    _peer_in->poll_wc(rdmalib::QueueType::SEND, true);
+  }
+
+  bool Thread::wait_channel(int fd)
+  {
+    pollfd pfd{fd, POLLIN, 0};
+    int ret = poll(&pfd, 1, LEASE_CHECK_MS);
+    if(ret < 0 && errno != EINTR)
+      spdlog::error("Thread {} failed to wait for events, reason {}", id, strerror(errno));
+    return ret > 0;
+  }
+
+  void Thread::wait_events()
+  {
+    if(!_peer_in) {
+      // Blocking wait would miss the end of the lease.
+      if(_keep_alive && !wait_channel(conn->completion_channel()->fd))
+        return;
+      auto cq = conn->wait_events();
+      conn->ack_events(cq, 1);
+      conn->notify_events();
+      return;
+    }
+
+    // Channels are non-blocking after adding them to epoll - only some of them have events.
+    _peer_events->poll(_keep_alive ? LEASE_CHECK_MS : -1);
+    for(rdmalib::Poller* poller : {&_client_poller, &_peer_poller}) {
+      ibv_cq* cq = poller->wait_events();
+      if(cq) {
+        poller->ack_events(cq, 1);
+        poller->notify_events(false);
+      }
+    }
+  }
+
+  Accounting::timepoint_t Thread::work(const rdmalib::Buffer<char> & input, int invoc_id, int func_id, bool solicited, uint32_t in_size)
   {
     // FIXME: load func ptr
-    rdmalib::functions::Submission* header = reinterpret_cast<rdmalib::functions::Submission*>(rcv.ptr());
-    auto ptr = _functions.function(func_id);
+    if(rdmalib::functions::is_control(func_id))
+      return control(input, invoc_id, func_id, solicited, in_size);
+    rdmalib::functions::Submission* header = reinterpret_cast<rdmalib::functions::Submission*>(input.ptr());
+    bool chain = static_cast<uint32_t>(func_id) == rdmalib::functions::Chain::FUNCTION_ID;
+    bool forward = static_cast<uint32_t>(func_id) == rdmalib::functions::Forward::FUNCTION_ID;
 
     SPDLOG_DEBUG("Thread {} begins work! Executing function {} with size {}, invoc id {}, solicited reply? {}",
-      id, _functions._names[func_id], in_size, invoc_id, solicited
+      id, chain ? "chain" : forward ? "forward" : _functions._names[func_id], in_size, invoc_id, solicited
     );
     auto start = std::chrono::high_resolution_clock::now();
+    RFAAS_TRACE(_tracer, TraceEvent::FUNCTION_START, invoc_id, func_id);
     // Data to ignore header passed in the buffer
-    uint32_t out_size = (*ptr)(rcv.data(), in_size, send.ptr());
+    uint32_t status = 0;
+    uint32_t out_size = chain ?
+      execute_chain(input, in_size, status) :
+      forward ?
+        execute_forward(input, in_size, status) :
+        call(func_id, input.data(), in_size, send.ptr());
+    _arena.reset();
+    RFAAS_TRACE(_tracer, TraceEvent::FUNCTION_END, invoc_id, func_id);
     SPDLOG_DEBUG("Thread {} finished work!", id);
 
+    // The result header was read - the upstream thread can write the next input.
+    rdmalib::functions::Submission reply = *header;
+    if(&input == &_peer_rcv)
+      peer_credit();
+
     // Send back: the value of immediate write
     // first 16 bytes - invocation id
     // second 16 bytes - return value (0 on no error)
     conn->post_write(
       send.sge(out_size, 0),
-      {header->r_address, header->r_key},
-      (invoc_id << 16) | 0,
+      {reply.r_address, reply.r_key},
+      (invoc_id << 16) | status,
       out_size <= max_inline_data,
       solicited
     );
+    RFAAS_TRACE(_tracer, TraceEvent::RESULT_POST, invoc_id, func_id);
     auto end = std::chrono::high_resolution_clock::now();
     _accounting.update_execution_time(start, end);
     _accounting.send_updated_execution(_mgr_connection, _accounting_buf, _mgr_conn);
@@ -63,10 +330,16 @@ namespace server {
 
     auto start = std::chrono::high_resolution_clock::now();
     int i = 0;
-    while(repetitions < max_repetitions) {
+    while(repetitions < max_repetitions && !lease_finished.load(std::memory_order_relaxed)) {
 
       // if we block, we never handle the interruption
-      auto wcs = this->conn->receive_wcs().poll();
+      // Invocations forwarded by an upstream executor arrive on a separate connection.
+      rdmalib::RecvWorkCompletions* queue = &this->conn->receive_wcs();
+      auto wcs = queue->poll();
+      if(!std::get<1>(wcs) && _peer_in) {
+        queue = &_peer_in->receive_wcs();
+        wcs = queue->poll();
+      }
       if(std::get<1>(wcs)) {
         for(int i = 0; i < std::get<1>(wcs); ++i) {
 
@@ -85,9 +358,12 @@ namespace server {
             id, invoc_id, func_id, repetitions
           );
 
+          RFAAS_TRACE(_tracer, TraceEvent::POLL_HIT, invoc_id, func_id);
           // Measure hot polling time until we started execution
           auto now = std::chrono::high_resolution_clock::now();
-          auto func_end = work(invoc_id, func_id, solicited,
+          auto func_end = work(
+              queue == &this->conn->receive_wcs() ? rcv : _peer_rcv,
+              invoc_id, func_id, solicited,
               wc->byte_len - rdmalib::functions::Submission::DATA_HEADER_SIZE
           );
           _accounting.update_polling_time(start, now);
@@ -96,9 +372,11 @@ namespace server {
 
           //sum += server_processing_times.end();
           conn->poll_wc(rdmalib::QueueType::SEND, true);
-          repetitions += 1;
+          RFAAS_TRACE(_tracer, TraceEvent::SEND_COMPLETION);
+          if(!rdmalib::functions::is_control(func_id))
+            repetitions += 1;
         }
-        this->conn->receive_wcs().refill();
+        queue->refill();
       }
       ++i;
 
@@ -111,8 +389,11 @@ namespace server {
 
         if(_polling_state != PollingState::HOT_ALWAYS && time_passed >= timeout) {
           _polling_state = PollingState::WARM;
+          RFAAS_TRACE(_tracer, TraceEvent::HOT_TO_WARM);
           // FIXME: can we miss an event here?
           conn->notify_events();
+          if(_peer_in)
+            _peer_in->notify_events();
           SPDLOG_DEBUG("Switching to warm polling after {} us with no invocations", time_passed);
           return;
         }
@@ -127,10 +408,15 @@ namespace server {
     // FIXME: this should be automatic
     SPDLOG_DEBUG("Thread {} Begins warm polling", id);
 
-    while(repetitions < max_repetitions) {
+    while(repetitions < max_repetitions && !lease_finished.load(std::memory_order_relaxed)) {
 
       // if we block, we never handle the interruption
-      auto wcs = this->conn->receive_wcs().poll();
+      rdmalib::RecvWorkCompletions* queue = &this->conn->receive_wcs();
+      auto wcs = queue->poll();
+      if(!std::get<1>(wcs) && _peer_in) {
+        queue = &_peer_in->receive_wcs();
+        wcs = queue->poll();
+      }
       if(std::get<1>(wcs)) {
         for(int i = 0; i < std::get<1>(wcs); ++i) {
 
@@ -149,50 +435,84 @@ namespace server {
             id, invoc_id, func_id, repetitions
           );
 
-          work(invoc_id, func_id, solicited, wc->byte_len - rdmalib::functions::Submission::DATA_HEADER_SIZE);
+          RFAAS_TRACE(_tracer, TraceEvent::POLL_HIT, invoc_id, func_id);
+          work(
+            queue == &this->conn->receive_wcs() ? rcv : _peer_rcv,
+            invoc_id, func_id, solicited, wc->byte_len - rdmalib::functions::Submission::DATA_HEADER_SIZE
+          );
 
           //sum += server_processing_times.end();
           conn->poll_wc(rdmalib::QueueType::SEND, true);
-          repetitions += 1;
+          RFAAS_TRACE(_tracer, TraceEvent::SEND_COMPLETION);
+          if(!rdmalib::functions::is_control(func_id))
+            repetitions += 1;
         }
-        this->conn->receive_wcs().refill();
+        queue->refill();
         if(_polling_state != PollingState::WARM_ALWAYS) {
           SPDLOG_DEBUG("Switching to hot polling after invocation!");
           _polling_state = PollingState::HOT;
+          RFAAS_TRACE(_tracer, TraceEvent::WARM_TO_HOT);
           return;
         }
       }
 
       // Do waiting after a single polling - avoid missing an events that
       // arrived before we called notify_events
-      if(repetitions < max_repetitions) {
-        auto cq = conn->wait_events();
-        conn->ack_events(cq, 1);
-        conn->notify_events();
-      }
+      if(repetitions < max_repetitions && !lease_finished.load(std::memory_order_relaxed))
+        wait_events();
     }
     SPDLOG_DEBUG("Thread {} Stopped warm polling", id);
   }
 
   void Thread::thread_work(int timeout)
   {
-    rdmalib::RDMAActive mgr_connection(_mgr_conn.addr, _mgr_conn.port, _recv_buffer_size, max_inline_data);
-    mgr_connection.allocate();
-    this->_mgr_connection = &mgr_connection.connection();
-    _accounting_buf.register_memory(mgr_connection.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_ATOMIC);
-    if(!mgr_connection.connect(_mgr_conn.secret))
+    // Other threads wait for thread 0 to load the library - release them when it stops early.
+    auto abandon_library = [this]() {
+      if(id == 0)
+        _functions.fail_library();
+    };
+
+    // Map the arena from the (possibly pinned) thread to get NUMA-local memory.
+    if(!_arena.map(_arena_size)) {
+      abandon_library();
       return;
-    spdlog::info("Thread {} Established connection to the manager!", id);
+    }
+    _context.arena = &_arena;
+    _context.arena_size = _arena.size();
+#ifdef RFAAS_ARENA_MALLOC
+    if(_arena_malloc)
+      set_malloc_arena(&_arena);
+#endif
+
+    // The manager connection only carries accounting updates - not needed with a shared page.
+    std::unique_ptr<rdmalib::RDMAActive> mgr_connection;
+    if(!_accounting.slot) {
+      mgr_connection.reset(new rdmalib::RDMAActive(_mgr_conn.addr, _mgr_conn.port, _recv_buffer_size, max_inline_data));
+      mgr_connection->allocate();
+      this->_mgr_connection = &mgr_connection->connection();
+      _accounting_buf.register_memory(mgr_connection->pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_ATOMIC);
+      if(!mgr_connection->connect(_mgr_conn.secret)) {
+        abandon_library();
+        return;
+      }
+      spdlog::info("Thread {} Established connection to the manager!", id);
+    }
 
     rdmalib::RDMAActive active(addr, port, _recv_buffer_size, max_inline_data);
     rdmalib::Buffer<char> func_buffer(_functions.memory(), _functions.size());
+    // The library is sent once per process, and only when it's not cached locally.
+    // Kept-alive executors reuse the library loaded in a previous lease.
+    bool reuse_library = _functions.loaded();
+    bool receive_library = id == 0 && _functions.requires_transfer() && !reuse_library;
 
     active.allocate();
     this->conn = &active.connection();
     // Receive function data from the client - this WC must be posted first
     // We do it before connection to ensure that client does not start sending before us
-    func_buffer.register_memory(active.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
-    this->conn->post_recv(func_buffer);
+    if(receive_library) {
+      func_buffer.register_memory(active.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+      this->conn->post_recv(func_buffer);
+    }
 
     // Request notification before connecting - avoid missing a WC!
     // Do it only when starting from a warm directly
@@ -206,8 +526,10 @@ namespace server {
     if(_polling_state == PollingState::WARM_ALWAYS || _polling_state == PollingState::WARM)
       conn->notify_events();
 
-    if(!active.connect())
+    if(!active.connect(receive_library ? rdmalib::functions::LIBRARY_RECEIVER : 0)) {
+      abandon_library();
       return;
+    }
 
     // Now generic receives for function invocations
     send.register_memory(active.pd(), IBV_ACCESS_LOCAL_WRITE);
@@ -225,15 +547,24 @@ namespace server {
     this->conn->poll_wc(rdmalib::QueueType::SEND, true, 1);
     SPDLOG_DEBUG("Thread {} Sent buffer details to client!", id);
 
-    // We should have received functions data - just one message
-    this->conn->poll_wc(rdmalib::QueueType::RECV, true, 1);
-    _functions.process_library();
+    if(reuse_library) {
+      SPDLOG_DEBUG("Thread {} reuses the functions library of the previous lease", id);
+    } else if(id == 0) {
+      // We should have received functions data - just one message
+      if(receive_library)
+        this->conn->poll_wc(rdmalib::QueueType::RECV, true, 1);
+      _functions.process_library();
+      _functions.store_library();
+    } else if(!_functions.wait_library()) {
+      spdlog::error("Thread {} stops, the functions library was not loaded", id);
+      return;
+    }
 
     this->conn->receive_wcs().refill();
     spdlog::info("Thread {} begins work with timeout {}", id, timeout);
 
     // FIXME: catch interrupt handler here
-    while(repetitions < max_repetitions) {
+    while(repetitions < max_repetitions && !lease_finished.load(std::memory_order_relaxed)) {
       if(_polling_state == PollingState::HOT || _polling_state == PollingState::HOT_ALWAYS)
         hot(timeout);
       else
@@ -243,7 +574,8 @@ namespace server {
     // Submit final accounting information
     _accounting.send_updated_execution(_mgr_connection, _accounting_buf, _mgr_conn, true, false);
     _accounting.send_updated_polling(_mgr_connection, _accounting_buf, _mgr_conn, true, false);
-    mgr_connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 2);
+    if(mgr_connection)
+      mgr_connection->connection().poll_wc(rdmalib::QueueType::SEND, true, 2);
     spdlog::info(
       "Thread {} finished work, spent {} ns hot polling and {} ns computation, {} executions.",
       id, _accounting.total_hot_polling_time , _accounting.total_execution_time, repetitions
@@ -253,27 +585,55 @@ namespace server {
   }
 
   FastExecutors::FastExecutors(std::string client_addr, int port,
-      int func_size,
+      Functions & functions,
       int numcores,
       int msg_size,
       int recv_buf_size,
       int max_inline_data,
       int pin_threads,
+      const std::vector<int> & pin_cores,
+      size_t arena_size,
+      bool arena_malloc,
+      bool peer_transfers,
+      bool keep_alive,
+      size_t trace_size,
+      const std::string & trace_file,
+      int accounting_fd,
       const executor::ManagerConnection & mgr_conn
   ):
+    _functions(functions),
     _closing(false),
     _numcores(numcores),
     _max_repetitions(0),
-    _pin_threads(pin_threads)
+    _pin_threads(pin_threads),
+    _pin_cores(pin_cores),
+    _arena_size(arena_size),
+    _arena_malloc(arena_malloc),
+    _peer_transfers(peer_transfers),
+    _trace_file(trace_file)
     //_mgr_conn(mgr_conn)
   {
     // Reserve place to ensure that no reallocations happen
     _threads_data.reserve(numcores);
     for(int i = 0; i < numcores; ++i)
       _threads_data.emplace_back(
-        client_addr, port, i, func_size, msg_size,
-        recv_buf_size, max_inline_data, mgr_conn
+        client_addr, port, i, _functions, msg_size,
+        recv_buf_size, max_inline_data, arena_size, arena_malloc, peer_transfers, keep_alive, mgr_conn
       );
+    if(accounting_fd != -1) {
+      if(_accounting_page.map(accounting_fd, numcores)) {
+        for(int i = 0; i < numcores; ++i)
+          _threads_data[i]._accounting.slot = _accounting_page.slot(i);
+      } else
+        spdlog::warn("Couldn't map the accounting page, reason {}, using the manager connection", strerror(errno));
+    }
+#ifdef RFAAS_TRACING
+    for(auto & thread : _threads_data)
+      thread._tracer.allocate(trace_size);
+#else
+    if(trace_size)
+      spdlog::warn("Executor built without tracing support, trace size is ignored.");
+#endif
   }
 
   FastExecutors::~FastExecutors()
@@ -307,9 +667,22 @@ namespace server {
         thread.repetitions,
         static_cast<double>(thread._accounting.total_execution_time) / thread.repetitions / 1000.0
       );
+    dump_traces();
     _closing = true;
   }
 
+  void FastExecutors::dump_traces()
+  {
+#ifdef RFAAS_TRACING
+    if(_trace_file.empty())
+      return;
+    std::vector<const Tracer*> tracers;
+    for(auto & thread : _threads_data)
+      tracers.push_back(&thread._tracer);
+    server::dump_traces(_trace_file, tracers);
+#endif
+  }
+
   void FastExecutors::allocate_threads(int timeout, int iterations)
   {
     int pin_threads = _pin_threads;
@@ -321,11 +694,15 @@ namespace server {
         timeout
       );
       // FIXME: make sure that native handle is actually from pthreads
-      if(pin_threads != -1) {
-        spdlog::info("Pin thread to core {}", pin_threads);
+      // Cores assigned by the manager take precedence over consecutive cores.
+      int core = static_cast<size_t>(i) < _pin_cores.size() ? _pin_cores[i] : pin_threads;
+      if(core != -1) {
+        spdlog::info("Pin thread to core {}", core);
+        if(pin_threads != -1)
+          ++pin_threads;
         cpu_set_t cpuset;
         CPU_ZERO(&cpuset);
-        CPU_SET(pin_threads++, &cpuset);
+        CPU_SET(core, &cpuset);
         rdmalib::impl::expect_zero(pthread_setaffinity_np(
           _threads[i].native_handle(),
           sizeof(cpu_set_t), &cpuset
@@ -12,9 +12,13 @@
 #include <rdmalib/buffer.hpp>
 #include <rdmalib/connection.hpp>
 #include <rdmalib/functions.hpp>
+#include <rdmalib/poller.hpp>
 
+#include "arena.hpp"
 #include "functions.hpp"
+#include "tracing.hpp"
 #include "common.hpp"
+#include "common/accounting_page.hpp"
 #include <spdlog/spdlog.h>
 
 using namespace std::chrono_literals;
@@ -25,6 +29,10 @@ namespace rdmalib {
 
 namespace server {
 
+  // Set by SIGUSR2 when the manager ends the lease of a kept-alive executor.
+  // Threads stop polling, and the process waits for the next lease.
+  extern std::atomic<bool> lease_finished;
+
   struct Accounting {
     typedef std::chrono::high_resolution_clock clock_t;
     typedef std::chrono::time_point<std::chrono::high_resolution_clock> timepoint_t;
@@ -34,12 +42,16 @@ namespace server {
     uint64_t total_execution_time; 
     uint64_t hot_polling_time;
     uint64_t execution_time; 
+    uint64_t invocations;
+    // Shared with the local manager; counters are stored there instead of RDMA atomics.
+    rfaas::common::AccountingSlot* slot;
 
     inline void update_execution_time(timepoint_t start, timepoint_t end)
     {
       auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
       execution_time += diff;
       total_execution_time += diff;
+      invocations += 1;
     }
 
     inline void send_updated_execution(
@@ -49,6 +61,12 @@ namespace server {
       bool wait = true
     )
     {
+      if(slot) {
+        slot->execution_time.store(total_execution_time, std::memory_order_relaxed);
+        slot->invocations.store(invocations, std::memory_order_relaxed);
+        execution_time = 0;
+        return;
+      }
       if(force || execution_time > BILLING_GRANULARITY) {
         mgr_connection->post_atomic_fadd(
           _accounting_buf,
@@ -79,6 +97,11 @@ namespace server {
       bool wait = true
     )
     {
+      if(slot) {
+        slot->hot_polling_time.store(total_hot_polling_time, std::memory_order_relaxed);
+        hot_polling_time = 0;
+        return;
+      }
       if(force || hot_polling_time > BILLING_GRANULARITY) {
         // Can happen when we didn't got into polling and were stopped right after execution
         if(hot_polling_time == 0)
@@ -110,7 +133,8 @@ namespace server {
 
     constexpr static int invocation_mask = 0x00007FFF;
     constexpr static int solicited_mask = 0x00008000;
-    Functions _functions;
+    // Shared by all threads - received by the first thread only.
+    Functions & _functions;
     std::string addr;
     int port;
     uint32_t  max_inline_data;
@@ -127,11 +151,42 @@ namespace server {
     // FIXME: Adjust to billing granularity
     constexpr static int HOT_POLLING_VERIFICATION_PERIOD = 10000;
     PollingState _polling_state;
+    // Scratch memory for functions, mapped by the thread itself.
+    size_t _arena_size;
+    bool _arena_malloc;
+    Arena _arena;
+    rfaas::function_context _context;
+    // Empty unless built with tracing.
+    Tracer _tracer;
+    // Intermediate results of function chains, allocated by the first chain with more than one function.
+    std::unique_ptr<char[]> _chain_buffers;
+    // Direct transfers between executor threads, see rdmalib::functions::Forward.
+    constexpr static int PEER_ACCEPT_TIMEOUT_MS = 5000;
+    bool _peer_transfers;
+    // Downstream side: listener, connection from the upstream thread, and
+    // a separate input buffer - client invocations can arrive at the same time.
+    // A credit goes back to the upstream thread once the input was consumed.
+    std::unique_ptr<rdmalib::RDMAPassive> _peer_listener;
+    std::unique_ptr<rdmalib::Connection> _peer_in;
+    rdmalib::Buffer<char> _peer_rcv;
+    // Warm polling waits on completion channels of both connections.
+    std::unique_ptr<rdmalib::EventPoller> _peer_events;
+    rdmalib::Poller _client_poller, _peer_poller;
+    // Upstream side: connection to the downstream thread and its input buffer.
+    // The buffer holds one invocation - we write only with a credit.
+    std::unique_ptr<rdmalib::RDMAActive> _peer_out;
+    rdmalib::Buffer<char> _peer_send, _peer_header;
+    rdmalib::RemoteBuffer _peer_input;
+    int _peer_credits;
+    // Warm polling wakes up periodically to notice the end of the lease.
+    constexpr static int LEASE_CHECK_MS = 100;
+    bool _keep_alive;
 
-    Thread(std::string addr, int port, int id, int functions_size,
+    Thread(std::string addr, int port, int id, Functions & functions,
         int buf_size, int recv_buffer_size, int max_inline_data,
+        size_t arena_size, bool arena_malloc, bool peer_transfers, bool keep_alive,
         const executor::ManagerConnection & mgr_conn):
-      _functions(functions_size),
+      _functions(functions),
       addr(addr),
       port(port),
       max_inline_data(max_inline_data),
@@ -145,12 +200,29 @@ namespace server {
       // +1 to handle batching of functions work completions + initial code submission
       conn(nullptr),
       _mgr_conn(mgr_conn),
-      _accounting({0,0,0,0}),
-      _accounting_buf(1)
+      _accounting({0,0,0,0,0,nullptr}),
+      _accounting_buf(1),
+      _arena_size(arena_size),
+      _arena_malloc(arena_malloc),
+      _context{nullptr, &Arena::allocate, 0, static_cast<uint32_t>(id)},
+      _peer_transfers(peer_transfers),
+      _peer_credits(0),
+      _keep_alive(keep_alive)
     {
     }
 
-    Accounting::timepoint_t work(int invoc_id, int func_id, bool solicited, uint32_t in_size);
+    // The input is either rcv or _peer_rcv, depending on the connection of the invocation.
+    Accounting::timepoint_t work(const rdmalib::Buffer<char> & input, int invoc_id, int func_id, bool solicited, uint32_t in_size);
+    inline uint32_t call(int func_id, void* in, uint32_t in_size, void* out);
+    uint32_t execute_chain(const rdmalib::Buffer<char> & input, uint32_t in_size, uint32_t & status);
+    uint32_t execute_forward(const rdmalib::Buffer<char> & input, uint32_t in_size, uint32_t & status);
+    Accounting::timepoint_t control(const rdmalib::Buffer<char> & input, int invoc_id, int func_id, bool solicited, uint32_t in_size);
+    uint32_t peer_listen(uint32_t & out_size);
+    bool peer_accept();
+    uint32_t peer_connect(const rdmalib::functions::PeerInformation & info);
+    void peer_credit();
+    bool wait_channel(int fd);
+    void wait_events();
     void hot(uint32_t hot_timeout);
     void warm();
     void thread_work(int timeout);
@@ -158,6 +230,8 @@ namespace server {
 
   struct FastExecutors {
 
+    // Owned by the caller - kept-alive executors retain the library across leases.
+    Functions & _functions;
     std::vector<Thread> _threads_data;
     std::vector<std::thread> _threads;
     bool _closing;
@@ -165,22 +239,39 @@ namespace server {
     int _max_repetitions;
     int _warmup_iters;
     int _pin_threads;
+    std::vector<int> _pin_cores;
+    size_t _arena_size;
+    bool _arena_malloc;
+    bool _peer_transfers;
+    std::string _trace_file;
+    // Mapped when the manager passed an accounting page, one slot per thread.
+    rfaas::common::AccountingPage _accounting_page;
     //const ManagerConnection & _mgr_conn;
 
     FastExecutors(
       std::string client_addr, int port,
-      int function_size,
+      Functions & functions,
       int numcores,
       int msg_size,
       int recv_buf_size,
       int max_inline_data,
       int pin_threads,
+      const std::vector<int> & pin_cores,
+      size_t arena_size,
+      bool arena_malloc,
+      bool peer_transfers,
+      bool keep_alive,
+      size_t trace_size,
+      const std::string & trace_file,
+      int accounting_fd,
       const executor::ManagerConnection & mgr_conn
     );
     ~FastExecutors();
 
     void close();
     void allocate_threads(int, int);
+    // Safe to call while threads are running.
+    void dump_traces();
   };
 
 }
@@ -1,11 +1,16 @@
 
 #include <algorithm>
+#include <thread>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/sendfile.h>
 
 #include <spdlog/spdlog.h>
 
 #include <rdmalib/util.hpp>
+#include <rfaas/library.hpp>
+
 #include "functions.hpp"
 
 // FIXME: works only on Linux
@@ -54,42 +59,132 @@ namespace server {
     std::sort(names.begin(), names.end());
   }
 
-  Functions::Functions(size_t size):
+  Functions::Functions(size_t size, const std::string & library_path, const std::string & cache_path, uint64_t hash):
+    _fd(-1),
+    _memory_handle(nullptr),
     _size(size),
-    _library_handle(nullptr)
+    _library_handle(nullptr),
+    _library_path(library_path),
+    _cache_path(cache_path),
+    _hash(hash),
+    _state(State::PENDING),
+    _version(1)
   {
+    // Library is already available locally
+    if(!_library_path.empty())
+      return;
+
     // FIXME: works only on Linux
     rdmalib::impl::expect_nonnegative(_fd = memfd_create("libfunction", 0));
     rdmalib::impl::expect_zero(ftruncate(_fd, size));
 
     rdmalib::impl::expect_nonnull(
-      _memory_handle = mmap(NULL, size, PROT_WRITE, MAP_SHARED, _fd, 0)
+      _memory_handle = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0)
     );
   }
 
   Functions::~Functions()
   {
-    munmap(_memory_handle, _size);
+    if(_memory_handle)
+      munmap(_memory_handle, _size);
+    if(_fd != -1)
+      close(_fd);
     if(_library_handle)
       dlclose(_library_handle);
   }
 
+  bool Functions::requires_transfer() const
+  {
+    return _library_path.empty();
+  }
+
   void Functions::process_library()
   {
-    //FILE* pFile = fopen("examples/libfunctions.so" , "rb");
-    //fseek (pFile , 0 , SEEK_END);
-    //size_t len = ftell(pFile);
-    //rewind(pFile);
-    //fread(_memory_handle,1,len,pFile);
+    std::string path = _library_path.empty() ? "/proc/self/fd/" + std::to_string(_fd) : _library_path;
     rdmalib::impl::expect_nonnull(
       _library_handle = dlopen(
-        ("/proc/self/fd/" + std::to_string(_fd)).c_str(),
+        path.c_str(),
         RTLD_NOW
       ),
       [](){ spdlog::error(dlerror()); }
     );
     extract_symbols(_library_handle, _names);
+    // Resolve all symbols now - the table is later read concurrently by all threads.
     _functions.resize(_names.size(), nullptr);
+    for(size_t i = 0; i < _names.size(); ++i)
+      _functions[i] = dlsym(_library_handle, _names[i].c_str());
+    auto version = reinterpret_cast<const uint32_t*>(dlsym(_library_handle, "rfaas_functions_version"));
+    if(version)
+      _version = *version;
+    SPDLOG_DEBUG("Loaded {} functions, calling convention version {}", _names.size(), _version);
+
+    _state.store(State::READY, std::memory_order_release);
+  }
+
+  void Functions::fail_library()
+  {
+    // A library loaded in a previous lease stays valid.
+    State expected = State::PENDING;
+    _state.compare_exchange_strong(expected, State::FAILED, std::memory_order_release);
+  }
+
+  bool Functions::wait_library() const
+  {
+    State state;
+    while((state = _state.load(std::memory_order_acquire)) == State::PENDING)
+      std::this_thread::yield();
+    return state == State::READY;
+  }
+
+  bool Functions::loaded() const
+  {
+    return _state.load(std::memory_order_acquire) == State::READY;
+  }
+
+  bool Functions::failed() const
+  {
+    return _state.load(std::memory_order_acquire) == State::FAILED;
+  }
+
+  bool Functions::store_library() const
+  {
+    if(_cache_path.empty() || !requires_transfer())
+      return false;
+
+    // Other clients load the file by its hash - never trust the claim of the sender.
+    uint64_t hash = rfaas::library::content_hash(static_cast<const char*>(_memory_handle), _size);
+    if(hash != _hash) {
+      spdlog::error("Received library has hash {:x} instead of {:x}, not caching it", hash, _hash);
+      return false;
+    }
+
+    // Write to a temporary file first - the manager treats existing files as complete.
+    std::string tmp_path = _cache_path + ".tmp." + std::to_string(getpid());
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(fd < 0) {
+      spdlog::error("Couldn't store the library in cache {}, reason {}", tmp_path, strerror(errno));
+      return false;
+    }
+
+    off_t offset = 0;
+    while(static_cast<size_t>(offset) < _size) {
+      ssize_t ret = sendfile(fd, _fd, &offset, _size - offset);
+      if(ret <= 0) {
+        spdlog::error("Couldn't store the library in cache {}, reason {}", tmp_path, strerror(errno));
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+      }
+    }
+    close(fd);
+
+    if(rename(tmp_path.c_str(), _cache_path.c_str())) {
+      spdlog::error("Couldn't store the library in cache {}, reason {}", _cache_path, strerror(errno));
+      unlink(tmp_path.c_str());
+      return false;
+    }
+    SPDLOG_DEBUG("Stored library of size {} in cache {}", _size, _cache_path);
+    return true;
   }
 
   size_t Functions::size() const
@@ -102,12 +197,18 @@ namespace server {
     return this->_memory_handle;
   }
 
-  Functions::FuncType Functions::function(int idx)
+  Functions::FuncType Functions::function(int idx) const
   {
-    if(!_functions[idx]) {
-      _functions[idx] = dlsym(_library_handle, _names[idx].c_str());
-    }
     return reinterpret_cast<FuncType>(_functions[idx]);
   }
-}
 
+  Functions::FuncTypeV2 Functions::function_v2(int idx) const
+  {
+    return reinterpret_cast<FuncTypeV2>(_functions[idx]);
+  }
+
+  bool Functions::uses_context() const
+  {
+    return _version >= rfaas::FUNCTIONS_VERSION_V2;
+  }
+}
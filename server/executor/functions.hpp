@@ -2,34 +2,71 @@
 #ifndef __SERVER_FUNCTIONS_HPP__
 #define __SERVER_FUNCTIONS_HPP__
 
+#include <atomic>
 #include <vector>
 #include <string>
 
 #include <rdmalib/buffer.hpp>
 
+#include <rfaas/function.hpp>
+
 namespace server {
 
   void extract_symbols(void* handle, std::vector<std::string> & names);
 
+  // Functions library shared by all threads of an executor process.
+  // The code is either received once over RDMA into a memfd,
+  // or loaded from the executor manager's library cache.
   struct Functions
   {
+    enum class State : uint8_t {
+      PENDING,
+      READY,
+      // The thread responsible for the library stopped before loading it.
+      FAILED
+    };
+
     int _fd;
     void* _memory_handle;
     size_t _size;
     void* _library_handle;
+    // Cached library to load instead of receiving the code.
+    std::string _library_path;
+    // Where to store the received library for future leases.
+    std::string _cache_path;
+    // Hash claimed by the client - the cache is indexed by it.
+    uint64_t _hash;
+    std::atomic<State> _state;
+    // Calling convention declared by the library.
+    uint32_t _version;
     // FIXME: small vector?
     std::vector<std::string> _names;
     std::vector<void*> _functions;
 
     typedef uint32_t (*FuncType)(void*, uint32_t, void*);
+    typedef uint32_t (*FuncTypeV2)(void*, uint32_t, void*, rfaas::function_context*);
 
-    Functions(size_t size);
+    Functions(size_t size, const std::string & library_path = "", const std::string & cache_path = "", uint64_t hash = 0);
     ~Functions();
 
+    bool requires_transfer() const;
+    // Called by a single thread; wakes up threads waiting for the library.
     void process_library();
+    // Called by the thread responsible for the library when it stops before loading it.
+    void fail_library();
+    // Returns false when the library won't be loaded in this lease.
+    bool wait_library() const;
+    // Kept-alive executors process the library only in their first lease.
+    bool loaded() const;
+    bool failed() const;
+    // Store the received library in the cache; no-op when caching is disabled.
+    // Libraries that don't match the claimed hash are not stored.
+    bool store_library() const;
     size_t size() const;
     void* memory() const;
-    FuncType function(int idx);
+    FuncType function(int idx) const;
+    FuncTypeV2 function_v2(int idx) const;
+    bool uses_context() const;
   };
 
 }
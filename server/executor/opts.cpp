@@ -1,4 +1,6 @@
 
+#include <sstream>
+
 #include <cxxopts.hpp>
 
 #include "server.hpp"
@@ -17,9 +19,19 @@ namespace server {
       ("polling-type", "Polling type: wc (work completions), dram", cxxopts::value<std::string>()->default_value("wc"))
       ("warmup-iters", "Number of warm-up iterations", cxxopts::value<int>()->default_value("1"))
       ("pin-threads", "Pin worker threads to CPU cores", cxxopts::value<int>()->default_value("-1"))
+      ("pin-cores", "Pin worker threads to a comma-separated list of cores; overrides pin-threads", cxxopts::value<std::string>()->default_value(""))
       ("max-inline-data", "Maximum size of inlined message", cxxopts::value<int>()->default_value("0"))
       ("x,requests", "Size of recv buffer", cxxopts::value<int>()->default_value("32"))
       ("func-size", "Size of functions library", cxxopts::value<int>())
+      ("func-library", "Load functions library from this file instead of receiving it", cxxopts::value<std::string>()->default_value(""))
+      ("func-cache", "Store the received functions library in this file", cxxopts::value<std::string>()->default_value(""))
+      ("func-hash", "Content hash claimed by the client; the library is cached only when it matches", cxxopts::value<uint64_t>()->default_value("0"))
+      ("arena-size", "Size of per-thread scratch memory for functions, in bytes", cxxopts::value<size_t>()->default_value("0"))
+      ("arena-malloc", "Serve malloc calls during invocations from the scratch memory", cxxopts::value<bool>()->default_value("false"))
+      ("peer-transfers", "Accept connections from other executors for direct transfers of function outputs", cxxopts::value<bool>()->default_value("false"))
+      ("keep-alive", "Zygote mode: wait for the next lease instead of exiting; the lease ends with SIGUSR2", cxxopts::value<bool>()->default_value("false"))
+      ("trace-size", "Number of events recorded per thread; requires build with tracing", cxxopts::value<size_t>()->default_value("0"))
+      ("trace-file", "Write traces on exit and on SIGUSR1; Chrome trace for .json, CSV otherwise", cxxopts::value<std::string>()->default_value(""))
       ("timeout", "Timeout for switching hot to warm polling; -1 always hot, 0 always warm", cxxopts::value<int>())
       ("s,size", "Packet size", cxxopts::value<int>()->default_value("1"))
       ("r,repetitions", "Repetitions to execute", cxxopts::value<int>()->default_value("1"))
@@ -30,6 +42,7 @@ namespace server {
       ("mgr-secret", "Use selected port", cxxopts::value<int>())
       ("mgr-buf-addr", "Use selected port", cxxopts::value<uint64_t>())
       ("mgr-buf-rkey", "Use selected port", cxxopts::value<uint32_t>())
+      ("accounting-fd", "Memfd of the accounting page shared with the manager; -1 uses RDMA atomics", cxxopts::value<int>()->default_value("-1"))
     ;
     auto parsed_options = options.parse(argc, argv);
 
@@ -44,15 +57,29 @@ namespace server {
     result.warmup_iters = parsed_options["warmup-iters"].as<int>();
     result.verbose = parsed_options["verbose"].as<bool>();
     result.pin_threads = parsed_options["pin-threads"].as<int>();
+    std::stringstream pin_cores{parsed_options["pin-cores"].as<std::string>()};
+    for(std::string core; std::getline(pin_cores, core, ',');)
+      if(!core.empty())
+        result.pin_cores.push_back(std::stoi(core));
     result.max_inline_data = parsed_options["max-inline-data"].as<int>();
     result.func_size = parsed_options["func-size"].as<int>();
+    result.func_library = parsed_options["func-library"].as<std::string>();
+    result.func_cache = parsed_options["func-cache"].as<std::string>();
+    result.func_hash = parsed_options["func-hash"].as<uint64_t>();
     result.timeout = parsed_options["timeout"].as<int>();
+    result.arena_size = parsed_options["arena-size"].as<size_t>();
+    result.arena_malloc = parsed_options["arena-malloc"].as<bool>();
+    result.peer_transfers = parsed_options["peer-transfers"].as<bool>();
+    result.keep_alive = parsed_options["keep-alive"].as<bool>();
+    result.trace_size = parsed_options["trace-size"].as<size_t>();
+    result.trace_file = parsed_options["trace-file"].as<std::string>();
 
     result.mgr_address = parsed_options["mgr-address"].as<std::string>();
     result.mgr_port = parsed_options["mgr-port"].as<int>();
     result.mgr_secret = parsed_options["mgr-secret"].as<int>();
     result.accounting_buffer_addr = parsed_options["mgr-buf-addr"].as<uint64_t>();
     result.accounting_buffer_rkey = parsed_options["mgr-buf-rkey"].as<uint32_t>();
+    result.accounting_fd = parsed_options["accounting-fd"].as<int>();
 
     std::string polling_mgr = parsed_options["polling-mgr"].as<std::string>();
     if(polling_mgr == "server") {
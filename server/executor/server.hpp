@@ -45,8 +45,18 @@ namespace server {
     int repetitions;
     int warmup_iters;
     int pin_threads;
+    std::vector<int> pin_cores;
     int max_inline_data;
     int func_size;
+    std::string func_library;
+    std::string func_cache;
+    uint64_t func_hash;
+    size_t arena_size;
+    bool arena_malloc;
+    bool peer_transfers;
+    bool keep_alive;
+    size_t trace_size;
+    std::string trace_file;
     int timeout;
     bool verbose;
     PollingMgr polling_manager;
@@ -57,6 +67,7 @@ namespace server {
     int mgr_secret;
     uint64_t accounting_buffer_addr;
     uint32_t accounting_buffer_rkey;
+    int accounting_fd;
   };
 
   Options opts(int argc, char ** argv);
@@ -0,0 +1,152 @@
+
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "tracing.hpp"
+
+namespace server {
+
+  namespace {
+
+    const char* event_name(TraceEvent event)
+    {
+      switch(event) {
+        case TraceEvent::POLL_HIT:
+          return "poll_hit";
+        case TraceEvent::FUNCTION_START:
+        case TraceEvent::FUNCTION_END:
+          return "function";
+        case TraceEvent::RESULT_POST:
+          return "result_post";
+        case TraceEvent::SEND_COMPLETION:
+          return "send_completion";
+        case TraceEvent::HOT_TO_WARM:
+          return "hot_to_warm";
+        case TraceEvent::WARM_TO_HOT:
+          return "warm_to_hot";
+      }
+      return "unknown";
+    }
+
+    void write_chrome(std::ostream & out, const std::vector<std::vector<TraceRecord>> & traces)
+    {
+      out << "{\"traceEvents\":[\n";
+      bool first = true;
+      for(size_t tid = 0; tid < traces.size(); ++tid) {
+        for(const TraceRecord & r : traces[tid]) {
+          const char* phase = "i";
+          if(r.event == TraceEvent::FUNCTION_START)
+            phase = "B";
+          else if(r.event == TraceEvent::FUNCTION_END)
+            phase = "E";
+
+          if(!first)
+            out << ",\n";
+          first = false;
+          out << "{\"name\":\"" << event_name(r.event) << "\",\"ph\":\"" << phase << "\""
+              << ",\"ts\":" << r.timestamp / 1000 << '.' << (r.timestamp % 1000) / 100
+              << ",\"pid\":0,\"tid\":" << tid;
+          if(phase[0] == 'i')
+            out << ",\"s\":\"t\"";
+          out << ",\"args\":{\"invocation\":" << r.invocation << ",\"function\":" << r.function << "}}";
+        }
+      }
+      out << "\n]}\n";
+    }
+
+    void write_csv(std::ostream & out, const std::vector<std::vector<TraceRecord>> & traces)
+    {
+      out << "thread,timestamp_ns,event,invocation,function\n";
+      for(size_t tid = 0; tid < traces.size(); ++tid) {
+        for(const TraceRecord & r : traces[tid]) {
+          const char* name = event_name(r.event);
+          if(r.event == TraceEvent::FUNCTION_START)
+            name = "function_start";
+          else if(r.event == TraceEvent::FUNCTION_END)
+            name = "function_end";
+          out << tid << ',' << r.timestamp << ',' << name << ',' << r.invocation << ',' << r.function << '\n';
+        }
+      }
+    }
+
+  }
+
+  Tracer::Tracer():
+    _mask(0),
+    _head(0)
+  {}
+
+  Tracer::Tracer(Tracer && obj):
+    _records(std::move(obj._records)),
+    _mask(obj._mask),
+    _head(obj._head.load())
+  {}
+
+  void Tracer::allocate(size_t capacity)
+  {
+    if(!capacity) {
+      _records.reset();
+      return;
+    }
+    size_t size = 1;
+    while(size < capacity)
+      size <<= 1;
+    // Zeroed sequences never match a position.
+    _records.reset(new TraceSlot[size]());
+    _mask = size - 1;
+    _head.store(0);
+  }
+
+  std::vector<TraceRecord> Tracer::snapshot() const
+  {
+    std::vector<TraceRecord> result;
+    if(!_records)
+      return result;
+
+    uint64_t head = _head.load(std::memory_order_acquire);
+    uint64_t size = _mask + 1;
+    uint64_t begin = head > size ? head - size : 0;
+    result.reserve(head - begin);
+    for(uint64_t i = begin; i < head; ++i) {
+      const TraceSlot & slot = _records[i & _mask];
+      uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      uint64_t timestamp = slot.timestamp.load(std::memory_order_relaxed);
+      uint64_t data = slot.data.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // The owner has wrapped around and written a newer record, or is writing it now.
+      if(sequence != 2 * (i + 1) || slot.sequence.load(std::memory_order_relaxed) != sequence)
+        continue;
+      result.push_back({
+        timestamp,
+        static_cast<int32_t>(data & 0xFFFFFFFF),
+        static_cast<int16_t>((data >> 32) & 0xFFFF),
+        static_cast<TraceEvent>(data >> 48)
+      });
+    }
+    return result;
+  }
+
+  bool dump_traces(const std::string & path, const std::vector<const Tracer*> & tracers)
+  {
+    std::vector<std::vector<TraceRecord>> traces;
+    for(const Tracer* tracer : tracers)
+      traces.push_back(tracer->snapshot());
+
+    std::ofstream out{path};
+    if(!out.is_open()) {
+      spdlog::error("Couldn't open trace file {}", path);
+      return false;
+    }
+
+    bool chrome = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if(chrome)
+      write_chrome(out, traces);
+    else
+      write_csv(out, traces);
+    spdlog::info("Written traces of {} threads to {}", tracers.size(), path);
+    return true;
+  }
+
+}
+
@@ -0,0 +1,101 @@
+
+#ifndef __SERVER_TRACING_HPP__
+#define __SERVER_TRACING_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace server {
+
+  enum class TraceEvent : uint8_t {
+    POLL_HIT = 0,
+    FUNCTION_START,
+    FUNCTION_END,
+    RESULT_POST,
+    SEND_COMPLETION,
+    HOT_TO_WARM,
+    WARM_TO_HOT
+  };
+
+  struct TraceRecord
+  {
+    uint64_t timestamp;
+    int32_t invocation;
+    int16_t function;
+    TraceEvent event;
+  };
+
+  // Slot of the ring buffer, guarded by its own sequence number.
+  struct TraceSlot
+  {
+    // Odd while the owner writes the slot, and 2 * (position + 1) once the record is complete.
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> timestamp;
+    // Invocation, function and event.
+    std::atomic<uint64_t> data;
+  };
+
+  // Ring buffer of events of a single thread.
+  // Recording is lock-free and does no formatting or allocation; the oldest events are overwritten.
+  // The buffer can be dumped while the owner still records - the oldest records of the window
+  // can be overwritten during the copy, and such records are discarded.
+  struct Tracer
+  {
+    std::unique_ptr<TraceSlot[]> _records;
+    size_t _mask;
+    std::atomic<uint64_t> _head;
+
+    Tracer();
+    Tracer(Tracer &&);
+
+    // Capacity is rounded up to a power of two; zero disables recording.
+    void allocate(size_t capacity);
+
+    inline void record(TraceEvent event, int32_t invocation = -1, int16_t function = -1)
+    {
+      if(!_records)
+        return;
+      uint64_t head = _head.load(std::memory_order_relaxed);
+      TraceSlot & slot = _records[head & _mask];
+      slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.timestamp.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()
+        ).count(),
+        std::memory_order_relaxed
+      );
+      slot.data.store(
+        static_cast<uint32_t>(invocation) |
+        static_cast<uint64_t>(static_cast<uint16_t>(function)) << 32 |
+        static_cast<uint64_t>(event) << 48,
+        std::memory_order_relaxed
+      );
+      slot.sequence.store(2 * (head + 1), std::memory_order_release);
+      _head.store(head + 1, std::memory_order_release);
+    }
+
+    // Copy of the recorded events, in order, without records overwritten during the copy.
+    std::vector<TraceRecord> snapshot() const;
+  };
+
+  // Writes Chrome trace format (JSON) when the path ends with ".json", and CSV otherwise.
+  // Each element of tracers corresponds to a thread.
+  bool dump_traces(const std::string & path, const std::vector<const Tracer*> & tracers);
+
+}
+
+// Tracing is enabled at compile time; otherwise, the hot path is unchanged.
+#ifdef RFAAS_TRACING
+#define RFAAS_TRACE(tracer, ...) (tracer).record(__VA_ARGS__)
+#else
+#define RFAAS_TRACE(tracer, ...) ((void)0)
+#endif
+
+#endif
+
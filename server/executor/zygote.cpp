@@ -0,0 +1,129 @@
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rdma/rdma_cma.h>
+#include <spdlog/spdlog.h>
+
+#include <rdmalib/rdmalib.hpp>
+
+#include "zygote.hpp"
+
+namespace server {
+
+  Zygote::Zygote():
+    _ec(nullptr),
+    _id(nullptr)
+  {}
+
+  Zygote::~Zygote()
+  {
+    if(_id)
+      rdma_destroy_id(_id);
+    if(_ec)
+      rdma_destroy_event_channel(_ec);
+  }
+
+  bool Zygote::prepare(const std::string & address)
+  {
+    rdmalib::Address addr{address, 0, true};
+    if(!(_ec = rdma_create_event_channel())) {
+      spdlog::error("Zygote couldn't create an event channel, reason {}", strerror(errno));
+      return false;
+    }
+    if(rdma_create_id(_ec, &_id, nullptr, RDMA_PS_TCP)) {
+      spdlog::error("Zygote couldn't create an RDMA ID, reason {}", strerror(errno));
+      return false;
+    }
+    if(rdma_bind_addr(_id, addr.addrinfo->ai_src_addr)) {
+      spdlog::error("Zygote couldn't bind to {}, reason {}", address, strerror(errno));
+      return false;
+    }
+    spdlog::info("Zygote opened device {} at {}", ibv_get_device_name(_id->verbs->device), address);
+    return true;
+  }
+
+  static bool read_exact(int fd, char* data, size_t size)
+  {
+    while(size > 0) {
+      ssize_t len = read(fd, data, size);
+      if(len > 0) {
+        data += len;
+        size -= len;
+      } else if(len == 0) {
+        return false;
+      } else if(errno != EINTR) {
+        spdlog::error("Zygote couldn't read arguments, reason {}", strerror(errno));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The manager attaches the descriptor to the first byte.
+  static ssize_t read_with_fd(int fd, char* data, size_t size, int & received_fd)
+  {
+    iovec iov{data, size};
+    char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t len;
+    do {
+      len = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while(len < 0 && errno == EINTR);
+    if(len < 0)
+      spdlog::error("Zygote couldn't read arguments, reason {}", strerror(errno));
+
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); len > 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(&received_fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return len;
+  }
+
+  std::vector<std::string> Zygote::wait(int fd, int & accounting_fd)
+  {
+    uint32_t size;
+    char* header = reinterpret_cast<char*>(&size);
+    accounting_fd = -1;
+    ssize_t len = read_with_fd(fd, header, sizeof(size), accounting_fd);
+    if(len <= 0 || !read_exact(fd, header + len, sizeof(size) - len))
+      return {};
+    std::string data(size, '\0');
+    if(!read_exact(fd, data.data(), size))
+      return {};
+
+    std::vector<std::string> args;
+    for(size_t begin = 0; begin < data.size();) {
+      size_t end = data.find('\0', begin);
+      if(end == std::string::npos)
+        end = data.size();
+      args.emplace_back(data, begin, end - begin);
+      begin = end + 1;
+    }
+    return args;
+  }
+
+  bool Zygote::acknowledge(int fd)
+  {
+    char ack = 1;
+    ssize_t len;
+    do {
+      len = write(fd, &ack, sizeof(ack));
+    } while(len < 0 && errno == EINTR);
+    if(len != sizeof(ack)) {
+      spdlog::error("Zygote couldn't acknowledge the end of the lease, reason {}", strerror(errno));
+      return false;
+    }
+    return true;
+  }
+
+}
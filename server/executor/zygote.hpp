@@ -0,0 +1,45 @@
+#ifndef __SERVER_ZYGOTE_HPP__
+#define __SERVER_ZYGOTE_HPP__
+
+#include <string>
+#include <vector>
+
+struct rdma_event_channel;
+struct rdma_cm_id;
+
+namespace server {
+
+  // Executor process started by the manager before a lease arrives.
+  // The process initializes the RDMA runtime, and then waits until the
+  // manager sends arguments of a lease over the control channel.
+  struct Zygote
+  {
+    rdma_event_channel* _ec;
+    rdma_cm_id* _id;
+
+    Zygote();
+    Zygote(const Zygote &) = delete;
+    Zygote& operator=(const Zygote &) = delete;
+    ~Zygote();
+
+    // Binds to the device of the address and keeps it open.
+    // librdmacm allocates the device PD on the first bind, and the connections
+    // of executor threads reuse it as long as an ID of the device exists.
+    bool prepare(const std::string & address);
+
+    // Blocks until the manager writes the arguments of a lease: their size,
+    // followed by NUL-separated arguments. The channel stays open, and
+    // kept-alive executors wait on it again for the next lease.
+    // Returns no arguments when the manager closed the channel.
+    // The accounting page of the lease is received with the arguments, -1 when none was sent.
+    static std::vector<std::string> wait(int fd, int & accounting_fd);
+
+    // Tells the manager that all threads of a kept-alive executor stopped,
+    // and the accounting of the lease is final.
+    static bool acknowledge(int fd);
+  };
+
+}
+
+#endif
+
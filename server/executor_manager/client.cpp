@@ -4,13 +4,13 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <sys/wait.h>
 
 #include <rfaas/allocation.hpp>
 #include <rfaas/connection.hpp>
 
 #include "client.hpp"
 #include "manager.hpp"
+#include "reaper.hpp"
 
 namespace rfaas::executor_manager {
 
@@ -20,6 +20,7 @@ namespace rfaas::executor_manager {
     accounting(1),
     //accounting(_acc),
     allocation_time(0),
+    lease_id(-1),
     _active(active),
     _id(id)
   {
@@ -39,7 +40,9 @@ namespace rfaas::executor_manager {
     executor(std::move(obj.executor)),
     accounting(std::move(obj.accounting)),
     allocation_time(std::move(obj.allocation_time)),
-    _active(std::move(obj._active))
+    lease_id(obj.lease_id),
+    _active(std::move(obj._active)),
+    _id(obj._id)
   {
     obj.connection = nullptr;
   }
@@ -51,7 +54,9 @@ namespace rfaas::executor_manager {
     executor = std::move(obj.executor);
     accounting = std::move(obj.accounting);
     allocation_time = std::move(obj.allocation_time);
+    lease_id = obj.lease_id;
     _active = std::move(obj._active);
+    _id = obj._id;
 
     obj.connection = nullptr;
 
@@ -71,7 +76,7 @@ namespace rfaas::executor_manager {
     connection->receive_wcs().refill();
   }
 
-  void Client::disable(ResourceManagerConnection* res_mgr_connection)
+  void Client::disable(Reaper & reaper)
   {
 
     if(executor) {
@@ -82,38 +87,35 @@ namespace rfaas::executor_manager {
         ).count();
     }
 
+    // Executors sharing an accounting page are read again by the reaper once they stop.
+    uint64_t hot_polling_time = accounting.data()[0].hot_polling_time;
+    uint64_t execution_time = accounting.data()[0].execution_time;
+    if(executor && executor->accounting.valid()) {
+      hot_polling_time = executor->accounting.hot_polling_time();
+      execution_time = executor->accounting.execution_time();
+    }
+
     rdma_disconnect(connection->id());
     SPDLOG_DEBUG(
       "[Client] Disconnect client with connection {} id {}",
       fmt::ptr(connection), fmt::ptr(connection->id())
     );
-    // First, we check if the child is still alive
-    if(executor) {
-      int status;
-      auto b = std::chrono::high_resolution_clock::now();
-      kill(executor->id(), SIGTERM);
-      waitpid(executor->id(), &status, WUNTRACED);
-      auto e = std::chrono::high_resolution_clock::now();
-      spdlog::info("Waited for child {} ms", std::chrono::duration_cast<std::chrono::milliseconds>(e-b).count());
-      executor.reset();
-    }
     spdlog::info(
       "Client {} exited, time allocated {} us, polling {} us, execution {} us",
       _id, allocation_time,
-      accounting.data()[0].hot_polling_time / 1000.0,
-      accounting.data()[0].execution_time / 1000.0
+      hot_polling_time / 1000.0,
+      execution_time / 1000.0
     );
 
-    if(res_mgr_connection) {
-
-      res_mgr_connection->close_lease(
-        _id,
-        allocation_time,
-        accounting.data()[0].execution_time,
-        accounting.data()[0].hot_polling_time
-      );
-
-    }
+    // Accounting is copied - the buffer is released with the client.
+    reaper.release({
+      std::move(executor),
+      lease_id,
+      allocation_time,
+      execution_time,
+      hot_polling_time,
+      {}
+    });
 
     //acc.hot_polling_time = acc.execution_time = 0;
     // SEGFAULT?
@@ -18,7 +18,7 @@ namespace rfaas {
 
 namespace rfaas::executor_manager {
 
-  struct ResourceManagerConnection;
+  struct Reaper;
 
   struct Client
   {
@@ -28,6 +28,8 @@ namespace rfaas::executor_manager {
     std::unique_ptr<ActiveExecutor> executor;
     rdmalib::Buffer<Accounting> accounting;
     uint32_t allocation_time;
+    // Closed when the client disconnects, -1 before the allocation.
+    int32_t lease_id;
     bool _active;
     int _id;
 
@@ -36,7 +38,8 @@ namespace rfaas::executor_manager {
     Client& operator=(Client &&);
     ~Client();
     void reload_queue();
-    void disable(ResourceManagerConnection* res_mgr_connection);
+    // The executor is stopped and the lease is closed asynchronously by the reaper.
+    void disable(Reaper & reaper);
     bool active();
 
     int id() const
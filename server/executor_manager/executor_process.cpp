@@ -1,6 +1,11 @@
 
+#include <cstring>
+#include <string>
 #include <tuple>
+#include <vector>
 
+#include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/wait.h>
@@ -11,7 +16,11 @@
 
 #include "manager.hpp"
 #include "executor_process.hpp"
+#include "launcher.hpp"
+#include "reaper.hpp"
+#include "sandbox.hpp"
 #include "settings.hpp"
+#include "zygote_pool.hpp"
 #include "../common.hpp"
 
 namespace rfaas::executor_manager {
@@ -24,23 +33,51 @@ namespace rfaas::executor_manager {
     delete[] connections; 
   }
 
+  int ActiveExecutor::stop_signal() const
+  {
+    return SIGTERM;
+  }
+
   void ActiveExecutor::add_executor(rdmalib::Connection* connection)
   {
     int pos = connections_len++;
     connections[pos] = connection;
   }
 
-  ProcessExecutor::ProcessExecutor(int cores, ProcessExecutor::time_t alloc_begin, pid_t pid):
-    ActiveExecutor(cores),
-    _pid(pid)
+  ProcessExecutor::ProcessExecutor(int cores, CoreSet && pinned_cores, ProcessExecutor::time_t alloc_begin,
+      std::future<pid_t> && launch, const Sandbox * sandbox):
+    ActiveExecutor(cores, std::move(pinned_cores)),
+    _pid(-1),
+    _launch(std::move(launch)),
+    _sandbox(sandbox)
   {
     _allocation_begin = alloc_begin;
     // FIXME: remove after connection
     _allocation_finished = _allocation_begin;
   }
 
+  ProcessExecutor::~ProcessExecutor()
+  {
+    // The zygote pool removes the cgroup of a parked executor once it exits.
+    if(_sandbox && !parked && id() > 0)
+      _sandbox->release(_pid);
+  }
+
+  int ProcessExecutor::stop_signal() const
+  {
+    return _sandbox ? SIGKILL : SIGTERM;
+  }
+
   std::tuple<ProcessExecutor::Status,int> ProcessExecutor::check() const
   {
+    if(_launch.valid()) {
+      if(_launch.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return std::make_tuple(Status::RUNNING, 0);
+      _pid = _launch.get();
+    }
+    if(_pid == -1)
+      return std::make_tuple(Status::FINISHED_FAIL, -1);
+
     int status = 0;
     // WNOHANG - returns immediately without waiting
     // WUNTRACED - return the status of stopped children
@@ -68,6 +105,8 @@ namespace rfaas::executor_manager {
 
   int ProcessExecutor::id() const
   {
+    if(_launch.valid())
+      _pid = _launch.get();
     return static_cast<int>(_pid);
   }
 
@@ -75,151 +114,217 @@ namespace rfaas::executor_manager {
     const rfaas::AllocationRequest & request,
     const ExecutorSettings & exec,
     const executor::ManagerConnection & conn,
-    const Lease & lease
+    const Lease & lease,
+    const std::string & func_library,
+    const std::string & func_cache,
+    CoreSet && pinned_cores,
+    Launcher & launcher,
+    Reaper & reaper,
+    uint32_t client,
+    ZygotePool * zygotes,
+    const Sandbox * sandbox
   )
   {
-    static int counter = 0;
     auto begin = std::chrono::high_resolution_clock::now();
-    //spdlog::info("Child fork begins work on PID {} req {}", mypid, fmt::ptr(&request));
-    std::string client_addr{request.listen_address};
-    std::string client_port = std::to_string(request.listen_port);
-    //spdlog::error("Child fork begins work on PID {} req {}", mypid, fmt::ptr(&request));
-    std::string client_in_size = std::to_string(request.input_buf_size);
-    std::string client_func_size = std::to_string(request.func_buf_size);
-    std::string client_cores = std::to_string(lease.cores);
-    std::string client_timeout = std::to_string(request.hot_timeout);
-    //spdlog::error("Child fork begins work on PID {}", mypid);
-    std::string executor_repetitions = std::to_string(exec.repetitions);
-    std::string executor_warmups = std::to_string(exec.warmup_iters);
-    std::string executor_recv_buf = std::to_string(exec.recv_buffer_size);
-    std::string executor_max_inline = std::to_string(exec.max_inline_data);
-    std::string executor_pin_threads;
-    if(exec.pin_threads >= 0)
-      executor_pin_threads = std::to_string(0);//counter++);
-    else
-      executor_pin_threads = std::to_string(exec.pin_threads);
     bool use_docker = exec.use_docker;
+    // Executors are reused only for leases of the same library.
+    // A reused executor doesn't receive the library, so the client must be told
+    // it's cached - we keep alive only executors that loaded it from the cache.
+    uint64_t keep_alive = exec.keep_alive_ms > 0 && zygotes && !use_docker && !func_library.empty() ? request.func_hash : 0;
 
-    std::string mgr_port = std::to_string(conn.port);
-    std::string mgr_secret = std::to_string(conn.secret);
-    std::string mgr_buf_addr = std::to_string(conn.r_addr);
-    std::string mgr_buf_rkey = std::to_string(conn.r_key);
+    // Pin cores are empty when pinning is disabled.
+    std::vector<std::string> args = {
+      "-a", request.listen_address,
+      "-p", std::to_string(request.listen_port),
+      "--polling-mgr", "thread",
+      "-r", std::to_string(exec.repetitions),
+      "-x", std::to_string(exec.recv_buffer_size),
+      "-s", std::to_string(request.input_buf_size),
+      "--pin-cores", pinned_cores.str(),
+      "--fast", std::to_string(lease.cores),
+      "--warmup-iters", std::to_string(exec.warmup_iters),
+      "--max-inline-data", std::to_string(exec.max_inline_data),
+      "--func-size", std::to_string(request.func_buf_size),
+      "--func-library", func_library,
+      "--func-cache", func_cache,
+      "--func-hash", std::to_string(request.func_hash),
+      "--arena-size", std::to_string(exec.arena_size),
+      "--arena-malloc", exec.arena_malloc ? "true" : "false",
+      "--peer-transfers", exec.peer_transfers ? "true" : "false",
+      "--keep-alive", keep_alive ? "true" : "false",
+      "--timeout", std::to_string(request.hot_timeout),
+      "--mgr-address", conn.addr,
+      "--mgr-port", std::to_string(conn.port),
+      "--mgr-secret", std::to_string(conn.secret),
+      "--mgr-buf-addr", std::to_string(conn.r_addr),
+      "--mgr-buf-rkey", std::to_string(conn.r_key)
+    };
 
-    int mypid = fork();
-    if(mypid < 0) {
-      spdlog::error("Fork failed! {}", mypid);
-    }
-    if(mypid == 0) {
-      mypid = getpid();
-      auto out_file = ("executor_" + std::to_string(mypid));
-
-      spdlog::info("Child fork begins work on PID {}, using Docker? {}", mypid, use_docker);
-      int fd = open(out_file.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-      dup2(fd, 1);
-      dup2(fd, 2);
-      if(!use_docker) {
-        const char * argv[] = {
-          "executor",
-          "-a", client_addr.c_str(),
-          "-p", client_port.c_str(),
-          "--polling-mgr", "thread",
-          "-r", executor_repetitions.c_str(),
-          "-x", executor_recv_buf.c_str(),
-          "-s", client_in_size.c_str(),
-          "--pin-threads", executor_pin_threads.c_str(),
-          "--fast", client_cores.c_str(),
-          "--warmup-iters", executor_warmups.c_str(),
-          "--max-inline-data", executor_max_inline.c_str(),
-          "--func-size", client_func_size.c_str(),
-          "--timeout", client_timeout.c_str(),
-          "--mgr-address", conn.addr.c_str(),
-          "--mgr-port", mgr_port.c_str(),
-          "--mgr-secret", mgr_secret.c_str(),
-          "--mgr-buf-addr", mgr_buf_addr.c_str(),
-          "--mgr-buf-rkey", mgr_buf_rkey.c_str(),
-          nullptr
-        };
-        int ret = execvp(argv[0], const_cast<char**>(&argv[0]));
-        if(ret == -1) {
-          spdlog::error("Executor process failed {}, reason {}", errno, strerror(errno));
-          close(fd);
-          exit(1);
-        }
+    // Threads of the executor write their accounting to a page shared with us.
+    rfaas::common::AccountingPage accounting;
+    if(!use_docker) {
+      if(accounting.create(lease.cores)) {
+        args.push_back("--accounting-fd");
+        args.push_back(std::to_string(rfaas::common::AccountingPage::EXECUTOR_FD));
       } else {
-        //const char * argv[] = {
-        //  "docker_rdma_sriov", "run",
-        //  "--rm",
-        //  "--net=mynet", "-i", //"-it",
-        //  // FIXME: make configurable
-        //  "--ip=148.187.105.220",
-        //  // FIXME: make configurable
-        //  "--volume", "/users/mcopik/projects/rdma/repo/build_repo2:/opt",
-        //  // FIXME: make configurable
-        //  "rdma-test",
-        //  "/opt/bin/executor",
-        //  "-a", client_addr.c_str(),
-        //  "-p", client_port.c_str(),
-        //  "--polling-mgr", "thread",
-        //  "-r", executor_repetitions.c_str(),
-        //  "-x", executor_recv_buf.c_str(),
-        //  "-s", client_in_size.c_str(),
-        //  "--pin-threads", "true",
-        //  "--fast", client_cores.c_str(),
-        //  "--warmup-iters", executor_warmups.c_str(),
-        //  "--max-inline-data", executor_max_inline.c_str(),
-        //  "--func-size", client_func_size.c_str(),
-        //  "--timeout", client_timeout.c_str(),
-        //  "--mgr-address", conn.addr.c_str(),
-        //  "--mgr-port", mgr_port.c_str(),
-        //  "--mgr-secret", mgr_secret.c_str(),
-        //  "--mgr-buf-addr", mgr_buf_addr.c_str(),
-        //  "--mgr-buf-rkey", mgr_buf_rkey.c_str(),
-        //  nullptr
-        //};
-        const char * argv[] = {
-          "docker_rdma_sriov", "run",
-          "--rm",
-          "--net=mynet", "-i", //"-it",
-          // FIXME: make configurable
-          "--ip=148.187.105.250",
-          // FIXME: make configurable
-          "--volume", "/users/mcopik/projects/rdma/repo/build_repo2:/opt",
-          // FIXME: make configurable
-          "rdma-test",
-          "/opt/bin/executor",
-          "-a", client_addr.c_str(),
-          "-p", client_port.c_str(),
-          "--polling-mgr", "thread",
-          "-r", executor_repetitions.c_str(),
-          "-x", executor_recv_buf.c_str(),
-          "-s", client_in_size.c_str(),
-          "--pin-threads", executor_pin_threads.c_str(),
-          "--fast", client_cores.c_str(),
-          "--warmup-iters", executor_warmups.c_str(),
-          "--max-inline-data", executor_max_inline.c_str(),
-          "--func-size", client_func_size.c_str(),
-          "--timeout", client_timeout.c_str(),
-          "--mgr-address", conn.addr.c_str(),
-          "--mgr-port", mgr_port.c_str(),
-          "--mgr-secret", mgr_secret.c_str(),
-          "--mgr-buf-addr", mgr_buf_addr.c_str(),
-          "--mgr-buf-rkey", mgr_buf_rkey.c_str(),
-          nullptr
-        };
-        int ret = execvp(argv[0], const_cast<char**>(&argv[0]));
-        if(ret == -1) {
-          spdlog::error("Executor process failed {}, reason {}", errno, strerror(errno));
-          close(fd);
-          exit(1);
-        }
+        spdlog::warn("Couldn't create accounting page of lease {}, reason {}", lease.id, strerror(errno));
+      }
+    }
+    // Valid until the launch finishes - the executor is not released before.
+    int accounting_fd = accounting.fd();
 
+    // Containers provide their own isolation.
+    if(use_docker || (sandbox && !sandbox->enabled()))
+      sandbox = nullptr;
+    int lease_id = lease.id, cores = lease.cores, memory = lease.memory;
+    auto launch = launcher.submit(
+      [args = std::move(args), use_docker, zygotes, sandbox, lease_id, keep_alive, accounting_fd, cores, memory, &reaper, client]() {
+        pid_t pid = ProcessExecutor::launch(
+          args, use_docker, zygotes, sandbox, lease_id, keep_alive, accounting_fd, cores, memory
+        );
+        // Registered before the future is ready.
+        reaper.watch(client, pid);
+        return pid;
       }
-      //close(fd);
-      exit(0);
+    );
+    auto executor = new ProcessExecutor{lease.cores, std::move(pinned_cores), begin, std::move(launch), sandbox};
+    executor->keep_alive = keep_alive != 0;
+    executor->accounting = std::move(accounting);
+    return executor;
+  }
+
+  pid_t ProcessExecutor::launch(
+    const std::vector<std::string> & args, bool use_docker,
+    ZygotePool * zygotes, const Sandbox * sandbox,
+    int lease_id, uint64_t keep_alive, int accounting_fd, int cores, int memory
+  )
+  {
+    // Zygotes are already initialized - fall back to a new process when none is available.
+    pid_t pid = -1;
+    if(zygotes && !use_docker) {
+      pid = zygotes->launch(args, lease_id, keep_alive, accounting_fd);
+      if(pid != -1)
+        spdlog::info("Executor launched from zygote with PID {}", pid);
+    }
+    if(pid == -1)
+      pid = _start(args, use_docker, sandbox, accounting_fd);
+
+    // Zygotes of a sandbox are limited only once they receive a lease.
+    if(pid != -1 && sandbox && !sandbox->limit(pid, cores, memory)) {
+      spdlog::error("Couldn't limit resources of executor {}, stopping it", pid);
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+      sandbox->release(pid);
+      pid = -1;
     }
-    if(counter == 36)
-      counter = 0;
-    return new ProcessExecutor{lease.cores, begin, mypid};
+    return pid;
+  }
+
+  pid_t ProcessExecutor::_start(
+    const std::vector<std::string> & args, bool use_docker,
+    const Sandbox * sandbox, int accounting_fd
+  )
+  {
+
+    std::vector<const char*> argv;
+    if(!use_docker) {
+      argv.push_back("executor");
+    } else {
+      //const char * argv[] = {
+      //  "docker_rdma_sriov", "run",
+      //  "--rm",
+      //  "--net=mynet", "-i", //"-it",
+      //  // FIXME: make configurable
+      //  "--ip=148.187.105.220",
+      //  // FIXME: make configurable
+      //  "--volume", "/users/mcopik/projects/rdma/repo/build_repo2:/opt",
+      //  // FIXME: make configurable
+      //  "rdma-test",
+      //  "/opt/bin/executor",
+      //  "-a", client_addr.c_str(),
+      //  "-p", client_port.c_str(),
+      //  "--polling-mgr", "thread",
+      //  "-r", executor_repetitions.c_str(),
+      //  "-x", executor_recv_buf.c_str(),
+      //  "-s", client_in_size.c_str(),
+      //  "--pin-threads", "true",
+      //  "--fast", client_cores.c_str(),
+      //  "--warmup-iters", executor_warmups.c_str(),
+      //  "--max-inline-data", executor_max_inline.c_str(),
+      //  "--func-size", client_func_size.c_str(),
+      //  "--timeout", client_timeout.c_str(),
+      //  "--mgr-address", conn.addr.c_str(),
+      //  "--mgr-port", mgr_port.c_str(),
+      //  "--mgr-secret", mgr_secret.c_str(),
+      //  "--mgr-buf-addr", mgr_buf_addr.c_str(),
+      //  "--mgr-buf-rkey", mgr_buf_rkey.c_str(),
+      //  nullptr
+      //};
+      for(const char* arg : {
+        "docker_rdma_sriov", "run",
+        "--rm",
+        "--net=mynet", "-i", //"-it",
+        // FIXME: make configurable
+        "--ip=148.187.105.250",
+        // FIXME: make configurable
+        "--volume", "/users/mcopik/projects/rdma/repo/build_repo2:/opt",
+        // FIXME: make configurable
+        "rdma-test",
+        "/opt/bin/executor"
+      })
+        argv.push_back(arg);
+    }
+    for(auto & arg : args)
+      argv.push_back(arg.c_str());
+    argv.push_back(nullptr);
+
+    pid_t pid = spawn_process(argv.data(), -1, sandbox, accounting_fd);
+    if(pid != -1)
+      spdlog::info("Executor started with PID {}, using Docker? {}, sandbox? {}", pid, use_docker, sandbox != nullptr);
+    return pid;
+  }
+
+  pid_t spawn_process(const char* const* argv, int stdin_fd, const Sandbox * sandbox, int accounting_fd)
+  {
+    // posix_spawn uses vfork-like clone - no copy of page tables and pinned memory of the manager.
+    // The log is named after the PID, known only after the spawn.
+    static int spawned = 0;
+    std::string tmp_file = fmt::format("executor_spawn_{}_{}", getpid(), spawned++);
+    int fd = open(tmp_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if(fd < 0) {
+      spdlog::error("Couldn't create executor log, reason {}", strerror(errno));
+      return -1;
+    }
+
+    pid_t pid = -1;
+    if(sandbox) {
+      pid = sandbox->spawn(argv, stdin_fd, fd, accounting_fd);
+    } else {
+      posix_spawn_file_actions_t actions;
+      posix_spawn_file_actions_init(&actions);
+      posix_spawn_file_actions_adddup2(&actions, fd, 1);
+      posix_spawn_file_actions_adddup2(&actions, fd, 2);
+      if(stdin_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, stdin_fd, 0);
+      // Duplicating onto itself clears close-on-exec.
+      if(accounting_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, accounting_fd, rfaas::common::AccountingPage::EXECUTOR_FD);
+
+      int ret = posix_spawnp(&pid, argv[0], &actions, nullptr, const_cast<char* const*>(argv), environ);
+      posix_spawn_file_actions_destroy(&actions);
+      if(ret) {
+        spdlog::error("Executor process failed {}, reason {}", ret, strerror(ret));
+        pid = -1;
+      }
+    }
+    close(fd);
+    if(pid == -1) {
+      unlink(tmp_file.c_str());
+      return -1;
+    }
+
+    rename(tmp_file.c_str(), ("executor_" + std::to_string(pid)).c_str());
+    return pid;
   }
 
 }
@@ -4,9 +4,15 @@
 
 #include <memory>
 #include <chrono>
+#include <future>
+#include <string>
+#include <vector>
 
 #include <rdmalib/connection.hpp>
 
+#include "topology.hpp"
+#include "common/accounting_page.hpp"
+
 namespace rfaas {
   struct AllocationRequest;
 }
@@ -19,6 +25,18 @@ namespace rfaas::executor_manager {
 
   struct ExecutorSettings;
   struct Lease;
+  struct ZygotePool;
+  struct Launcher;
+  struct Reaper;
+  struct Sandbox;
+
+  // Starts a process with posix_spawn, or in the sandbox when enabled,
+  // writing its output to executor_<pid>. Returns -1 on failure.
+  // The accounting page is passed at AccountingPage::EXECUTOR_FD.
+  pid_t spawn_process(
+    const char* const* argv, int stdin_fd = -1,
+    const Sandbox * sandbox = nullptr, int accounting_fd = -1
+  );
 
   struct ActiveExecutor {
 
@@ -32,35 +50,78 @@ namespace rfaas::executor_manager {
     rdmalib::Connection** connections;
     int connections_len;
     int cores;
-
-    ActiveExecutor(int cores):
+    // Released when the executor is removed.
+    CoreSet pinned_cores;
+    // Launched to be parked in the zygote pool when the lease ends,
+    // and parked by the reaper instead of being stopped.
+    bool keep_alive;
+    bool parked;
+    // Counters of executor threads, written by the process and read by us at any time.
+    // Invalid for containers, which update the client's accounting buffer with RDMA atomics.
+    rfaas::common::AccountingPage accounting;
+
+    ActiveExecutor(int cores, CoreSet && pinned_cores):
       connections(new rdmalib::Connection*[cores]),
       connections_len(0),
-      cores(cores)
+      cores(cores),
+      pinned_cores(std::move(pinned_cores)),
+      keep_alive(false),
+      parked(false)
     {}
 
     virtual ~ActiveExecutor();
     virtual int id() const = 0;
     virtual std::tuple<Status,int> check() const = 0;
+    // Signal that ends the executor when its lease is closed.
+    virtual int stop_signal() const;
     void add_executor(rdmalib::Connection*);
   };
 
   struct ProcessExecutor : public ActiveExecutor
   {
-    pid_t _pid;
+    // -1 until the launcher starts the process, and when the launch failed.
+    mutable pid_t _pid;
+    mutable std::future<pid_t> _launch;
+    // Removes the cgroup of a sandboxed executor.
+    const Sandbox * _sandbox;
 
-    ProcessExecutor(int cores, time_t alloc_begin, pid_t pid);
+    ProcessExecutor(int cores, CoreSet && pinned_cores, time_t alloc_begin,
+        std::future<pid_t> && launch, const Sandbox * sandbox = nullptr);
 
     // FIXME: kill active executor
-    //~ProcessExecutor();
+    ~ProcessExecutor();
     //void close();
+    // Waits for the launch to finish.
     int id() const override;
     std::tuple<Status,int> check() const override;
+    // A sandboxed executor is the init of its PID namespace - the kernel
+    // drops SIGTERM, which the executor doesn't handle.
+    int stop_signal() const override;
     static ProcessExecutor* spawn(
       const rfaas::AllocationRequest & request,
       const ExecutorSettings & exec,
       const executor::ManagerConnection & conn,
-      const Lease & lease
+      const Lease & lease,
+      const std::string & func_library,
+      const std::string & func_cache,
+      CoreSet && pinned_cores,
+      Launcher & launcher,
+      Reaper & reaper,
+      uint32_t client,
+      ZygotePool * zygotes = nullptr,
+      const Sandbox * sandbox = nullptr
+    );
+    // Executed by the launcher; uses a zygote when available.
+    static pid_t launch(
+      const std::vector<std::string> & args, bool use_docker,
+      ZygotePool * zygotes, const Sandbox * sandbox,
+      int lease_id, uint64_t keep_alive, int accounting_fd, int cores, int memory
+    );
+
+  private:
+    static pid_t _start(
+      const std::vector<std::string> & args, bool use_docker,
+      const Sandbox * sandbox, int accounting_fd
     );
   };
 
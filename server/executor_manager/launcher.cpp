@@ -0,0 +1,34 @@
+
+#include <spdlog/spdlog.h>
+
+#include "launcher.hpp"
+
+namespace rfaas::executor_manager {
+
+  constexpr int Launcher::POLLING_TIMEOUT_MS;
+
+  Launcher::Launcher():
+    _tasks(16)
+  {}
+
+  std::future<pid_t> Launcher::submit(std::function<pid_t()> && task)
+  {
+    task_t packaged{std::move(task)};
+    auto future = packaged.get_future();
+    // The queue supports only a single producer.
+    std::lock_guard<std::mutex> lock{_submit};
+    _tasks.enqueue(std::move(packaged));
+    return future;
+  }
+
+  void Launcher::run(const std::atomic<bool> & shutdown)
+  {
+    task_t task;
+    while(!shutdown.load()) {
+      if(_tasks.wait_dequeue_timed(task, POLLING_TIMEOUT_MS * 1000))
+        task();
+    }
+    spdlog::info("Background thread stops launching executors.");
+  }
+
+}
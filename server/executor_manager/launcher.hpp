@@ -0,0 +1,38 @@
+
+#ifndef __RFAAS_EXECUTOR_MANAGER_LAUNCHER_HPP__
+#define __RFAAS_EXECUTOR_MANAGER_LAUNCHER_HPP__
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+
+#include <sys/types.h>
+
+#include "common/readerwriterqueue.h"
+
+namespace rfaas::executor_manager {
+
+  // Starts executor processes on a dedicated thread.
+  // The RDMA polling thread only submits tasks, and the process ID becomes
+  // available through the future once the process has been started.
+  // Submissions from the client and resource manager threads are serialized.
+  struct Launcher
+  {
+    static constexpr int POLLING_TIMEOUT_MS = 100;
+    typedef std::packaged_task<pid_t()> task_t;
+
+    Launcher();
+
+    std::future<pid_t> submit(std::function<pid_t()> && task);
+    void run(const std::atomic<bool> & shutdown);
+
+  private:
+    std::mutex _submit;
+    moodycamel::BlockingReaderWriterQueue<task_t> _tasks;
+  };
+
+}
+
+#endif
+
@@ -0,0 +1,102 @@
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <spdlog/spdlog.h>
+
+#include <rfaas/library.hpp>
+
+#include "library_cache.hpp"
+
+namespace rfaas::executor_manager {
+
+  LibraryCache::LibraryCache(const std::string & directory):
+    _directory(directory)
+  {
+    if(!enabled())
+      return;
+
+    if(mkdir(_directory.c_str(), S_IRWXU) && errno != EEXIST) {
+      spdlog::error("Couldn't create library cache {}, reason {}, caching disabled", _directory, strerror(errno));
+      _directory.clear();
+      return;
+    }
+
+    // Executors run code from the directory - nobody else may place files there.
+    struct stat st;
+    if(lstat(_directory.c_str(), &st) || !S_ISDIR(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & ACCESSPERMS) != S_IRWXU) {
+      spdlog::error(
+        "Library cache {} must be a directory owned by the manager's user with mode 0700, caching disabled",
+        _directory
+      );
+      _directory.clear();
+    }
+  }
+
+  bool LibraryCache::enabled() const
+  {
+    return !_directory.empty();
+  }
+
+  std::string LibraryCache::path(uint64_t hash) const
+  {
+    return fmt::format("{}/{:016x}.so", _directory, hash);
+  }
+
+  bool LibraryCache::contains(uint64_t hash)
+  {
+    if(!enabled() || !hash)
+      return false;
+
+    std::string file = path(hash);
+    std::lock_guard<std::mutex> lock{_mutex};
+    int fd = open(file.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if(fd < 0) {
+      _libraries.erase(hash);
+      return false;
+    }
+
+    struct stat st;
+    bool valid = !fstat(fd, &st) && S_ISREG(st.st_mode);
+    auto it = _libraries.find(hash);
+    if(valid && it != _libraries.end()) {
+      const Library & lib = it->second;
+      if(lib.device == st.st_dev && lib.inode == st.st_ino && lib.size == st.st_size &&
+          lib.modified.tv_sec == st.st_mtim.tv_sec && lib.modified.tv_nsec == st.st_mtim.tv_nsec) {
+        close(fd);
+        return true;
+      }
+    }
+
+    // Hashed only when the file is new or has changed.
+    valid = valid && _verify(fd, st.st_size, hash);
+    close(fd);
+    if(!valid) {
+      spdlog::error("Cached library {} doesn't match its hash, removing it", file);
+      unlink(file.c_str());
+      _libraries.erase(hash);
+      return false;
+    }
+    _libraries[hash] = Library{st.st_dev, st.st_ino, st.st_size, st.st_mtim};
+    return true;
+  }
+
+  bool LibraryCache::_verify(int fd, size_t size, uint64_t hash)
+  {
+    if(!size)
+      return false;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+      return false;
+    bool valid = rfaas::library::content_hash(static_cast<const char*>(data), size) == hash;
+    munmap(data, size);
+    return valid;
+  }
+
+}
+
@@ -0,0 +1,49 @@
+
+#ifndef __RFAAS_EXECUTOR_MANAGER_LIBRARY_CACHE_HPP__
+#define __RFAAS_EXECUTOR_MANAGER_LIBRARY_CACHE_HPP__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+namespace rfaas::executor_manager {
+
+  // Functions libraries stored on the local disk, indexed by their content hash
+  // (the SHA-256 prefix of rfaas::library), which executors verify before storing.
+  // Executors store a library after receiving it from a client;
+  // executors for subsequent leases load it from the disk instead of waiting for the transfer.
+  // The directory must be private to the manager's user, and a file is handed to executors
+  // only after its content matched the hash - a file that doesn't is removed and transferred again.
+  struct LibraryCache
+  {
+    LibraryCache(const std::string & directory);
+
+    // Empty directory disables caching.
+    bool enabled() const;
+    std::string path(uint64_t hash) const;
+    bool contains(uint64_t hash);
+
+  private:
+    // Identity of a verified file - a replaced or modified file is verified again.
+    struct Library
+    {
+      dev_t device;
+      ino_t inode;
+      off_t size;
+      timespec modified;
+    };
+
+    std::string _directory;
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, Library> _libraries;
+
+    static bool _verify(int fd, size_t size, uint64_t hash);
+  };
+
+}
+
+#endif
+
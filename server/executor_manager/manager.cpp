@@ -4,6 +4,7 @@
 #include <thread>
 #include <variant>
 
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <fcntl.h>
@@ -24,23 +25,56 @@
 
 namespace rfaas::executor_manager {
 
+  constexpr int Manager::PENDING_LEASE_TIMEOUT_MS;
+  constexpr int Leases::SHARDS;
+
+  Leases::Leases():
+    _pending_count(0)
+  {
+    _ready_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    rdmalib::impl::expect_nonnegative(_ready_fd);
+  }
+
+  Leases::~Leases()
+  {
+    close(_ready_fd);
+  }
+
+  Leases::Shard & Leases::_shard(int id)
+  {
+    return _shards[static_cast<uint32_t>(id) % SHARDS];
+  }
+
   void Leases::insert(Lease && obj)
   {
-    _leases.try_emplace(obj.id, obj) ;
+    _shard(obj.id).leases.try_emplace(obj.id, obj) ;
   }
 
   void Leases::insert_threadsafe(Lease && obj)
   {
-    std::unique_lock lock{_mutex};
-    _leases.try_emplace(obj.id, obj) ;
+    Shard & shard = _shard(obj.id);
+    std::unique_lock lock{shard.mutex};
+    shard.leases.try_emplace(obj.id, obj) ;
+
+    auto it = shard.pending.find(obj.id);
+    if(it != shard.pending.end()) {
+      {
+        std::unique_lock ready_lock{_ready_mutex};
+        _ready.push_back(std::move(it->second));
+      }
+      shard.pending.erase(it);
+      uint64_t value = 1;
+      (void)!write(_ready_fd, &value, sizeof(value));
+    }
   }
 
   std::optional<Lease> Leases::get(int id)
   {
-    auto it = _leases.find(id);
-    if(it != _leases.end()) {
+    Shard & shard = _shard(id);
+    auto it = shard.leases.find(id);
+    if(it != shard.leases.end()) {
       Lease lease = (*it).second;
-      _leases.erase(it);
+      shard.leases.erase(it);
       return lease;
     } else {
       return std::nullopt;
@@ -49,31 +83,129 @@ namespace rfaas::executor_manager {
 
   std::optional<Lease> Leases::get_threadsafe(int id)
   {
-    std::unique_lock lock{_mutex};
+    Shard & shard = _shard(id);
+    std::unique_lock lock{shard.mutex};
 
-    auto it = _leases.find(id);
-    if(it != _leases.end()) {
+    auto it = shard.leases.find(id);
+    if(it != shard.leases.end()) {
       Lease lease = (*it).second;
-      _leases.erase(it);
+      shard.leases.erase(it);
       return lease;
     } else {
       return std::nullopt;
     }
   }
 
+  std::optional<Lease> Leases::get_or_park_threadsafe(int id, const PendingRequest & request, bool & parked)
+  {
+    Shard & shard = _shard(id);
+    std::unique_lock lock{shard.mutex};
+
+    auto it = shard.leases.find(id);
+    if(it != shard.leases.end()) {
+      Lease lease = (*it).second;
+      shard.leases.erase(it);
+      parked = false;
+      return lease;
+    }
+
+    parked = shard.pending.try_emplace(id, request).second;
+    if(parked)
+      ++_pending_count;
+    return std::nullopt;
+  }
+
+  void Leases::expire(std::chrono::steady_clock::time_point now, std::vector<int> & expired)
+  {
+    for(Shard & shard : _shards) {
+      std::unique_lock lock{shard.mutex};
+      for(auto it = shard.leases.begin(); it != shard.leases.end();) {
+        if(it->second.expires <= now) {
+          expired.push_back(it->first);
+          it = shard.leases.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+
+  bool Leases::has_pending() const
+  {
+    return _pending_count.load() > 0;
+  }
+
+  void Leases::poll_pending(std::vector<PendingRequest> & ready, std::vector<PendingRequest> & expired)
+  {
+    auto now = std::chrono::steady_clock::now();
+    {
+      std::unique_lock lock{_ready_mutex};
+      uint64_t value;
+      (void)!read(_ready_fd, &value, sizeof(value));
+      ready.swap(_ready);
+      _ready.clear();
+    }
+
+    for(Shard & shard : _shards) {
+      std::unique_lock lock{shard.mutex};
+      for(auto it = shard.pending.begin(); it != shard.pending.end();) {
+        if(it->second.deadline <= now) {
+          expired.push_back(std::move(it->second));
+          it = shard.pending.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    _pending_count -= ready.size() + expired.size();
+  }
+
+  int Leases::fd() const
+  {
+    return _ready_fd;
+  }
+
   constexpr int Manager::POLLING_TIMEOUT_MS;
 
+  Manager::ClientShard::ClientShard():
+    responses(1),
+    events(Manager::MAX_CLIENTS_ACTIVE)
+  {}
+
   Manager::Manager(Settings & settings, bool skip_rm):
     _client_queue(100),
+    _workers(std::max(settings.client_workers, 0)),
     _ids(0),
     _res_mgr_connection(nullptr),
     _state(settings.device->ip_address, settings.rdma_device_port,
         settings.device->default_receive_buffer_size, true),
-    _client_responses(1),
     _settings(settings),
     _skip_rm(skip_rm),
-    _shutdown(false)
+    _shutdown(false),
+    _lease_ttl_ms(0),
+    // Containers do not see the cache directory.
+    _library_cache(settings.exec.use_docker ? "" : settings.exec.library_cache),
+    _cores(
+      Topology::discover(settings.device->name),
+      settings.exec.pin_threads ? settings.exec.manager_cores : 0
+    ),
+    // Executors read and store cached libraries.
+    _sandbox(
+      settings.exec.use_docker ? "" : settings.exec.sandbox_rootfs,
+      settings.exec.sandbox_cgroup,
+      {_library_cache.enabled() ? settings.exec.library_cache : ""}
+    ),
+    // Containers are started for each lease.
+    _zygotes(
+      settings.exec.use_docker ? 0 : settings.exec.zygotes, settings.device->ip_address,
+      &_sandbox, settings.exec.keep_alive_ms
+    ),
+    // Parks executors kept alive after their lease.
+    _reaper(&_zygotes)
   {
+    for(int i = 0; i < std::max(_workers, 1); ++i)
+      _shards.emplace_back(new ClientShard{});
+
     if(!_skip_rm) {
       _res_mgr_connection = std::make_unique<ResourceManagerConnection>(
         settings.resource_manager_address,
@@ -105,7 +237,9 @@ namespace rfaas::executor_manager {
     }
 
     _state.register_shared_queue(0);
-    _client_responses.register_memory(_state.pd(), IBV_ACCESS_LOCAL_WRITE);
+    for(auto & shard : _shards)
+      shard->responses.register_memory(_state.pd(), IBV_ACCESS_LOCAL_WRITE);
+    _zygotes.fill();
 
     spdlog::info(
       "Begin listening at {}:{} and processing events!",
@@ -113,23 +247,49 @@ namespace rfaas::executor_manager {
       _settings.rdma_device_port
     );
     std::thread listener(&Manager::listen, this);
+    _cores.pin_manager_thread(listener.native_handle());
+    // Processes are started away from the RDMA polling thread.
+    std::thread launcher(&Launcher::run, &_launcher, std::cref(_shutdown));
+    _cores.pin_manager_thread(launcher.native_handle());
+    // Executor exits and lease teardown.
+    std::thread reaper(&Reaper::run, &_reaper, std::cref(_shutdown), _res_mgr_connection.get());
+    _cores.pin_manager_thread(reaper.native_handle());
+    // Allocation requests of clients, when not processed by the polling thread.
+    std::vector<std::thread> workers;
+    for(int i = 0; i < _workers; ++i) {
+      workers.emplace_back(&Manager::_run_worker, this, std::ref(*_shards[i]));
+      _cores.pin_manager_thread(workers.back().native_handle());
+    }
 
     if(_settings.rdma_sleep) {
 
       std::thread rdma_processer(&Manager::_process_events_sleep, this);
+      _cores.pin_manager_thread(rdma_processer.native_handle());
       rdma_processer.join();
 
+    } else if(_settings.rdma_threads <= 1) {
+
+      // Keep pollers away from the cores of executors.
+      std::thread rdma_poller(&Manager::poll_events, this);
+      _cores.pin_manager_thread(rdma_poller.native_handle());
+      rdma_poller.join();
+
     } else {
 
       std::thread rdma_poller(&Manager::poll_rdma, this);
       std::thread res_mgr_poller(&Manager::poll_res_mgr, this);
+      _cores.pin_manager_thread(rdma_poller.native_handle());
+      _cores.pin_manager_thread(res_mgr_poller.native_handle());
 
       res_mgr_poller.join();
       rdma_poller.join();
 
     }
 
-
+    for(auto & worker : workers)
+      worker.join();
+    reaper.join();
+    launcher.join();
     listener.join();
   }
 
@@ -218,41 +378,118 @@ namespace rfaas::executor_manager {
       return;
     }
 
-    uint64_t id = wc.wr_id;
-    SPDLOG_DEBUG("Receive lease {}", _res_mgr_connection->_receive_buffer[id].lease_id);
+    // The resource manager sends all allocations of a client request together.
+    common::LeaseAllocation* allocations = &_res_mgr_connection->_receive_buffer[
+      wc.wr_id * ResourceManagerConnection::RECV_SLOT_SIZE
+    ];
+    int count = wc.byte_len / sizeof(common::LeaseAllocation);
 
-    Lease lease {
-      _res_mgr_connection->_receive_buffer[id].lease_id,
-      _res_mgr_connection->_receive_buffer[id].cores,
-      _res_mgr_connection->_receive_buffer[id].memory
-    };
-    _leases.insert_threadsafe(std::move(lease));
+    if(allocations->message_id == common::id_to_int(common::MessageIDs::NODE_LIVENESS)) {
+      auto msg = reinterpret_cast<common::NodeLiveness*>(allocations);
+      spdlog::info(
+        "Sending heartbeats to resource manager every {} ms, unclaimed leases expire after {} ms",
+        msg->heartbeat_ms, msg->lease_ttl_ms
+      );
+      _lease_ttl_ms = msg->lease_ttl_ms;
+      _res_mgr_connection->start_heartbeats(*msg);
+      count = 0;
+    } else if(allocations->message_id == common::id_to_int(common::MessageIDs::NODE_CAPACITY)) {
+      auto msg = reinterpret_cast<common::NodeCapacitySlot*>(allocations);
+      spdlog::info("Accepting direct leases of clients on {} cores", msg->cores);
+      _res_mgr_connection->set_capacity_slot(*msg);
+      count = 0;
+    } else if(allocations->message_id == common::id_to_int(common::MessageIDs::NODE_SUSPENDED)) {
+      spdlog::warn("Resource manager reclaimed leases of this node, reporting leases in use");
+      _res_mgr_connection->report_leases();
+      count = 0;
+    } else if(allocations->message_id == common::id_to_int(common::MessageIDs::LEASE_CANCEL)) {
+      auto msg = reinterpret_cast<common::LeaseCancel*>(allocations);
+      // Only unclaimed leases are dropped - the response with a cancelled lease never reaches a client.
+      if(_leases.get_threadsafe(msg->lease_id).has_value()) {
+        SPDLOG_DEBUG("Lease {} cancelled by resource manager", msg->lease_id);
+        _res_mgr_connection->forget_lease(msg->lease_id);
+      }
+      count = 0;
+    }
+
+    for(int i = 0; i < count; ++i) {
+
+      SPDLOG_DEBUG("Receive lease {}", allocations[i].lease_id);
+      Lease lease {
+        static_cast<int>(allocations[i].lease_id),
+        allocations[i].cores,
+        allocations[i].memory
+      };
+      if(_lease_ttl_ms > 0) {
+        lease.expires = std::chrono::steady_clock::now() + std::chrono::milliseconds(_lease_ttl_ms);
+      }
+      // The executor starts while the client connects and submits its request.
+      // Submitted before the lease becomes visible - the launcher runs tasks in order.
+      int lease_id = lease.id;
+      if(_settings.exec.speculative_spawn && !_settings.exec.use_docker) {
+        _launcher.submit([this, lease_id]() {
+          _zygotes.reserve(lease_id);
+          _zygotes.fill();
+          return 0;
+        });
+      }
+      _res_mgr_connection->open_lease(allocations[i]);
+      _leases.insert_threadsafe(std::move(lease));
+    }
 
     _res_mgr_connection->_connection.connection().receive_wcs().refill();
   }
 
-  void Manager::poll_res_mgr()
+  int Manager::_heartbeat()
   {
-    while(!_shutdown.load()) {
+    _res_mgr_connection->heartbeat();
 
-      auto wcs = _res_mgr_connection->connection().receive_wcs().poll(false);
-      if(std::get<1>(wcs)) {
+    std::vector<int> expired;
+    _leases.expire(std::chrono::steady_clock::now(), expired);
+    for(int lease_id : expired) {
+      spdlog::info("Lease {} was not claimed by a client, returning it", lease_id);
+      _res_mgr_connection->close_lease(lease_id, 0, 0, 0);
+    }
+    _res_mgr_connection->expire_direct_cores(_lease_ttl_ms);
+    return expired.size();
+  }
 
-        for(int j = 0; j < std::get<1>(wcs); ++j) {
-          _handle_res_mgr_message(std::get<0>(wcs)[j]);
-        }
+  ibv_cq* Manager::_res_mgr_cq()
+  {
+    return _res_mgr_connection ? _res_mgr_connection->connection().qp()->recv_cq : nullptr;
+  }
+
+  void Manager::_add_res_mgr_handlers(rdmalib::Reactor & reactor, rdmalib::Poller & poller)
+  {
+    if(!_res_mgr_connection)
+      return;
+
+    // The poller only arms notifications - receive WCs track the posted requests.
+    reactor.add_channel(poller, [this]() {
+      auto [wcs, count] = _res_mgr_connection->connection().receive_wcs().poll(false);
+      for(int j = 0; j < count; ++j) {
+        _handle_res_mgr_message(wcs[j]);
       }
+      return count;
+    });
+    reactor.add_fd(_res_mgr_connection->heartbeat_fd(), [this]() { return _heartbeat(); });
+  }
 
-    }
+  void Manager::poll_res_mgr()
+  {
+    rdmalib::Reactor reactor{_settings.rdma_spin_us};
+    rdmalib::Poller res_mgr_poller{_res_mgr_cq()};
+    _add_res_mgr_handlers(reactor, res_mgr_poller);
+    reactor.run(_shutdown, POLLING_TIMEOUT_MS);
 
     spdlog::info("Background thread stops waiting for resource manager events.");
   }
 
-  bool Manager::_process_client(Client & client, uint64_t wr_id)
+  bool Manager::_process_client(ClientShard & shard, Client & client, uint64_t wr_id)
   {
-    int32_t lease_id = client.allocation_requests.data()[wr_id].lease_id;
-    char * client_address = client.allocation_requests.data()[wr_id].listen_address;
-    int client_port = client.allocation_requests.data()[wr_id].listen_port;
+    // Copied - the receive buffer is reposted before a parked request completes.
+    rfaas::AllocationRequest request = client.allocation_requests.data()[wr_id];
+    int32_t lease_id = request.lease_id;
 
     if(lease_id >= 0) {
 
@@ -260,108 +497,194 @@ namespace rfaas::executor_manager {
         "Client {} requests lease {}, it should connect to {}:{},"
         "it should have buffer of size {}, func buffer {}, and hot timeout {}",
         client.id(), lease_id,
-        client.allocation_requests.data()[wr_id].listen_address,
-        client.allocation_requests.data()[wr_id].listen_port,
-        client.allocation_requests.data()[wr_id].input_buf_size,
-        client.allocation_requests.data()[wr_id].func_buf_size,
-        client.allocation_requests.data()[wr_id].hot_timeout
+        request.listen_address,
+        request.listen_port,
+        request.input_buf_size,
+        request.func_buf_size,
+        request.hot_timeout
       );
 
-      auto lease = _leases.get_threadsafe(lease_id);
+      client.connection->receive_wcs().update_requests(-1);
+      client.connection->receive_wcs().refill();
 
-      if(!lease.has_value()) {
-        spdlog::warn("Received request for unknown lease {}", lease_id);
-        *_client_responses.data() = (LeaseStatus) {LeaseStatus::UNKNOWN};
-        client.connection->post_send(_client_responses);
-        client.connection->receive_wcs().update_requests(-1);
-        client.connection->receive_wcs().refill();
-        client.connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+      // Cores were already taken by the client from our counter in the capacity table.
+      if(lease_id == rfaas::AllocationRequest::DIRECT_LEASE) {
+        if(!_res_mgr_connection || !_res_mgr_connection->claim_direct_lease(request.cores, request.memory, request.claim_epoch)) {
+          _reject(shard, client, lease_id);
+        } else {
+          _allocate(shard, client, request, Lease{lease_id, request.cores, request.memory});
+        }
         return true;
       }
 
-      rdmalib::PrivateData<0,0,32> data;
-      data.secret(client.connection->qp()->qp_num);
-      uint64_t addr = client.accounting.address(); //+ sizeof(Accounting)*i;
-
-      // FIXME: Docker
-      auto now = std::chrono::high_resolution_clock::now();
-      client.executor.reset(
-        ProcessExecutor::spawn(
-          client.allocation_requests.data()[wr_id],
-          _settings.exec,
-          {
-            _settings.device->ip_address,
-            _settings.rdma_device_port,
-            data.data(), addr, client.accounting.rkey()
-          },
-          lease.value()
-        )
-      );
-      auto end = std::chrono::high_resolution_clock::now();
-      spdlog::info(
-        "Client {} at {}:{} has executor with {} ID and {} cores, time {} us",
-        client.id(), client_address, client_port, client.executor->id(), lease->cores,
-        std::chrono::duration_cast<std::chrono::microseconds>(end-now).count()
+      // The resource manager's LeaseAllocation can arrive after the client's request.
+      bool parked = false;
+      auto lease = _leases.get_or_park_threadsafe(
+        lease_id,
+        {
+          client.connection->qp()->qp_num, request,
+          std::chrono::steady_clock::now() + std::chrono::milliseconds(PENDING_LEASE_TIMEOUT_MS)
+        },
+        parked
       );
 
-      *_client_responses.data() = (LeaseStatus) {LeaseStatus::ALLOCATED};
-      client.connection->post_send(_client_responses);
-
-      client.connection->receive_wcs().update_requests(-1);
-      client.connection->receive_wcs().refill();
-
-      client.connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+      if(parked) {
+        SPDLOG_DEBUG("Client {} waits for lease {}", client.id(), lease_id);
+      } else if(!lease.has_value()) {
+        _reject(shard, client, lease_id);
+      } else {
+        _allocate(shard, client, request, lease.value());
+      }
       return true;
     } else {
 
       spdlog::info("Client {} disconnects", client.id());
       //client.disable(i, _accounting_data.data()[i]);
-      client.disable(_res_mgr_connection.get());
+      client.disable(_reaper);
 
       return false;
     }
 
   }
 
-  void Manager::_check_executors(removals_t & removals)
+  void Manager::_reject(ClientShard & shard, Client & client, int32_t lease_id)
   {
-    for(auto it = _clients.begin(); it != _clients.end(); ++it) {
+    spdlog::warn("Received request for unknown lease {}", lease_id);
+    *shard.responses.data() = (LeaseStatus) {LeaseStatus::UNKNOWN, 0};
+    client.connection->post_send(shard.responses);
+    client.connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+  }
 
-      Client & client = it->second;
-      int i = it->first;
-      if(!client.active()) {
-        continue;
-      }
+  void Manager::_allocate(ClientShard & shard, Client & client, const rfaas::AllocationRequest & request, const Lease & lease)
+  {
+    rdmalib::PrivateData<0,0,32> data;
+    data.secret(client.connection->qp()->qp_num);
+    uint64_t addr = client.accounting.address(); //+ sizeof(Accounting)*i;
+
+    // Executor either loads the library from the cache, or stores it there after receiving.
+    uint64_t func_hash = request.func_hash;
+    bool library_cached = _library_cache.contains(func_hash);
+    std::string func_library, func_cache;
+    if(library_cached)
+      func_library = _library_cache.path(func_hash);
+    else if(_library_cache.enabled() && func_hash)
+      func_cache = _library_cache.path(func_hash);
+    SPDLOG_DEBUG("Client {} library hash {:x}, cached {}", client.id(), func_hash, library_cached);
+
+    CoreSet cores;
+    if(_settings.exec.pin_threads) {
+      cores = _cores.allocate(lease.cores);
+      if(cores.empty())
+        spdlog::warn("Not enough free cores for lease {}, executor will not be pinned", lease.id);
+      else
+        SPDLOG_DEBUG("Lease {} pinned to cores {}", lease.id, cores.str());
+    }
 
-      if(!client.executor) {
-        continue;
-      }
+    // FIXME: Docker
+    auto now = std::chrono::high_resolution_clock::now();
+    client.executor.reset(
+      ProcessExecutor::spawn(
+        request,
+        _settings.exec,
+        {
+          _settings.device->ip_address,
+          _settings.rdma_device_port,
+          data.data(), addr, client.accounting.rkey()
+        },
+        lease,
+        func_library,
+        func_cache,
+        std::move(cores),
+        _launcher,
+        _reaper,
+        client.connection->qp()->qp_num,
+        &_zygotes,
+        &_sandbox
+      )
+    );
+    auto end = std::chrono::high_resolution_clock::now();
+    spdlog::info(
+      "Client {} at {}:{} has executor with {} cores, launch submitted in {} us",
+      client.id(), request.listen_address, request.listen_port, lease.cores,
+      std::chrono::duration_cast<std::chrono::microseconds>(end-now).count()
+    );
 
-      auto status = client.executor->check();
-      if(std::get<0>(status) != ActiveExecutor::Status::RUNNING) {
-        auto now = std::chrono::high_resolution_clock::now();
-        client.allocation_time +=
-          std::chrono::duration_cast<std::chrono::microseconds>(
-            now - client.executor->_allocation_finished
-          ).count();
-
-        // FIXME: update global manager
-        // send lease cancellation
-        spdlog::info(
-          "Executor at client {} exited, status {}, time allocated {} us, polling {} us, execution {} us",
-          i, std::get<1>(status), client.allocation_time,
-          client.accounting.data()[i].hot_polling_time / 1000.0,
-          client.accounting.data()[i].execution_time / 1000.0
-        );
-        client.executor.reset(nullptr);
-        spdlog::info("Finished cleanup");
-
-        // FIXME: notify client
-        client.disable(_res_mgr_connection.get());
-        removals.push_back(it);
-      }
+    client.lease_id = lease.id;
+    *shard.responses.data() = (LeaseStatus) {LeaseStatus::ALLOCATED, library_cached};
+    client.connection->post_send(shard.responses);
+    client.connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+
+    // Replace the used zygote after the launch.
+    _launcher.submit([this]() { _zygotes.fill(); return 0; });
+  }
+
+  int Manager::_process_pending()
+  {
+    if(!_leases.has_pending())
+      return 0;
+
+    std::vector<PendingRequest> ready, expired;
+    _leases.poll_pending(ready, expired);
+
+    int count = ready.size() + expired.size();
+    for(auto & pending : ready) {
+      uint32_t client = pending.client;
+      _dispatch(Operation::LEASE_READY, client, std::move(pending));
+    }
+    for(auto & pending : expired) {
+      uint32_t client = pending.client;
+      _dispatch(Operation::LEASE_EXPIRED, client, std::move(pending));
+    }
+    return count;
+  }
 
+  void Manager::_handle_pending(ClientShard & shard, Operation op, const PendingRequest & pending)
+  {
+    auto it = shard.clients.find(pending.client);
+    // The client could have disconnected in the meantime.
+    if(it == shard.clients.end() || !it->second.active())
+      return;
+
+    if(op == Operation::LEASE_EXPIRED) {
+      _reject(shard, it->second, pending.request.lease_id);
+      return;
     }
+
+    auto lease = _leases.get_threadsafe(pending.request.lease_id);
+    SPDLOG_DEBUG("Client {} received lease {}", it->second.id(), pending.request.lease_id);
+    if(lease.has_value())
+      _allocate(shard, it->second, pending.request, lease.value());
+    else
+      _reject(shard, it->second, pending.request.lease_id);
+  }
+
+  int Manager::_handle_exits()
+  {
+    uint32_t id;
+    pid_t pid;
+    int count = 0;
+    while(_reaper.exited(id, pid)) {
+      _dispatch(Operation::EXIT, id, pid);
+      ++count;
+    }
+    return count;
+  }
+
+  void Manager::_handle_exit(ClientShard & shard, uint32_t id, pid_t pid)
+  {
+    auto it = shard.clients.find(id);
+    // The client could have disconnected in the meantime.
+    if(it == shard.clients.end() || !it->second.active() || !it->second.executor)
+      return;
+    Client & client = it->second;
+    if(client.executor->id() != pid)
+      return;
+
+    // FIXME: notify client
+    spdlog::info("Executor at client {} exited, launch failed? {}", id, pid == -1);
+    client.disable(_reaper);
+    spdlog::info("Remove client id {}", id);
+    shard.clients.erase(it);
   }
 
   std::tuple<Manager::Operation, Manager::msg_t>* Manager::_check_queue(bool sleep)
@@ -378,15 +701,71 @@ namespace rfaas::executor_manager {
     return updated ? &result : nullptr;
   }
 
-  void Manager::_handle_connections(msg_t & message)
+  void Manager::_forward_connection(Operation op, msg_t && message)
+  {
+    // Executors connect with the ID of their client.
+    uint32_t client;
+    if(std::holds_alternative<Client>(message))
+      client = std::get<Client>(message).connection->qp()->qp_num;
+    else if(op == Operation::CONNECT)
+      client = std::get<rdmalib::Connection*>(message)->private_data();
+    else
+      client = std::get<rdmalib::Connection*>(message)->qp()->qp_num;
+    _dispatch(op, client, std::move(message));
+  }
+
+  void Manager::_dispatch(Operation op, uint32_t client, msg_t && message)
+  {
+    ClientShard & shard = *_shards[client % _shards.size()];
+    if(!_workers)
+      _process_event(shard, op, client, message);
+    else
+      shard.events.emplace(op, client, std::move(message));
+  }
+
+  void Manager::_run_worker(ClientShard & shard)
+  {
+    std::tuple<Operation, uint32_t, msg_t> event;
+    while(!_shutdown.load()) {
+      if(shard.events.wait_dequeue_timed(event, POLLING_TIMEOUT_MS * 1000))
+        _process_event(shard, std::get<0>(event), std::get<1>(event), std::get<2>(event));
+    }
+
+    spdlog::info("Background thread stops processing {} clients.", shard.clients.size());
+    shard.clients.clear();
+  }
+
+  void Manager::_process_event(ClientShard & shard, Operation op, uint32_t client, msg_t & message)
+  {
+    switch(op) {
+      case Operation::CONNECT:
+        _handle_connections(shard, message);
+        break;
+      case Operation::DISCONNECT:
+        _handle_disconnections(shard, std::get<rdmalib::Connection*>(message));
+        break;
+      case Operation::MESSAGE:
+        _handle_client_message(shard, std::get<ibv_wc>(message));
+        break;
+      case Operation::EXIT:
+        _handle_exit(shard, client, std::get<pid_t>(message));
+        break;
+      case Operation::LEASE_READY:
+      case Operation::LEASE_EXPIRED:
+        _handle_pending(shard, op, std::get<PendingRequest>(message));
+        break;
+    }
+  }
+
+  void Manager::_handle_connections(ClientShard & shard, msg_t & message)
   {
     if(std::holds_alternative<rdmalib::Connection*>(message)) {
 
       rdmalib::Connection* conn = std::get<rdmalib::Connection*>(message);
 
       uint32_t qp_num = conn->private_data();
-      auto it = _clients.find(qp_num);
-      if(it == _clients.end()) {
+      auto it = shard.clients.find(qp_num);
+      if(it == shard.clients.end()) {
         spdlog::error("Unmatched executor! Client ID {}", qp_num);
         // FIXME: disconnect
         delete conn;
@@ -398,7 +777,7 @@ namespace rfaas::executor_manager {
     } else {
 
       Client& client = std::get<Client>(message);
-      _clients.emplace(std::piecewise_construct,
+      shard.clients.emplace(std::piecewise_construct,
                       std::forward_as_tuple(client.connection->qp()->qp_num),
                       std::forward_as_tuple(std::move(client))
       );
@@ -407,27 +786,27 @@ namespace rfaas::executor_manager {
     }
   }
 
-  void Manager::_handle_disconnections(rdmalib::Connection* conn)
+  void Manager::_handle_disconnections(ClientShard & shard, rdmalib::Connection* conn)
   {
-    auto it = _clients.find(conn->qp()->qp_num);
-    if (it != _clients.end()) {
+    auto it = shard.clients.find(conn->qp()->qp_num);
+    if (it != shard.clients.end()) {
       spdlog::debug("[Manager] Disconnecting client");
 
       Client& client = (*it).second;
       //client.disable(i, _accounting_data.data()[i]);
-      client.disable(_res_mgr_connection.get());
-      _clients.erase(it);
+      client.disable(_reaper);
+      shard.clients.erase(it);
 
     } else {
       spdlog::debug("[Manager] Disconnecting unknown client");
     }
   }
 
-  void Manager::_handle_client_message(ibv_wc& wc)
+  void Manager::_handle_client_message(ClientShard & shard, ibv_wc& wc)
   {
     uint32_t qp_num = wc.qp_num;
-    auto it = _clients.find(qp_num);
-    if(it != _clients.end()) {
+    auto it = shard.clients.find(qp_num);
+    if(it != shard.clients.end()) {
 
       if(wc.status != IBV_WC_SUCCESS) {
         spdlog::error("Failed work completion on client {}, error {}", qp_num, wc.status);
@@ -435,8 +814,8 @@ namespace rfaas::executor_manager {
       }
 
       Client & client = (*it).second;
-      if(!_process_client(client, wc.wr_id)) {
-        _clients.erase(it);
+      if(!_process_client(shard, client, wc.wr_id)) {
+        shard.clients.erase(it);
       }
 
     } else {
@@ -444,49 +823,57 @@ namespace rfaas::executor_manager {
     }
   }
 
-  void Manager::poll_rdma()
+  void Manager::_add_client_handlers(rdmalib::Reactor & reactor, rdmalib::Poller & poller)
   {
-    rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(0))};
-    std::vector<std::unordered_map<uint32_t, Client>::iterator> removals;
-    int conn_count = 0;
-
-    while(!_shutdown.load()) {
-
-      while(true) {
-
-        auto ptr = _check_queue(conn_count > 0);
-        if(!ptr) {
-          break;
-        }
-
-        if (std::get<0>(*ptr) == Operation::CONNECT) {
-          _handle_connections(std::get<1>(*ptr));
-          conn_count++;
-        } else {
-          _handle_disconnections(std::get<0>(std::get<1>(*ptr)));
-        }
+    // New connections are handled first, to recognize messages arriving from new clients.
+    reactor.add_task([this]() {
+      int count = 0;
+      while(auto ptr = _check_queue(false)) {
+        _forward_connection(std::get<0>(*ptr), std::move(std::get<1>(*ptr)));
+        ++count;
       }
+      return count;
+    });
 
-      auto wcs = recv_poller.poll(false);
-      for(int j = 0; j < std::get<1>(wcs); ++j) {
-
-        auto wc = std::get<0>(wcs)[j];
-        _handle_client_message(wc);
-
+    reactor.add_channel(poller, [this, &poller]() {
+      auto [wcs, count] = poller.poll(false);
+      for(int j = 0; j < count; ++j) {
+        _dispatch(Operation::MESSAGE, wcs[j].qp_num, wcs[j]);
       }
+      return count;
+    });
+
+    // Exits are reported by the reaper; no process is polled here.
+    reactor.add_task([this]() { return _handle_exits(); });
+    reactor.add_fd(_reaper.fd(), [this]() { _reaper.acknowledge(); return 0; });
+    // Requests parked until their lease arrives from the resource manager.
+    reactor.add_fd(_leases.fd(), [this]() { return _process_pending(); });
+  }
 
-      _check_executors(removals);
+  void Manager::poll_rdma()
+  {
+    rdmalib::Reactor reactor{_settings.rdma_spin_us};
+    rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(0))};
+    _add_client_handlers(reactor, recv_poller);
+    reactor.run(_shutdown, POLLING_TIMEOUT_MS);
 
-      if(removals.size()) {
-        for(auto it : removals) {
-          spdlog::info("Remove client id {}", it->first);
-          _clients.erase(it);
-        }
-        removals.clear();
-      }
-    }
     spdlog::info("Background thread stops processing RDMA events.");
-    _clients.clear();
+    if(!_workers)
+      _shards[0]->clients.clear();
+  }
+
+  void Manager::poll_events()
+  {
+    rdmalib::Reactor reactor{_settings.rdma_spin_us};
+    rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(0))};
+    rdmalib::Poller res_mgr_poller{_res_mgr_cq()};
+    _add_client_handlers(reactor, recv_poller);
+    _add_res_mgr_handlers(reactor, res_mgr_poller);
+    reactor.run(_shutdown, POLLING_TIMEOUT_MS);
+
+    spdlog::info("Background thread stops processing RDMA and resource manager events.");
+    if(!_workers)
+      _shards[0]->clients.clear();
   }
 
   void Manager::_process_events_sleep()
@@ -504,6 +891,9 @@ namespace rfaas::executor_manager {
 
     event_poller.add_channel(client_poller, 0);
     event_poller.add_channel(res_mgr, 1);
+    event_poller.add_fd(_reaper.fd(), 2);
+    event_poller.add_fd(_leases.fd(), 3);
+    event_poller.add_fd(_res_mgr_connection->heartbeat_fd(), 4);
 
     std::vector<Client*> poll_send;
     std::vector<rdmalib::Connection*> disconnections;
@@ -519,7 +909,7 @@ namespace rfaas::executor_manager {
 
         if(ptr) {
           if (std::get<0>(*ptr) == Operation::CONNECT) {
-            _handle_connections(std::get<1>(*ptr));
+            _forward_connection(Operation::CONNECT, std::move(std::get<1>(*ptr)));
           } else {
             disconnections.emplace_back(std::get<0>(std::get<1>(*ptr)));
           }
@@ -553,11 +943,21 @@ namespace rfaas::executor_manager {
           auto wcs = client_poller.poll(false);
           if(std::get<1>(wcs)) {
             for (int j = 0; j < std::get<1>(wcs); ++j) {
-              _handle_client_message(std::get<0>(wcs)[j]);
+              _dispatch(Operation::MESSAGE, std::get<0>(wcs)[j].qp_num, std::get<0>(wcs)[j]);
             }
           }
 
-        } else {
+        } else if(events[i].data.u32 == 2) {
+
+          // Acknowledge first - later exits notify again.
+          _reaper.acknowledge();
+          _handle_exits();
+
+        } else if(events[i].data.u32 == 4) {
+
+          _heartbeat();
+
+        } else if(events[i].data.u32 == 1) {
 
           auto cq = res_mgr.wait_events();
           res_mgr.ack_events(cq, 1);
@@ -578,10 +978,13 @@ namespace rfaas::executor_manager {
         queue();
       }
 
+      // Leases that arrived above, and requests past their deadline.
+      _process_pending();
+
       if(disconnections.size()) {
 
         for (auto conn : disconnections) {
-          _handle_disconnections(conn);
+          _forward_connection(Operation::DISCONNECT, conn);
         }
 
         disconnections.clear();
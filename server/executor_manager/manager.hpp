@@ -9,8 +9,11 @@
 #include <vector>
 #include <mutex>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 #include <rdmalib/connection.hpp>
+#include <rdmalib/poller.hpp>
 #include <rdmalib/rdmalib.hpp>
 #include <rdmalib/server.hpp>
 #include <rdmalib/buffer.hpp>
@@ -18,7 +21,13 @@
 #include <rfaas/allocation.hpp>
 
 #include "client.hpp"
+#include "launcher.hpp"
+#include "library_cache.hpp"
+#include "reaper.hpp"
+#include "sandbox.hpp"
 #include "settings.hpp"
+#include "topology.hpp"
+#include "zygote_pool.hpp"
 #include "common/messages.hpp"
 #include "common.hpp"
 #include "common/readerwriterqueue.h"
@@ -42,56 +51,72 @@ namespace rfaas::executor_manager {
     rdmalib::RDMAActive _connection;
     rdmalib::Buffer<common::LeaseAllocation>  _receive_buffer;
     rdmalib::Buffer<uint8_t>  _send_buffer;
-
-    ResourceManagerConnection(const std::string& name, int port, int receive_buf_size):
-      _connection(name, port, receive_buf_size),
-      _receive_buffer(receive_buf_size),
-      _send_buffer(std::max(sizeof(common::LeaseDeallocation), sizeof(common::NodeRegistration)))
+    // Written to our slot of the resource manager's liveness table.
+    rdmalib::Buffer<common::NodeHeartbeat> _heartbeat;
+    rdmalib::RemoteBuffer _liveness_slot;
+    // Counter of our delegated cores in the capacity table; rkey 0 when direct leases are disabled.
+    rdmalib::RemoteBuffer _capacity_slot;
+    rdmalib::Buffer<uint64_t> _atomic_result;
+    // Delegated resources, cores of running direct leases, and the current epoch of the counter.
+    int _direct_cores;
+    int _direct_memory;
+    int _direct_used;
+    uint32_t _direct_epoch;
+    std::chrono::steady_clock::time_point _direct_reset;
+    // Leases received from the resource manager and not closed yet.
+    std::unordered_map<int32_t, common::LeaseReport> _open_leases;
+    int _heartbeat_fd;
+    // Heartbeats and lease deallocations are sent from different threads.
+    std::mutex _send_mutex;
+
+    // Each receive slot fits a full batch of allocations.
+    static constexpr int RECV_SLOT_SIZE = common::LeaseAllocation::MAX_BATCH;
+
+    ResourceManagerConnection(const std::string& name, int port, int receive_buf_size);
+    ~ResourceManagerConnection();
+
+    bool connect(const std::string& node_name, uint32_t resource_manager_secret);
+
+    void open_lease(const common::LeaseAllocation & allocation);
+    // Cancelled by the resource manager, which already released its resources.
+    void forget_lease(int32_t lease_id);
+    void close_lease(int32_t lease_id, uint64_t allocation_time, uint64_t execution_time, uint64_t hot_polling_time);
+    // The resource manager reclaimed our leases while it didn't see heartbeats.
+    // Leases still held are restored before it places new leases on the node.
+    void report_leases();
+
+    void start_heartbeats(const common::NodeLiveness & msg);
+
+    void set_capacity_slot(const common::NodeCapacitySlot & msg);
+    // Verifies the cores claimed by the client against the delegated resources.
+    // Valid claims of rejected requests are returned to the counter.
+    bool claim_direct_lease(int cores, int memory, uint32_t epoch);
+    // Cores of a finished direct lease become available to clients again.
+    void return_cores(int cores);
+    // Cores claimed by clients that never requested a lease are returned
+    // by resetting the counter once per lease TTL.
+    void expire_direct_cores(int lease_ttl_ms);
+
+    // Readable when the next heartbeat is due.
+    int heartbeat_fd() const
     {
-      _connection.allocate();
-      _send_buffer.register_memory(_connection.pd(), IBV_ACCESS_LOCAL_WRITE); 
-      _receive_buffer.register_memory(_connection.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE); 
+      return _heartbeat_fd;
     }
 
-    bool connect(const std::string& node_name, uint32_t resource_manager_secret)
-    {
-      if(!_connection.connect(resource_manager_secret)) {
-        spdlog::error("Connection to resource manager was not succesful!");
-        return false;
-      }
-
-      _connection.connection().receive_wcs().initialize(_receive_buffer);
-
-      common::NodeRegistration reg;
-      strncpy(reg.node_name, node_name.c_str(), common::NodeRegistration::NODE_NAME_LENGTH);
-      memcpy(_send_buffer.data(), &reg, sizeof(common::NodeRegistration));
-
-      _connection.connection().post_send(_send_buffer, 0);
-      _connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 1);
-
-      return true;
-    }
-
-    void close_lease(int32_t lease_id, uint64_t allocation_time, uint64_t execution_time, uint64_t hot_polling_time)
-    {
-      *reinterpret_cast<common::LeaseDeallocation*>(_send_buffer.data()) = {
-        .lease_id = lease_id,
-        .allocation_time = allocation_time,
-        .hot_polling_time = hot_polling_time,
-        .execution_time = execution_time
-      };
-
-      _connection.connection().post_send(_send_buffer, 0);
-      auto [wcs, count] = _connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 1);
-      if(count == 0 || wcs[0].status != IBV_WC_SUCCESS) {
-        spdlog::error("Failed to notify resource manager of lease {} close down.", lease_id);
-      }
-    }
+    void heartbeat();
 
     rdmalib::Connection& connection()
     {
       return _connection.connection();
     }
+
+  private:
+    void _send_message(const char* operation);
+    bool _complete_atomic(const char* operation);
+    void _return_cores(int cores);
+    // Sets the counter to the cores not used by direct leases, under a new epoch.
+    // Clients swap only within an epoch, so a concurrent claim makes us retry.
+    void _reset_direct_cores();
   };
 
   struct Lease
@@ -99,20 +124,62 @@ namespace rfaas::executor_manager {
     int id;
     int cores;
     int memory;
+    // Returned to the resource manager when no client claims it before.
+    std::chrono::steady_clock::time_point expires = std::chrono::steady_clock::time_point::max();
   };
 
+  // Allocation request that arrived before the lease from the resource manager.
+  struct PendingRequest
+  {
+    uint32_t client;
+    rfaas::AllocationRequest request;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  // Leases are split into shards by their ID - requests of different leases
+  // processed by different threads do not contend on a single lock.
   struct Leases
   {
+    static constexpr int SHARDS = 16;
+
+    Leases();
+    ~Leases();
 
     void insert(Lease &&);
+    // Wakes up requests waiting for the lease.
     void insert_threadsafe(Lease &&);
 
     std::optional<Lease> get(int id);
     std::optional<Lease> get_threadsafe(int id);
+    // Returns the lease, or parks the request until the lease arrives.
+    // A second request for the same lease is not parked.
+    std::optional<Lease> get_or_park_threadsafe(int id, const PendingRequest & request, bool & parked);
+
+    // Removes leases that no client claimed before their expiry.
+    void expire(std::chrono::steady_clock::time_point now, std::vector<int> & expired);
+
+    bool has_pending() const;
+    // Requests whose lease has arrived, and requests that timed out waiting for it.
+    void poll_pending(std::vector<PendingRequest> & ready, std::vector<PendingRequest> & expired);
+    // Readable when a parked request can be completed.
+    int fd() const;
 
   private:
-    std::unordered_map<int, Lease> _leases;
-    std::mutex _mutex;
+    struct Shard
+    {
+      std::unordered_map<int, Lease> leases;
+      std::unordered_map<int, PendingRequest> pending;
+      std::mutex mutex;
+    };
+
+    Shard _shards[SHARDS];
+    // Acquired while holding the lock of a shard.
+    std::mutex _ready_mutex;
+    std::vector<PendingRequest> _ready;
+    std::atomic<int> _pending_count;
+    int _ready_fd;
+
+    Shard & _shard(int id);
   };
 
   struct Manager
@@ -120,55 +187,101 @@ namespace rfaas::executor_manager {
     static constexpr int MAX_EXECUTORS_ACTIVE = 8;
     static constexpr int MAX_CLIENTS_ACTIVE = 1024;
     static constexpr int POLLING_TIMEOUT_MS = 100;
+    // Allocation requests wait this long for their lease from the resource manager.
+    static constexpr int PENDING_LEASE_TIMEOUT_MS = 1000;
 
     enum class Operation
     {
       CONNECT = 0,
-      DISCONNECT = 1
+      DISCONNECT = 1,
+      // Forwarded by the polling thread to the shard of a client.
+      MESSAGE = 2,
+      EXIT = 3,
+      LEASE_READY = 4,
+      LEASE_EXPIRED = 5
     };
 
     // The first variatn members corresponds to a new executor for a client.
     // The second one corresponds to a client instance.
+    // The remaining ones are forwarded to shards: a message received from the client,
+    // the PID of its exited executor, and its request parked until the lease arrived.
     //
     // Integer corresponds to the client number ID.
     //
-    typedef std::variant<rdmalib::Connection*, Client> msg_t;
+    typedef std::variant<rdmalib::Connection*, Client, ibv_wc, pid_t, PendingRequest> msg_t;
     moodycamel::BlockingReaderWriterQueue<std::tuple<Operation, msg_t>> _client_queue;
 
-    std::mutex clients;
-    std::unordered_map<uint32_t, Client> _clients;
+    // Clients are split between shards by their ID, and each shard is owned by one worker.
+    // The polling thread only forwards events, and allocations of clients in different
+    // shards proceed concurrently. Without workers, the polling thread processes the only shard.
+    struct ClientShard
+    {
+      std::unordered_map<uint32_t, Client> clients;
+      // We could use a circular buffer here if polling for send WCs becomes an issue.
+      rdmalib::Buffer<rfaas::LeaseStatus> responses;
+      // Written only by the polling thread.
+      moodycamel::BlockingReaderWriterQueue<std::tuple<Operation, uint32_t, msg_t>> events;
+
+      ClientShard();
+    };
+    std::vector<std::unique_ptr<ClientShard>> _shards;
+    int _workers;
     int _ids;
 
     std::unique_ptr<ResourceManagerConnection> _res_mgr_connection;
 
     rdmalib::RDMAPassive _state;
-    // We could use a circular buffer here if polling for send WCs becomes an issue.
-    rdmalib::Buffer<rfaas::LeaseStatus> _client_responses;
     Settings _settings;
     //rdmalib::Buffer<Accounting> _accounting_data;
     bool _skip_rm;
     std::atomic<bool> _shutdown;
     Leases _leases;
+    // Set by the resource manager; zero keeps unclaimed leases forever.
+    int _lease_ttl_ms;
+    LibraryCache _library_cache;
+    CoreAllocator _cores;
+    Sandbox _sandbox;
+    ZygotePool _zygotes;
+    Launcher _launcher;
+    Reaper _reaper;
 
     Manager(Settings &, bool skip_rm);
 
     void start();
     void listen();
+    // Clients and the resource manager on separate threads, or together on one.
     void poll_rdma();
     void poll_res_mgr();
+    void poll_events();
     void shutdown();
 
   private:
 
-    typedef std::vector<std::unordered_map<uint32_t, Client>::iterator> removals_t;
-    void _check_executors(removals_t & removals);
+    // Polling thread - forwards events to shards.
+    int _handle_exits();
+    int _process_pending();
+    void _add_client_handlers(rdmalib::Reactor & reactor, rdmalib::Poller & poller);
+    ibv_cq* _res_mgr_cq();
+    void _add_res_mgr_handlers(rdmalib::Reactor & reactor, rdmalib::Poller & poller);
     std::tuple<Operation, msg_t>* _check_queue(bool sleep);
-    void _handle_connections(msg_t & message);
-    void _handle_disconnections(rdmalib::Connection* conn);
-    bool _process_client(Client & client, uint64_t wr_id);
+    void _forward_connection(Operation op, msg_t && message);
+    void _dispatch(Operation op, uint32_t client, msg_t && message);
     void _process_events_sleep();
-    void _handle_client_message(ibv_wc& wc);
     void _handle_res_mgr_message(ibv_wc& wc);
+    // Sends the heartbeat, and returns expired leases to the resource manager.
+    int _heartbeat();
+
+    // Owner of the shard.
+    void _run_worker(ClientShard & shard);
+    void _process_event(ClientShard & shard, Operation op, uint32_t client, msg_t & message);
+    void _handle_connections(ClientShard & shard, msg_t & message);
+    void _handle_disconnections(ClientShard & shard, rdmalib::Connection* conn);
+    void _handle_client_message(ClientShard & shard, ibv_wc& wc);
+    void _handle_exit(ClientShard & shard, uint32_t id, pid_t pid);
+    void _handle_pending(ClientShard & shard, Operation op, const PendingRequest & pending);
+    bool _process_client(ClientShard & shard, Client & client, uint64_t wr_id);
+    void _allocate(ClientShard & shard, Client & client, const rfaas::AllocationRequest & request, const Lease & lease);
+    void _reject(ClientShard & shard, Client & client, int32_t lease_id);
   };
 
 }
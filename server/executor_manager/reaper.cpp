@@ -0,0 +1,364 @@
+
+#include <cstring>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <spdlog/spdlog.h>
+
+#include <rdmalib/util.hpp>
+
+#include "manager.hpp"
+#include "reaper.hpp"
+#include "zygote_pool.hpp"
+
+// Not exposed by older glibc.
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+namespace rfaas::executor_manager {
+
+  constexpr int Reaper::POLLING_TIMEOUT_MS;
+  constexpr int Reaper::MAX_EVENTS;
+  constexpr int Reaper::TERMINATE_TIMEOUT_MS;
+  constexpr uint64_t Reaper::WAKEUP;
+  constexpr uint64_t Reaper::PARKING;
+
+  Reaper::Reaper(ZygotePool * zygotes):
+    _res_mgr(nullptr),
+    _zygotes(zygotes),
+    _releases(64),
+    _exits(64)
+  {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    rdmalib::impl::expect_nonnegative(_epoll_fd);
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    rdmalib::impl::expect_nonnegative(_wakeup_fd);
+    _exit_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    rdmalib::impl::expect_nonnegative(_exit_fd);
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKEUP;
+    rdmalib::impl::expect_zero(epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &ev));
+  }
+
+  Reaper::~Reaper()
+  {
+    for(auto & [pid, process] : _processes)
+      close(process.pidfd);
+    close(_exit_fd);
+    close(_wakeup_fd);
+    close(_epoll_fd);
+  }
+
+  void Reaper::watch(uint32_t client, pid_t pid)
+  {
+    if(pid <= 0) {
+      std::lock_guard<std::mutex> lock{_mutex};
+      _failed.push_back(client);
+      _notify(_wakeup_fd);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      auto it = _processes.find(pid);
+      if(it != _processes.end()) {
+        SPDLOG_DEBUG("Executor {} moves from client {} to client {}", pid, it->second.client, client);
+        it->second.client = client;
+        return;
+      }
+    }
+
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if(pidfd < 0) {
+      // The executor is stopped with a blocking wait when the lease ends.
+      spdlog::warn("Couldn't open pidfd of executor {}, reason {}, exit won't be detected", pid, strerror(errno));
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      _processes[pid] = Process{client, pidfd};
+    }
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = static_cast<uint64_t>(pid);
+    if(epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, pidfd, &ev))
+      spdlog::error("Couldn't watch executor {}, reason {}", pid, strerror(errno));
+    SPDLOG_DEBUG("Watching executor {} of client {}", pid, client);
+  }
+
+  void Reaper::release(Release && release)
+  {
+    {
+      std::lock_guard<std::mutex> lock{_release_mutex};
+      _releases.enqueue(std::move(release));
+    }
+    _notify(_wakeup_fd);
+  }
+
+  bool Reaper::exited(uint32_t & client, pid_t & pid)
+  {
+    std::tuple<uint32_t, pid_t> exit;
+    if(!_exits.try_dequeue(exit))
+      return false;
+    std::tie(client, pid) = exit;
+    return true;
+  }
+
+  int Reaper::fd() const
+  {
+    return _exit_fd;
+  }
+
+  void Reaper::acknowledge()
+  {
+    uint64_t value;
+    (void)!read(_exit_fd, &value, sizeof(value));
+  }
+
+  void Reaper::_notify(int fd)
+  {
+    uint64_t value = 1;
+    (void)!write(fd, &value, sizeof(value));
+  }
+
+  void Reaper::run(const std::atomic<bool> & shutdown, ResourceManagerConnection* res_mgr)
+  {
+    _res_mgr = res_mgr;
+    epoll_event events[MAX_EVENTS];
+    std::vector<uint32_t> failed;
+
+    while(!shutdown.load()) {
+
+      int count = epoll_wait(_epoll_fd, events, MAX_EVENTS, POLLING_TIMEOUT_MS);
+      if(count < 0 && errno != EINTR) {
+        spdlog::error("Failed to poll executor exits, reason {}", strerror(errno));
+        break;
+      }
+
+      for(int i = 0; i < count; ++i) {
+        if(events[i].data.u64 == WAKEUP) {
+          uint64_t value;
+          (void)!read(_wakeup_fd, &value, sizeof(value));
+        } else if(events[i].data.u64 & PARKING) {
+          _park(static_cast<pid_t>(events[i].data.u64 & ~PARKING));
+        } else {
+          _reap(static_cast<pid_t>(events[i].data.u64));
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock{_mutex};
+        failed.swap(_failed);
+      }
+      for(uint32_t client : failed)
+        _exits.enqueue(std::make_tuple(client, -1));
+      if(!failed.empty())
+        _notify(_exit_fd);
+      failed.clear();
+
+      Release release;
+      while(_releases.try_dequeue(release))
+        _release(std::move(release));
+      _escalate();
+
+      if(_zygotes)
+        _zygotes->expire_parked();
+    }
+    spdlog::info(
+      "Background thread stops reaping executors, {} still terminating, {} still parking.",
+      _terminating.size(), _parking.size()
+    );
+  }
+
+  void Reaper::_reap(pid_t pid)
+  {
+    int status = 0;
+    waitpid(pid, &status, WNOHANG);
+
+    uint32_t client;
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      auto it = _processes.find(pid);
+      if(it == _processes.end())
+        return;
+      client = it->second.client;
+      epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, it->second.pidfd, nullptr);
+      close(it->second.pidfd);
+      _processes.erase(it);
+    }
+
+    // The channel is closed when the pool forgets the executor.
+    auto parking = _parking.find(pid);
+    if(parking != _parking.end()) {
+      epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, std::get<1>(parking->second), nullptr);
+      _terminating.emplace(pid, std::move(std::get<0>(parking->second)));
+      _parking.erase(parking);
+    }
+
+    // Parked executors exit once their keep-alive window expires.
+    if(_zygotes && _zygotes->forget(pid)) {
+      SPDLOG_DEBUG("Parked executor {} exited", pid);
+      return;
+    }
+
+    auto it = _terminating.find(pid);
+    if(it != _terminating.end()) {
+      _finish(std::move(it->second));
+      _terminating.erase(it);
+      _killed.erase(pid);
+      return;
+    }
+
+    // Exited before the client closed the lease.
+    spdlog::info(
+      "Executor {} of client {} exited, status {}",
+      pid, client, WIFEXITED(status) ? WEXITSTATUS(status) : -1
+    );
+    _exited.insert(pid);
+    _exits.enqueue(std::make_tuple(client, pid));
+    _notify(_exit_fd);
+  }
+
+  void Reaper::_release(Release && release)
+  {
+    // Waits for a pending launch to finish.
+    pid_t pid = release.executor ? release.executor->id() : -1;
+    if(pid <= 0 || _exited.erase(pid)) {
+      _finish(std::move(release));
+      return;
+    }
+
+    bool watched;
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      watched = _processes.find(pid) != _processes.end();
+    }
+    release.begin = std::chrono::high_resolution_clock::now();
+    // The signal ends the lease before the executor can receive arguments of the next one.
+    // Parking waits for the executor to stop, so the accounting read in _finish is final.
+    int channel = release.executor->keep_alive && watched && _zygotes ? _zygotes->channel(pid) : -1;
+    if(channel != -1) {
+      epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.u64 = PARKING | static_cast<uint64_t>(pid);
+      if(!epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, channel, &ev)) {
+        kill(pid, SIGUSR2);
+        _parking.emplace(pid, std::make_tuple(std::move(release), channel));
+        return;
+      }
+      spdlog::error("Couldn't watch the channel of executor {}, reason {}", pid, strerror(errno));
+    }
+    _stop(pid, std::move(release));
+  }
+
+  void Reaper::_park(pid_t pid)
+  {
+    auto it = _parking.find(pid);
+    if(it == _parking.end())
+      return;
+    Release release = std::move(std::get<0>(it->second));
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, std::get<1>(it->second), nullptr);
+    _parking.erase(it);
+
+    if(_zygotes->park(pid)) {
+      release.executor->parked = true;
+      _finish(std::move(release));
+    } else {
+      _stop(pid, std::move(release));
+    }
+  }
+
+  void Reaper::_stop(pid_t pid, Release && release)
+  {
+    bool watched;
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      watched = _processes.find(pid) != _processes.end();
+    }
+    kill(pid, release.executor->stop_signal());
+    // SIGKILL follows TERMINATE_TIMEOUT_MS after the stop signal, not after the end of the lease.
+    release.begin = std::chrono::high_resolution_clock::now();
+    if(watched) {
+      _terminating.emplace(pid, std::move(release));
+    } else {
+      int status;
+      waitpid(pid, &status, WUNTRACED);
+      _finish(std::move(release));
+    }
+  }
+
+  void Reaper::_escalate()
+  {
+    auto now = std::chrono::high_resolution_clock::now();
+    for(auto it = _parking.begin(); it != _parking.end();) {
+      Release & release = std::get<0>(it->second);
+      if(now - release.begin < std::chrono::milliseconds(ZygotePool::PARK_TIMEOUT_MS)) {
+        ++it;
+        continue;
+      }
+      spdlog::warn("Executor {} didn't acknowledge the end of its lease, stopping it", it->first);
+      pid_t pid = it->first;
+      Release stopped = std::move(release);
+      epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, std::get<1>(it->second), nullptr);
+      it = _parking.erase(it);
+      _stop(pid, std::move(stopped));
+    }
+
+    for(auto & [pid, release] : _terminating) {
+      if(_killed.count(pid))
+        continue;
+      auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - release.begin).count();
+      if(waited >= TERMINATE_TIMEOUT_MS) {
+        spdlog::warn("Executor {} still runs {} ms after it was stopped, killing it", pid, waited);
+        kill(pid, SIGKILL);
+        _killed.insert(pid);
+      }
+    }
+  }
+
+  void Reaper::_finish(Release && release)
+  {
+    if(release.executor && release.begin.time_since_epoch().count()) {
+      auto end = std::chrono::high_resolution_clock::now();
+      spdlog::info(
+        "Waited for child {} {} us", release.executor->id(),
+        std::chrono::duration_cast<std::chrono::microseconds>(end - release.begin).count()
+      );
+    }
+    // Includes the last invocations, finished after the client disconnected.
+    if(release.executor && release.executor->accounting.valid()) {
+      auto & accounting = release.executor->accounting;
+      release.execution_time = accounting.execution_time();
+      release.hot_polling_time = accounting.hot_polling_time();
+      SPDLOG_DEBUG(
+        "Lease {} executed {} invocations on {} threads",
+        release.lease_id, accounting.invocations(), accounting.threads()
+      );
+    }
+    int cores = release.executor ? release.executor->cores : 0;
+    release.executor.reset();
+
+    // Clients that never received a lease have nothing to return.
+    if(_res_mgr && release.lease_id == rfaas::AllocationRequest::DIRECT_LEASE) {
+      _res_mgr->return_cores(cores);
+    } else if(_res_mgr && release.lease_id >= 0) {
+      _res_mgr->close_lease(
+        release.lease_id,
+        release.allocation_time,
+        release.execution_time,
+        release.hot_polling_time
+      );
+    }
+  }
+
+}
+
@@ -0,0 +1,114 @@
+
+#ifndef __RFAAS_EXECUTOR_MANAGER_REAPER_HPP__
+#define __RFAAS_EXECUTOR_MANAGER_REAPER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "executor_process.hpp"
+#include "common/readerwriterqueue.h"
+
+namespace rfaas::executor_manager {
+
+  struct ResourceManagerConnection;
+  struct ZygotePool;
+
+  // Tracks executor processes with pidfds and tears down leases on a dedicated thread.
+  // Exits are delivered through epoll - nothing polls waitpid in the RDMA threads.
+  // Stopping an executor and reporting the lease to the resource manager never
+  // block the thread processing allocations of other clients.
+  // Executors kept alive between leases are parked in the zygote pool instead of being stopped.
+  struct Reaper
+  {
+    static constexpr int POLLING_TIMEOUT_MS = 100;
+    static constexpr int MAX_EVENTS = 16;
+    // Executors still running this long after SIGTERM are killed.
+    static constexpr int TERMINATE_TIMEOUT_MS = 1000;
+
+    // Lease closed by a client, reported once its executor has exited.
+    struct Release
+    {
+      std::unique_ptr<ActiveExecutor> executor;
+      int32_t lease_id;
+      uint64_t allocation_time;
+      uint64_t execution_time;
+      uint64_t hot_polling_time;
+      std::chrono::high_resolution_clock::time_point begin;
+    };
+
+    Reaper(ZygotePool * zygotes = nullptr);
+    ~Reaper();
+
+    // Called by the launcher once the executor of a client has been started.
+    // A failed launch (-1) is reported as an exit.
+    // A reused executor is already watched, and only changes the client.
+    void watch(uint32_t client, pid_t pid);
+    // Stops the executor and notifies the resource manager; thread-safe.
+    void release(Release && release);
+    // Clients whose executors exited on their own, with the process ID.
+    // Consumed by a single thread.
+    bool exited(uint32_t & client, pid_t & pid);
+    // Readable when new exits are available; reset with acknowledge before calling exited.
+    int fd() const;
+    void acknowledge();
+
+    void run(const std::atomic<bool> & shutdown, ResourceManagerConnection* res_mgr);
+
+  private:
+    // Wakes up the reaper thread.
+    static constexpr uint64_t WAKEUP = 0;
+    // Combined with the PID on the channel of an executor being parked; other entries hold only the PID.
+    static constexpr uint64_t PARKING = 1ull << 32;
+
+    struct Process
+    {
+      uint32_t client;
+      int pidfd;
+    };
+
+    int _epoll_fd;
+    int _wakeup_fd;
+    int _exit_fd;
+    ResourceManagerConnection* _res_mgr;
+    ZygotePool* _zygotes;
+
+    // Written by the launcher, removed by the reaper thread.
+    std::mutex _mutex;
+    std::unordered_map<pid_t, Process> _processes;
+    std::vector<uint32_t> _failed;
+
+    // Serializes client threads releasing leases.
+    std::mutex _release_mutex;
+    moodycamel::ReaderWriterQueue<Release> _releases;
+    moodycamel::ReaderWriterQueue<std::tuple<uint32_t, pid_t>> _exits;
+
+    // Accessed only by the reaper thread.
+    // Kept-alive executors that haven't acknowledged the end of their lease yet, with their channel.
+    std::unordered_map<pid_t, std::tuple<Release, int>> _parking;
+    std::unordered_map<pid_t, Release> _terminating;
+    // Terminating executors that received SIGKILL.
+    std::unordered_set<pid_t> _killed;
+    std::unordered_set<pid_t> _exited;
+
+    void _notify(int fd);
+    void _reap(pid_t pid);
+    void _release(Release && release);
+    void _park(pid_t pid);
+    void _stop(pid_t pid, Release && release);
+    void _escalate();
+    void _finish(Release && release);
+  };
+
+}
+
+#endif
+
@@ -0,0 +1,234 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include <rdmalib/util.hpp>
+
+#include "manager.hpp"
+
+namespace rfaas::executor_manager {
+
+  ResourceManagerConnection::ResourceManagerConnection(const std::string& name, int port, int receive_buf_size):
+    _connection(name, port, receive_buf_size),
+    _receive_buffer(receive_buf_size * RECV_SLOT_SIZE),
+    _send_buffer(std::max({
+      sizeof(common::LeaseDeallocation), sizeof(common::NodeRegistration), sizeof(common::LeaseReport)
+    })),
+    _heartbeat(1),
+    _atomic_result(1),
+    _direct_cores(0),
+    _direct_memory(0),
+    _direct_used(0),
+    _direct_epoch(0)
+  {
+    _connection.allocate();
+    _send_buffer.register_memory(_connection.pd(), IBV_ACCESS_LOCAL_WRITE); 
+    _receive_buffer.register_memory(_connection.pd(), IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE); 
+    _heartbeat.register_memory(_connection.pd(), IBV_ACCESS_LOCAL_WRITE);
+    _atomic_result.register_memory(_connection.pd(), IBV_ACCESS_LOCAL_WRITE);
+    // Armed once the resource manager assigns the slot.
+    _heartbeat_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    rdmalib::impl::expect_nonnegative(_heartbeat_fd);
+  }
+
+  ResourceManagerConnection::~ResourceManagerConnection()
+  {
+    close(_heartbeat_fd);
+  }
+
+  bool ResourceManagerConnection::connect(const std::string& node_name, uint32_t resource_manager_secret)
+  {
+    if(!_connection.connect(resource_manager_secret)) {
+      spdlog::error("Connection to resource manager was not succesful!");
+      return false;
+    }
+
+    _connection.connection().receive_wcs().initialize(_receive_buffer, RECV_SLOT_SIZE * sizeof(common::LeaseAllocation));
+
+    common::NodeRegistration reg;
+    strncpy(reg.node_name, node_name.c_str(), common::NodeRegistration::NODE_NAME_LENGTH);
+    memcpy(_send_buffer.data(), &reg, sizeof(common::NodeRegistration));
+
+    _connection.connection().post_send(_send_buffer, 0);
+    _connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 1);
+
+    return true;
+  }
+
+  void ResourceManagerConnection::open_lease(const common::LeaseAllocation & allocation)
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    common::LeaseReport & report = _open_leases[allocation.lease_id];
+    report.lease_id = allocation.lease_id;
+    report.cores = allocation.cores;
+    report.memory = allocation.memory;
+  }
+
+  void ResourceManagerConnection::forget_lease(int32_t lease_id)
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    _open_leases.erase(lease_id);
+  }
+
+  void ResourceManagerConnection::close_lease(int32_t lease_id, uint64_t allocation_time, uint64_t execution_time, uint64_t hot_polling_time)
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    _open_leases.erase(lease_id);
+    *reinterpret_cast<common::LeaseDeallocation*>(_send_buffer.data()) = {
+      .lease_id = lease_id,
+      .allocation_time = allocation_time,
+      .hot_polling_time = hot_polling_time,
+      .execution_time = execution_time
+    };
+
+    _connection.connection().post_send(_send_buffer, 0);
+    auto [wcs, count] = _connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 1);
+    if(count == 0 || wcs[0].status != IBV_WC_SUCCESS) {
+      spdlog::error("Failed to notify resource manager of lease {} close down.", lease_id);
+    }
+  }
+
+  void ResourceManagerConnection::report_leases()
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    for(auto & [lease_id, report] : _open_leases) {
+      memcpy(_send_buffer.data(), &report, sizeof(common::LeaseReport));
+      _send_message("report lease");
+    }
+    new (_send_buffer.data()) common::NodeSuspended{};
+    _send_message("finish reporting leases");
+    spdlog::info("Reported {} leases to resource manager after suspension", _open_leases.size());
+  }
+
+  void ResourceManagerConnection::start_heartbeats(const common::NodeLiveness & msg)
+  {
+    _liveness_slot = rdmalib::RemoteBuffer{msg.address, msg.rkey, sizeof(common::NodeHeartbeat)};
+    itimerspec period{};
+    period.it_interval.tv_sec = msg.heartbeat_ms / 1000;
+    period.it_interval.tv_nsec = (msg.heartbeat_ms % 1000) * 1000000L;
+    period.it_value = period.it_interval;
+    timerfd_settime(_heartbeat_fd, 0, &period, nullptr);
+  }
+
+  void ResourceManagerConnection::set_capacity_slot(const common::NodeCapacitySlot & msg)
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    _capacity_slot = rdmalib::RemoteBuffer{msg.address, msg.rkey, sizeof(uint64_t)};
+    _direct_cores = msg.cores;
+    _direct_memory = msg.memory;
+    _reset_direct_cores();
+  }
+
+  bool ResourceManagerConnection::claim_direct_lease(int cores, int memory, uint32_t epoch)
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    if(_capacity_slot.rkey == 0 || cores <= 0)
+      return false;
+    // The reset of the counter already returned the cores.
+    if(epoch != _direct_epoch) {
+      spdlog::warn("Direct lease claimed in epoch {}, current epoch is {}", epoch, _direct_epoch);
+      return false;
+    }
+
+    int64_t memory_share = static_cast<int64_t>(_direct_memory) * cores / std::max(_direct_cores, 1);
+    if(_direct_used + cores > _direct_cores || memory > memory_share) {
+      spdlog::warn(
+        "Direct lease of {} cores and {} MB exceeds delegated resources, {} of {} cores in use",
+        cores, memory, _direct_used, _direct_cores
+      );
+      _return_cores(cores);
+      return false;
+    }
+    _direct_used += cores;
+    return true;
+  }
+
+  void ResourceManagerConnection::return_cores(int cores)
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    _direct_used -= cores;
+    _return_cores(cores);
+  }
+
+  void ResourceManagerConnection::expire_direct_cores(int lease_ttl_ms)
+  {
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    if(_capacity_slot.rkey == 0 || lease_ttl_ms <= 0)
+      return;
+    if(std::chrono::steady_clock::now() - _direct_reset < std::chrono::milliseconds(lease_ttl_ms))
+      return;
+    _reset_direct_cores();
+  }
+
+  void ResourceManagerConnection::heartbeat()
+  {
+    uint64_t expirations;
+    if(read(_heartbeat_fd, &expirations, sizeof(expirations)) <= 0)
+      return;
+
+    std::lock_guard<std::mutex> lock{_send_mutex};
+    ++_heartbeat.data()->sequence;
+    _connection.connection().post_write(rdmalib::ScatterGatherElement{_heartbeat}, _liveness_slot);
+    auto [wcs, count] = _connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 1);
+    if(count == 0 || wcs[0].status != IBV_WC_SUCCESS) {
+      spdlog::error("Failed to send heartbeat to resource manager.");
+    }
+  }
+
+  void ResourceManagerConnection::_send_message(const char* operation)
+  {
+    _connection.connection().post_send(_send_buffer, 0);
+    auto [wcs, count] = _connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 1);
+    if(count == 0 || wcs[0].status != IBV_WC_SUCCESS) {
+      spdlog::error("Failed to {} to resource manager.", operation);
+    }
+  }
+
+  bool ResourceManagerConnection::_complete_atomic(const char* operation)
+  {
+    auto [wcs, count] = _connection.connection().poll_wc(rdmalib::QueueType::SEND, true, 1);
+    if(count == 0 || wcs[0].status != IBV_WC_SUCCESS) {
+      spdlog::error("Failed to {} in the capacity table of resource manager.", operation);
+      return false;
+    }
+    return true;
+  }
+
+  void ResourceManagerConnection::_return_cores(int cores)
+  {
+    _connection.connection().post_atomic_fadd(
+      rdmalib::ScatterGatherElement{_atomic_result}, _capacity_slot, cores
+    );
+    _complete_atomic("return cores");
+  }
+
+  void ResourceManagerConnection::_reset_direct_cores()
+  {
+    _direct_reset = std::chrono::steady_clock::now();
+    _connection.connection().post_read(rdmalib::ScatterGatherElement{_atomic_result}, _capacity_slot);
+    if(!_complete_atomic("read the counter"))
+      return;
+
+    uint64_t expected = *_atomic_result.data();
+    while(true) {
+      uint32_t epoch = rfaas::NodeCapacity::epoch(expected) + 1;
+      uint64_t counter = rfaas::NodeCapacity::make_counter(epoch, std::max(_direct_cores - _direct_used, 0));
+      _connection.connection().post_cas(rdmalib::ScatterGatherElement{_atomic_result}, _capacity_slot, expected, counter);
+      if(!_complete_atomic("reset the counter"))
+        return;
+      uint64_t found = *_atomic_result.data();
+      if(found == expected) {
+        _direct_epoch = epoch;
+        SPDLOG_DEBUG("Direct lease counter reset to {} cores in epoch {}", rfaas::NodeCapacity::cores(counter), epoch);
+        return;
+      }
+      expected = found;
+    }
+  }
+
+}
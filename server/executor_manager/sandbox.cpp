@@ -0,0 +1,215 @@
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "sandbox.hpp"
+#include "common/accounting_page.hpp"
+
+namespace rfaas::executor_manager {
+
+  constexpr int Sandbox::STACK_SIZE;
+
+  namespace {
+
+    // Everything is prepared by the parent - the child shares its memory
+    // until exec, and it must not allocate.
+    struct SandboxChild
+    {
+      const char* const* argv;
+      const char* rootfs;
+      std::vector<const char*> sources;
+      std::vector<const char*> targets;
+      int stdin_fd;
+      int log_fd;
+      // Moved to AccountingPage::EXECUTOR_FD.
+      int accounting_fd;
+      // Parent closes its end once the user namespace is mapped.
+      int sync_fd;
+      // Closed on exec; receives errno on failure.
+      int status_fd;
+    };
+
+    int sandbox_child(void* arg)
+    {
+      SandboxChild* child = static_cast<SandboxChild*>(arg);
+      char sync;
+      if(read(child->sync_fd, &sync, 1) < 0)
+        goto failure;
+
+      // Mounts must not propagate to the host.
+      if(mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr))
+        goto failure;
+      if(mount(child->rootfs, child->rootfs, nullptr, MS_BIND | MS_REC, nullptr))
+        goto failure;
+      for(size_t i = 0; i < child->sources.size(); ++i) {
+        if(mount(child->sources[i], child->targets[i], nullptr, MS_BIND | MS_REC, nullptr))
+          goto failure;
+      }
+      if(chdir(child->rootfs) || chroot(".") || chdir("/"))
+        goto failure;
+      // Processes of the new PID namespace only - not required by the executor.
+      mount("proc", "/proc", "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC, nullptr);
+
+      dup2(child->log_fd, 1);
+      dup2(child->log_fd, 2);
+      if(child->stdin_fd != -1)
+        dup2(child->stdin_fd, 0);
+      if(child->accounting_fd == rfaas::common::AccountingPage::EXECUTOR_FD)
+        fcntl(child->accounting_fd, F_SETFD, 0);
+      else if(child->accounting_fd != -1)
+        dup2(child->accounting_fd, rfaas::common::AccountingPage::EXECUTOR_FD);
+      execvp(child->argv[0], const_cast<char**>(child->argv));
+
+    failure:
+      int err = errno;
+      (void)!write(child->status_fd, &err, sizeof(err));
+      _exit(127);
+    }
+
+    bool write_file(const std::string & path, const std::string & data)
+    {
+      std::ofstream out{path};
+      out << data;
+      out.close();
+      if(!out) {
+        spdlog::error("Couldn't write {} to {}", data, path);
+        return false;
+      }
+      return true;
+    }
+
+  }
+
+  Sandbox::Sandbox(const std::string & rootfs, const std::string & cgroup, const std::vector<std::string> & binds):
+    _rootfs(rootfs),
+    _cgroup(rootfs.empty() ? "" : cgroup)
+  {
+    if(!enabled())
+      return;
+
+    for(auto & path : {"/dev/infiniband", "/sys"})
+      _binds.emplace_back(path);
+    for(auto & path : binds)
+      if(!path.empty())
+        _binds.push_back(path);
+
+    if(!_cgroup.empty()) {
+      if(mkdir(_cgroup.c_str(), S_IRWXU) && errno != EEXIST) {
+        spdlog::error("Couldn't create cgroup {}, reason {}, limits disabled", _cgroup, strerror(errno));
+        _cgroup.clear();
+      } else if(!write_file(_cgroup + "/cgroup.subtree_control", "+cpu +memory")) {
+        spdlog::warn("Couldn't enable cpu and memory controllers in {}", _cgroup);
+      }
+    }
+    spdlog::info("Executors run in sandbox with root {}, cgroup {}", _rootfs, _cgroup);
+  }
+
+  bool Sandbox::enabled() const
+  {
+    return !_rootfs.empty();
+  }
+
+  pid_t Sandbox::spawn(const char* const* argv, int stdin_fd, int log_fd, int accounting_fd) const
+  {
+    int sync[2], status[2];
+    if(pipe2(sync, O_CLOEXEC))
+      return -1;
+    if(pipe2(status, O_CLOEXEC)) {
+      close(sync[0]);
+      close(sync[1]);
+      return -1;
+    }
+
+    std::vector<std::string> targets;
+    for(auto & path : _binds)
+      targets.push_back(_rootfs + path);
+    SandboxChild child{argv, _rootfs.c_str(), {}, {}, stdin_fd, log_fd, accounting_fd, sync[0], status[1]};
+    for(size_t i = 0; i < _binds.size(); ++i) {
+      child.sources.push_back(_binds[i].c_str());
+      child.targets.push_back(targets[i].c_str());
+    }
+
+    // Shared memory like vfork, but the parent continues to map the user namespace.
+    char* stack = static_cast<char*>(
+      mmap(nullptr, STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0)
+    );
+    pid_t pid = -1;
+    if(stack != MAP_FAILED) {
+      pid = clone(
+        sandbox_child, stack + STACK_SIZE,
+        CLONE_VM | CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID | SIGCHLD,
+        &child
+      );
+    }
+    if(pid == -1)
+      spdlog::error("Couldn't clone sandboxed executor, reason {}", strerror(errno));
+    close(sync[0]);
+    close(status[1]);
+
+    // Root in the namespace is the manager's user.
+    if(pid != -1) {
+      std::string proc = "/proc/" + std::to_string(pid);
+      write_file(proc + "/uid_map", fmt::format("0 {} 1", getuid()));
+      write_file(proc + "/setgroups", "deny");
+      write_file(proc + "/gid_map", fmt::format("0 {} 1", getgid()));
+    }
+    close(sync[1]);
+
+    int err = 0;
+    if(pid != -1 && read(status[0], &err, sizeof(err)) > 0) {
+      spdlog::error("Sandboxed executor failed, reason {}", strerror(err));
+      waitpid(pid, nullptr, 0);
+      pid = -1;
+    }
+    close(status[0]);
+    if(stack != MAP_FAILED)
+      munmap(stack, STACK_SIZE);
+    return pid;
+  }
+
+  std::string Sandbox::_group(pid_t pid) const
+  {
+    return _cgroup + "/executor_" + std::to_string(pid);
+  }
+
+  bool Sandbox::limit(pid_t pid, int cores, int memory) const
+  {
+    if(_cgroup.empty())
+      return true;
+
+    // Exists already for executors kept alive across leases.
+    std::string group = _group(pid);
+    if(mkdir(group.c_str(), S_IRWXU) && errno != EEXIST) {
+      spdlog::error("Couldn't create cgroup {}, reason {}", group, strerror(errno));
+      return false;
+    }
+    bool ret = write_file(group + "/cpu.max", fmt::format("{} 100000", cores * 100000));
+    if(memory > 0)
+      ret &= write_file(group + "/memory.max", std::to_string(static_cast<int64_t>(memory) * 1024 * 1024));
+    ret &= write_file(group + "/cgroup.procs", std::to_string(pid));
+    return ret;
+  }
+
+  void Sandbox::release(pid_t pid) const
+  {
+    if(_cgroup.empty())
+      return;
+
+    std::string group = _group(pid);
+    if(rmdir(group.c_str()) && errno != ENOENT)
+      spdlog::warn("Couldn't remove cgroup {}, reason {}", group, strerror(errno));
+  }
+
+}
@@ -0,0 +1,46 @@
+
+#ifndef __RFAAS_EXECUTOR_MANAGER_SANDBOX_HPP__
+#define __RFAAS_EXECUTOR_MANAGER_SANDBOX_HPP__
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace rfaas::executor_manager {
+
+  // Executors isolated with user, mount and PID namespaces, without a container runtime.
+  // The process runs in a prepared root filesystem containing the executor binary;
+  // RDMA devices, sysfs and the given directories are bind-mounted into it. The network
+  // namespace is shared with the host, which keeps the RDMA interfaces visible.
+  // Each executor is limited by a cgroup v2 group created under the configured parent group.
+  // The executor is the init of its PID namespace, and only signals it handles are delivered.
+  struct Sandbox
+  {
+    static constexpr int STACK_SIZE = 64 * 1024;
+
+    // Empty rootfs disables the sandbox; empty cgroup disables resource limits.
+    Sandbox(const std::string & rootfs, const std::string & cgroup, const std::vector<std::string> & binds);
+
+    bool enabled() const;
+    // Starts the process in new namespaces, with standard output and error written to log_fd,
+    // and the accounting page at AccountingPage::EXECUTOR_FD. Returns -1 on failure.
+    pid_t spawn(const char* const* argv, int stdin_fd, int log_fd, int accounting_fd = -1) const;
+    // Moves the process to its own group, limited to the cores and memory (MB) of the lease.
+    bool limit(pid_t pid, int cores, int memory) const;
+    // Removes the group after the process has exited.
+    void release(pid_t pid) const;
+
+  private:
+    std::string _rootfs;
+    std::string _cgroup;
+    // Host paths, mounted at the same path inside the root filesystem.
+    std::vector<std::string> _binds;
+
+    std::string _group(pid_t pid) const;
+  };
+
+}
+
+#endif
+
@@ -19,13 +19,37 @@ namespace rfaas::executor_manager {
     int recv_buffer_size;
     int max_inline_data;
     bool pin_threads;
+    // Physical cores reserved for manager threads when pinning is enabled.
+    int manager_cores;
+    // Per-thread scratch memory of executors, in bytes.
+    size_t arena_size;
+    bool arena_malloc;
+    // Executor threads accept connections from other executors.
+    bool peer_transfers;
+    // Executor processes started ahead of leases; zero disables the pool.
+    int zygotes;
+    // Claim or start a zygote when the resource manager grants a lease.
+    bool speculative_spawn;
+    // Idle executors wait this long for a lease of the same library; zero disables reuse.
+    int keep_alive_ms;
+    // Root filesystem of sandboxed executors; empty disables the sandbox.
+    std::string sandbox_rootfs;
+    // Parent cgroup v2 group of sandboxed executors; empty disables limits.
+    std::string sandbox_cgroup;
+    // Directory for cached functions libraries; empty disables caching.
+    std::string library_cache;
 
     template <class Archive>
     void load(Archive & ar )
     {
       ar(
         CEREAL_NVP(use_docker), CEREAL_NVP(repetitions),
-        CEREAL_NVP(warmup_iters), CEREAL_NVP(pin_threads)
+        CEREAL_NVP(warmup_iters), CEREAL_NVP(pin_threads),
+        CEREAL_NVP(manager_cores), CEREAL_NVP(arena_size),
+        CEREAL_NVP(arena_malloc), CEREAL_NVP(peer_transfers),
+        CEREAL_NVP(zygotes), CEREAL_NVP(speculative_spawn),
+        CEREAL_NVP(keep_alive_ms), CEREAL_NVP(sandbox_rootfs),
+        CEREAL_NVP(sandbox_cgroup), CEREAL_NVP(library_cache)
       );
     }
   };
@@ -39,6 +63,12 @@ namespace rfaas::executor_manager {
     rfaas::device_data* device;
     std::string node_name;
     bool rdma_sleep;
+    // Polling continues for this time after the last event, then the thread blocks.
+    int rdma_spin_us;
+    // One thread handles clients and the resource manager, or each gets its own.
+    int rdma_threads;
+    // Threads processing allocation requests of clients; zero processes them on the polling thread.
+    int client_workers;
 
     // resource manager connection
     std::string resource_manager_address;
@@ -54,6 +84,9 @@ namespace rfaas::executor_manager {
       ar(
         CEREAL_NVP(rdma_device), CEREAL_NVP(rdma_device_port),
         CEREAL_NVP(node_name), cereal::make_nvp("rdma-sleep", rdma_sleep),
+        cereal::make_nvp("rdma-spin-us", rdma_spin_us),
+        cereal::make_nvp("rdma-threads", rdma_threads),
+        cereal::make_nvp("client-workers", client_workers),
         CEREAL_NVP(resource_manager_address), CEREAL_NVP(resource_manager_port),
         CEREAL_NVP(resource_manager_secret)
       );
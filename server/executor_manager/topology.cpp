@@ -0,0 +1,278 @@
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <dirent.h>
+#include <sched.h>
+
+#include <spdlog/spdlog.h>
+
+#include <rdmalib/util.hpp>
+
+#include "topology.hpp"
+
+namespace rfaas::executor_manager {
+
+  namespace {
+
+    // Parses sysfs CPU lists, e.g. "0-3,8,10-11".
+    std::vector<int> parse_cpu_list(const std::string & list)
+    {
+      std::vector<int> result;
+      std::stringstream ss{list};
+      std::string range;
+      while(std::getline(ss, range, ',')) {
+        if(range.empty() || range == "\n")
+          continue;
+        auto pos = range.find('-');
+        int begin = std::stoi(range.substr(0, pos));
+        int end = pos == std::string::npos ? begin : std::stoi(range.substr(pos + 1));
+        for(int i = begin; i <= end; ++i)
+          result.push_back(i);
+      }
+      return result;
+    }
+
+    bool read_file(const std::string & path, std::string & out)
+    {
+      std::ifstream in{path};
+      if(!in.is_open())
+        return false;
+      std::getline(in, out);
+      return true;
+    }
+
+    int read_int(const std::string & path, int default_value)
+    {
+      std::string value;
+      if(!read_file(path, value) || value.empty())
+        return default_value;
+      return std::stoi(value);
+    }
+
+  }
+
+  Topology Topology::discover(const std::string & rdma_device)
+  {
+    Topology topology;
+    const std::string cpu_dir = "/sys/devices/system/cpu/";
+    const std::string node_dir = "/sys/devices/system/node/";
+
+    std::string online;
+    if(!read_file(cpu_dir + "online", online)) {
+      spdlog::error("Couldn't read CPU topology from sysfs!");
+      return topology;
+    }
+
+    std::map<int, int> numa_nodes;
+    if(DIR* dir = opendir(node_dir.c_str())) {
+      while(dirent* entry = readdir(dir)) {
+        int node;
+        if(sscanf(entry->d_name, "node%d", &node) != 1)
+          continue;
+        std::string cpus;
+        if(read_file(node_dir + entry->d_name + "/cpulist", cpus))
+          for(int cpu : parse_cpu_list(cpus))
+            numa_nodes[cpu] = node;
+      }
+      closedir(dir);
+    }
+
+    for(int cpu : parse_cpu_list(online)) {
+      std::string topo = cpu_dir + "cpu" + std::to_string(cpu) + "/topology/";
+      auto it = numa_nodes.find(cpu);
+      topology.cpus.push_back({
+        cpu,
+        read_int(topo + "core_id", cpu),
+        read_int(topo + "physical_package_id", 0),
+        it != numa_nodes.end() ? it->second : 0
+      });
+    }
+
+    // Accept both the verbs device and the network interface name.
+    topology.nic_numa_node = read_int("/sys/class/infiniband/" + rdma_device + "/device/numa_node", -1);
+    if(topology.nic_numa_node == -1)
+      topology.nic_numa_node = read_int("/sys/class/net/" + rdma_device + "/device/numa_node", -1);
+
+    spdlog::info(
+      "Discovered {} hardware threads, device {} is on NUMA node {}",
+      topology.cpus.size(), rdma_device, topology.nic_numa_node
+    );
+    return topology;
+  }
+
+  CoreSet::CoreSet():
+    _allocator(nullptr)
+  {}
+
+  CoreSet::CoreSet(CoreAllocator* allocator, std::vector<int> && cpus):
+    _allocator(allocator),
+    _cpus(std::move(cpus))
+  {}
+
+  CoreSet::CoreSet(CoreSet && obj):
+    _allocator(obj._allocator),
+    _cpus(std::move(obj._cpus))
+  {
+    obj._allocator = nullptr;
+    obj._cpus.clear();
+  }
+
+  CoreSet& CoreSet::operator=(CoreSet && obj)
+  {
+    if(this != &obj) {
+      if(_allocator)
+        _allocator->_release(_cpus);
+      _allocator = obj._allocator;
+      _cpus = std::move(obj._cpus);
+      obj._allocator = nullptr;
+      obj._cpus.clear();
+    }
+    return *this;
+  }
+
+  CoreSet::~CoreSet()
+  {
+    if(_allocator)
+      _allocator->_release(_cpus);
+  }
+
+  bool CoreSet::empty() const
+  {
+    return _cpus.empty();
+  }
+
+  const std::vector<int> & CoreSet::cpus() const
+  {
+    return _cpus;
+  }
+
+  std::string CoreSet::str() const
+  {
+    std::string result;
+    for(size_t i = 0; i < _cpus.size(); ++i) {
+      if(i)
+        result += ',';
+      result += std::to_string(_cpus[i]);
+    }
+    return result;
+  }
+
+  CoreAllocator::CoreAllocator(const Topology & topology, int reserved_cores)
+  {
+    // The first hardware thread of each physical core, and its SMT siblings.
+    std::vector<CPU> siblings;
+    auto same_core = [](const CPU & a, const CPU & b) { return a.core == b.core && a.package == b.package; };
+    for(const CPU & cpu : topology.cpus) {
+      auto it = std::find_if(_cores.begin(), _cores.end(), [&](const CPU & c) { return same_core(c, cpu); });
+      if(it == _cores.end())
+        _cores.push_back(cpu);
+      else
+        siblings.push_back(cpu);
+    }
+
+    int nic_node = topology.nic_numa_node;
+    auto by_distance = [nic_node](const CPU & a, const CPU & b) {
+      bool a_local = a.numa_node == nic_node, b_local = b.numa_node == nic_node;
+      if(a_local != b_local)
+        return a_local;
+      return a.numa_node < b.numa_node;
+    };
+    std::stable_sort(_cores.begin(), _cores.end(), by_distance);
+    std::stable_sort(siblings.begin(), siblings.end(), by_distance);
+    _free.resize(_cores.size(), true);
+
+    // Manager threads poll the device too - keep them on NIC-local cores, with their siblings.
+    // Leave at least one core for executors.
+    int physical_cores = _cores.size();
+    int reserved = 0;
+    for(; reserved < reserved_cores && reserved + 1 < physical_cores; ++reserved) {
+      _free[reserved] = false;
+      _reserved.push_back(_cores[reserved].id);
+    }
+    for(const CPU & cpu : siblings) {
+      auto end = _cores.begin() + reserved;
+      if(std::find_if(_cores.begin(), end, [&](const CPU & c) { return same_core(c, cpu); }) != end) {
+        _reserved.push_back(cpu.id);
+      } else {
+        _cores.push_back(cpu);
+        _free.push_back(true);
+      }
+    }
+    spdlog::info(
+      "Executors can use {} hardware threads on {} physical cores, {} cores reserved for the manager",
+      _cores.size() - reserved, physical_cores - reserved, reserved
+    );
+  }
+
+  CoreSet CoreAllocator::allocate(int cores)
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::vector<int> positions;
+
+    // Prefer placing all threads on a single NUMA node, in the order of preference.
+    // A node's cores are in both the physical and the sibling range - physical cores are taken first.
+    std::vector<int> nodes;
+    for(const CPU & cpu : _cores)
+      if(std::find(nodes.begin(), nodes.end(), cpu.numa_node) == nodes.end())
+        nodes.push_back(cpu.numa_node);
+    for(size_t node = 0; node < nodes.size() && static_cast<int>(positions.size()) < cores; ++node) {
+      positions.clear();
+      for(size_t i = 0; i < _cores.size() && static_cast<int>(positions.size()) < cores; ++i)
+        if(_free[i] && _cores[i].numa_node == nodes[node])
+          positions.push_back(i);
+    }
+
+    // Spread across NUMA nodes.
+    if(static_cast<int>(positions.size()) < cores) {
+      positions.clear();
+      for(size_t i = 0; i < _cores.size() && static_cast<int>(positions.size()) < cores; ++i)
+        if(_free[i])
+          positions.push_back(i);
+    }
+
+    if(static_cast<int>(positions.size()) < cores) {
+      SPDLOG_DEBUG("Not enough free cores for {} threads", cores);
+      return CoreSet{};
+    }
+
+    std::vector<int> cpus;
+    for(size_t pos : positions) {
+      _free[pos] = false;
+      cpus.push_back(_cores[pos].id);
+    }
+    return CoreSet{this, std::move(cpus)};
+  }
+
+  void CoreAllocator::_release(const std::vector<int> & cpus)
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    for(int cpu : cpus) {
+      auto it = std::find_if(_cores.begin(), _cores.end(), [cpu](const CPU & c) { return c.id == cpu; });
+      if(it != _cores.end())
+        _free[std::distance(_cores.begin(), it)] = true;
+    }
+  }
+
+  void CoreAllocator::pin_manager_thread(pthread_t thread) const
+  {
+    if(_reserved.empty())
+      return;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for(int cpu : _reserved)
+      CPU_SET(cpu, &cpuset);
+    rdmalib::impl::expect_zero(pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset));
+  }
+
+  int CoreAllocator::free_cores() const
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    return std::count(_free.begin(), _free.end(), true);
+  }
+
+}
+
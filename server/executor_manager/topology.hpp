@@ -0,0 +1,83 @@
+
+#ifndef __RFAAS_EXECUTOR_MANAGER_TOPOLOGY_HPP__
+#define __RFAAS_EXECUTOR_MANAGER_TOPOLOGY_HPP__
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace rfaas::executor_manager {
+
+  // Hardware thread as seen in sysfs.
+  struct CPU
+  {
+    int id;
+    // Physical core ID - unique only within a package.
+    int core;
+    int package;
+    int numa_node;
+  };
+
+  struct Topology
+  {
+    std::vector<CPU> cpus;
+    // NUMA node of the RDMA device; -1 when unknown.
+    int nic_numa_node;
+
+    static Topology discover(const std::string & rdma_device);
+  };
+
+  struct CoreAllocator;
+
+  // Cores assigned to a single executor; returned to the allocator on destruction.
+  struct CoreSet
+  {
+    CoreSet();
+    CoreSet(CoreAllocator* allocator, std::vector<int> && cpus);
+    CoreSet(CoreSet &&);
+    CoreSet& operator=(CoreSet &&);
+    ~CoreSet();
+
+    bool empty() const;
+    const std::vector<int> & cpus() const;
+    // Comma-separated list, as expected by the executor.
+    std::string str() const;
+
+  private:
+    CoreAllocator* _allocator;
+    std::vector<int> _cpus;
+  };
+
+  // Hands out disjoint sets of hardware threads to executors.
+  // Each hardware thread counts as a core, but SMT siblings are handed out only
+  // once all physical cores are taken - hot-polling threads share a physical core last.
+  // Cores local to the RDMA device are preferred, and a number of physical cores,
+  // with their siblings, is reserved for the manager's own threads.
+  struct CoreAllocator
+  {
+    CoreAllocator(const Topology & topology, int reserved_cores);
+
+    // Returns an empty set when not enough cores are free.
+    CoreSet allocate(int cores);
+    // Restrict thread to the reserved cores; no-op when no cores are reserved.
+    void pin_manager_thread(pthread_t thread) const;
+    int free_cores() const;
+
+  private:
+    friend struct CoreSet;
+    void _release(const std::vector<int> & cpus);
+
+    mutable std::mutex _mutex;
+    // First hardware thread of each physical core, then SMT siblings; both grouped
+    // by NUMA node, with nodes ordered by distance to the device: NIC-local first.
+    std::vector<CPU> _cores;
+    std::vector<bool> _free;
+    std::vector<int> _reserved;
+  };
+
+}
+
+#endif
+
@@ -0,0 +1,328 @@
+
+#include <cerrno>
+#include <cstring>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "executor_process.hpp"
+#include "sandbox.hpp"
+#include "zygote_pool.hpp"
+
+namespace rfaas::executor_manager {
+
+  constexpr int ZygotePool::RESERVATION_TIMEOUT_MS;
+  constexpr int ZygotePool::PARK_TIMEOUT_MS;
+
+  ZygotePool::ZygotePool(int size, const std::string & device_address, const Sandbox * sandbox, int keep_alive_ms):
+    _size(size),
+    _device_address(device_address),
+    _sandbox(sandbox),
+    _keep_alive_ms(keep_alive_ms)
+  {
+    _zygotes.reserve(size);
+  }
+
+  ZygotePool::~ZygotePool()
+  {
+    // Zygotes exit when the channel is closed without arguments.
+    for(auto & zygote : _zygotes)
+      _stop(zygote);
+    for(auto & [lease, reservation] : _reserved)
+      _stop(reservation.zygote);
+    // Executors still bound to a lease are stopped like any other executor.
+    for(auto & [pid, executor] : _alive) {
+      if(executor.zygote.fd != -1)
+        close(executor.zygote.fd);
+      if(executor.parked)
+        waitpid(pid, nullptr, 0);
+    }
+  }
+
+  void ZygotePool::_stop(Zygote & zygote)
+  {
+    close(zygote.fd);
+    waitpid(zygote.pid, nullptr, 0);
+  }
+
+  void ZygotePool::fill()
+  {
+    _expire();
+    Zygote zygote;
+    while(_zygotes.size() < static_cast<size_t>(_size)) {
+      if(!_start(zygote))
+        break;
+      _zygotes.push_back(zygote);
+    }
+  }
+
+  void ZygotePool::_expire()
+  {
+    auto now = std::chrono::steady_clock::now();
+    for(auto it = _reserved.begin(); it != _reserved.end();) {
+      if(now - it->second.since < std::chrono::milliseconds(RESERVATION_TIMEOUT_MS)) {
+        ++it;
+        continue;
+      }
+      SPDLOG_DEBUG("Reservation of zygote {} for lease {} expired", it->second.zygote.pid, it->first);
+      _return(it->second.zygote);
+      it = _reserved.erase(it);
+    }
+  }
+
+  void ZygotePool::_return(Zygote & zygote)
+  {
+    if(_zygotes.size() < static_cast<size_t>(_size))
+      _zygotes.push_back(zygote);
+    else
+      _stop(zygote);
+  }
+
+  bool ZygotePool::reserve(int lease_id)
+  {
+    _expire();
+    if(_reserved.find(lease_id) != _reserved.end())
+      return true;
+
+    Zygote zygote;
+    if(!_zygotes.empty()) {
+      zygote = _zygotes.back();
+      _zygotes.pop_back();
+    } else if(!_start(zygote)) {
+      return false;
+    }
+    _reserved.emplace(lease_id, Reservation{zygote, std::chrono::steady_clock::now()});
+    SPDLOG_DEBUG("Zygote {} reserved for lease {}", zygote.pid, lease_id);
+    return true;
+  }
+
+  bool ZygotePool::_start(Zygote & zygote)
+  {
+    // Close-on-exec prevents other zygotes from inheriting our end.
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds)) {
+      spdlog::error("Couldn't create zygote channel, reason {}", strerror(errno));
+      return false;
+    }
+
+    const char * argv[] = {
+      "executor", "--zygote", _device_address.c_str(), nullptr
+    };
+    pid_t pid = spawn_process(argv, fds[1], _sandbox);
+    if(pid == -1) {
+      close(fds[0]);
+      close(fds[1]);
+      return false;
+    }
+
+    close(fds[1]);
+    zygote = {pid, fds[0]};
+    SPDLOG_DEBUG("Started zygote with PID {}", pid);
+    return true;
+  }
+
+  // The descriptor is attached to the first byte of the arguments.
+  static ssize_t send_with_fd(int socket, const std::string & data, int fd)
+  {
+    iovec iov{const_cast<char*>(data.data()), data.size()};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(socket, &msg, MSG_NOSIGNAL);
+  }
+
+  // Fails when the process closed its end of the channel.
+  static bool send_arguments(pid_t pid, int fd, const std::string & data, int accounting_fd)
+  {
+    for(size_t pos = 0; pos < data.size();) {
+      ssize_t len = pos == 0 && accounting_fd != -1 ?
+        send_with_fd(fd, data, accounting_fd) :
+        send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+      if(len < 0 && errno != EINTR) {
+        spdlog::warn("Couldn't send arguments to executor {}, reason {}", pid, strerror(errno));
+        return false;
+      }
+      if(len > 0)
+        pos += len;
+    }
+    return true;
+  }
+
+  bool ZygotePool::_send(Zygote & zygote, const std::string & data, bool keep_open, int accounting_fd)
+  {
+    // Zygote failed to initialize.
+    if(waitpid(zygote.pid, nullptr, WNOHANG) != 0) {
+      spdlog::warn("Zygote {} is not running anymore", zygote.pid);
+      close(zygote.fd);
+      return false;
+    }
+
+    bool sent = send_arguments(zygote.pid, zygote.fd, data, accounting_fd);
+    if(!sent || !keep_open)
+      close(zygote.fd);
+
+    if(!sent) {
+      kill(zygote.pid, SIGKILL);
+      waitpid(zygote.pid, nullptr, 0);
+    }
+    return sent;
+  }
+
+  pid_t ZygotePool::launch(const std::vector<std::string> & args, int lease_id, uint64_t keep_alive, int accounting_fd)
+  {
+    // Arguments are prefixed with their size.
+    std::string data(sizeof(uint32_t), '\0');
+    for(auto & arg : args)
+      data.append(arg.c_str(), arg.size() + 1);
+    uint32_t size = data.size() - sizeof(uint32_t);
+    memcpy(data.data(), &size, sizeof(size));
+
+    if(keep_alive) {
+      pid_t pid = _reuse(keep_alive, data, accounting_fd);
+      if(pid != -1) {
+        // Another lease can take the zygote now instead of starting a new one.
+        auto it = _reserved.find(lease_id);
+        if(it != _reserved.end()) {
+          _return(it->second.zygote);
+          _reserved.erase(it);
+        }
+        return pid;
+      }
+    }
+
+    auto it = _reserved.find(lease_id);
+    if(it != _reserved.end()) {
+      Zygote zygote = it->second.zygote;
+      _reserved.erase(it);
+      if(_send(zygote, data, keep_alive, accounting_fd)) {
+        SPDLOG_DEBUG("Lease {} uses its reserved zygote {}", lease_id, zygote.pid);
+        return _launched(zygote, keep_alive);
+      }
+    }
+
+    while(!_zygotes.empty()) {
+
+      Zygote zygote = _zygotes.back();
+      _zygotes.pop_back();
+      if(_send(zygote, data, keep_alive, accounting_fd))
+        return _launched(zygote, keep_alive);
+    }
+
+    // Only zygotes can be kept alive - start one instead of a regular process.
+    Zygote zygote;
+    if(keep_alive && _start(zygote) && _send(zygote, data, true, accounting_fd))
+      return _launched(zygote, keep_alive);
+    return -1;
+  }
+
+  pid_t ZygotePool::_launched(const Zygote & zygote, uint64_t keep_alive)
+  {
+    if(keep_alive) {
+      std::lock_guard<std::mutex> lock{_mutex};
+      _alive[zygote.pid] = KeptAlive{zygote, keep_alive, false, {}};
+    }
+    return zygote.pid;
+  }
+
+  pid_t ZygotePool::_reuse(uint64_t hash, const std::string & data, int accounting_fd)
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    for(auto & [pid, executor] : _alive) {
+
+      if(!executor.parked || executor.hash != hash || executor.zygote.fd == -1)
+        continue;
+
+      // The executor exited or is exiting - the reaper collects it, and forgets the entry.
+      if(!send_arguments(pid, executor.zygote.fd, data, accounting_fd)) {
+        close(executor.zygote.fd);
+        executor.zygote.fd = -1;
+        continue;
+      }
+      executor.parked = false;
+      spdlog::info("Executor {} reused for library {:x}", executor.zygote.pid, hash);
+      return executor.zygote.pid;
+    }
+    return -1;
+  }
+
+  int ZygotePool::channel(pid_t pid)
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    auto it = _alive.find(pid);
+    return it != _alive.end() ? it->second.zygote.fd : -1;
+  }
+
+  // The executor writes a single byte after its threads stopped.
+  static bool read_acknowledgement(int fd)
+  {
+    char ack;
+    ssize_t len;
+    do {
+      len = read(fd, &ack, sizeof(ack));
+    } while(len < 0 && errno == EINTR);
+    return len == sizeof(ack);
+  }
+
+  bool ZygotePool::park(pid_t pid)
+  {
+    // Not parked yet - the launcher doesn't reuse it while the reaper waits, and only
+    // the reaper thread closes the channel.
+    std::lock_guard<std::mutex> lock{_mutex};
+    auto it = _alive.find(pid);
+    if(it == _alive.end() || it->second.zygote.fd == -1 || !read_acknowledgement(it->second.zygote.fd)) {
+      spdlog::warn("Executor {} didn't acknowledge the end of its lease", pid);
+      return false;
+    }
+    it->second.parked = true;
+    it->second.since = std::chrono::steady_clock::now();
+    SPDLOG_DEBUG("Executor {} parked with library {:x}", pid, it->second.hash);
+    return true;
+  }
+
+  bool ZygotePool::forget(pid_t pid)
+  {
+    bool parked;
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      auto it = _alive.find(pid);
+      if(it == _alive.end())
+        return false;
+      if(it->second.zygote.fd != -1)
+        close(it->second.zygote.fd);
+      parked = it->second.parked;
+      _alive.erase(it);
+    }
+    // Cgroups of executors bound to a lease are removed with the lease.
+    if(parked && _sandbox)
+      _sandbox->release(pid);
+    return parked;
+  }
+
+  void ZygotePool::expire_parked()
+  {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock{_mutex};
+    for(auto & [pid, executor] : _alive) {
+      if(!executor.parked || executor.zygote.fd == -1)
+        continue;
+      if(now - executor.since < std::chrono::milliseconds(_keep_alive_ms))
+        continue;
+      SPDLOG_DEBUG("Parked executor {} expired", pid);
+      close(executor.zygote.fd);
+      executor.zygote.fd = -1;
+    }
+  }
+
+}
@@ -0,0 +1,109 @@
+
+#ifndef __RFAAS_EXECUTOR_MANAGER_ZYGOTE_POOL_HPP__
+#define __RFAAS_EXECUTOR_MANAGER_ZYGOTE_POOL_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace rfaas::executor_manager {
+
+  struct Sandbox;
+
+  // Executor processes started before leases arrive.
+  // Each zygote initializes the RDMA runtime for the device, and waits for
+  // the executor arguments on a control socket. A lease only sends them
+  // instead of paying for process start and initialization.
+  // Used only by the launcher thread once the manager runs, except for
+  // executors kept alive between leases, which are parked by the reaper.
+  struct ZygotePool
+  {
+    // Reserved zygotes of leases without a client request return to the pool.
+    static constexpr int RESERVATION_TIMEOUT_MS = 10000;
+    // Executors that don't acknowledge the end of their lease are stopped.
+    static constexpr int PARK_TIMEOUT_MS = 1000;
+
+    // Zygotes are started in the sandbox when it's enabled.
+    // Parked executors are stopped after keep_alive_ms without a new lease.
+    ZygotePool(int size, const std::string & device_address, const Sandbox * sandbox = nullptr, int keep_alive_ms = 0);
+    ~ZygotePool();
+
+    // Starts zygotes until the pool is full.
+    void fill();
+    // Claims a zygote for a lease granted by the resource manager, before its client
+    // connects. A new zygote is started for the lease when the pool is empty.
+    bool reserve(int lease_id);
+    // Returns the PID of the zygote executing with the arguments,
+    // or -1 when there's no zygote available.
+    // The zygote reserved for the lease is preferred.
+    // With a nonzero library hash, the executor stays alive after the lease and
+    // an executor parked with the same hash is reused before any zygote.
+    // The accounting page of the lease is passed with the arguments.
+    pid_t launch(
+      const std::vector<std::string> & args, int lease_id = -1,
+      uint64_t keep_alive = 0, int accounting_fd = -1
+    );
+
+    // Thread-safe; called by the reaper.
+    // Channel of an executor kept alive after its lease, or -1.
+    // It becomes readable once the executor acknowledges the end of the lease.
+    int channel(pid_t pid);
+    // Marks the executor as idle once its channel is readable.
+    // False when it's not kept alive, or closed the channel without acknowledging.
+    bool park(pid_t pid);
+    // Called after the executor exited; true when it was parked and the exit is expected.
+    bool forget(pid_t pid);
+    // Stops executors parked for longer than the keep-alive window.
+    void expire_parked();
+
+  private:
+    struct Zygote
+    {
+      pid_t pid;
+      int fd;
+    };
+
+    struct Reservation
+    {
+      Zygote zygote;
+      std::chrono::steady_clock::time_point since;
+    };
+
+    // The channel stays open for the arguments of the next lease.
+    // Expired executors have their channel closed, and exit on their own.
+    struct KeptAlive
+    {
+      Zygote zygote;
+      uint64_t hash;
+      bool parked;
+      std::chrono::steady_clock::time_point since;
+    };
+
+    int _size;
+    std::string _device_address;
+    const Sandbox * _sandbox;
+    std::vector<Zygote> _zygotes;
+    std::unordered_map<int, Reservation> _reserved;
+    int _keep_alive_ms;
+    std::mutex _mutex;
+    std::unordered_map<pid_t, KeptAlive> _alive;
+
+    bool _start(Zygote & zygote);
+    bool _send(Zygote & zygote, const std::string & data, bool keep_open = false, int accounting_fd = -1);
+    pid_t _reuse(uint64_t hash, const std::string & data, int accounting_fd);
+    pid_t _launched(const Zygote & zygote, uint64_t keep_alive);
+    // Back to the pool, or stopped when the pool is full.
+    void _return(Zygote & zygote);
+    void _stop(Zygote & zygote);
+    void _expire();
+  };
+
+}
+
+#endif
+
@@ -0,0 +1,182 @@
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+#include "capacity_index.hpp"
+
+namespace rfaas::resource_manager {
+
+  constexpr int CapacityIndex::CORE_BUCKETS;
+
+  int CapacityIndex::_bucket(int cores)
+  {
+    return std::min(cores, CORE_BUCKETS - 1);
+  }
+
+  void CapacityIndex::insert(const std::shared_ptr<Executor> & node)
+  {
+    if(!node)
+      return;
+    std::lock_guard<std::mutex> lock{node->_capacity_mutex};
+    if(node->_bucket != -1)
+      _detach(*node);
+    _attach(node);
+  }
+
+  std::shared_ptr<Executor> CapacityIndex::lease(Lease & lease, Order order, const filter_t & filter)
+  {
+    int first = _bucket(lease.cores);
+    for(int i = first; i < CORE_BUCKETS; ++i) {
+
+      int b = order == Order::BEST_FIT ? i : CORE_BUCKETS - 1 - (i - first);
+      if(!_buckets[b].size.load(std::memory_order_relaxed))
+        continue;
+
+      while(auto node = _candidate(b, lease, order, filter)) {
+
+        std::lock_guard<std::mutex> lock{node->_capacity_mutex};
+        // Another thread leased or released it after we found it - search again.
+        if(node->_bucket == -1)
+          continue;
+        if(_lease(node, lease))
+          return node;
+      }
+    }
+    SPDLOG_DEBUG("No executor with {} cores and {} memory available!", lease.cores, lease.memory);
+    return nullptr;
+  }
+
+  bool CapacityIndex::lease(const std::shared_ptr<Executor> & node, Lease & lease)
+  {
+    std::lock_guard<std::mutex> lock{node->_capacity_mutex};
+    // Fully leased nodes are not indexed.
+    if(node->_bucket == -1 || !node->is_initialized())
+      return false;
+    return _lease(node, lease);
+  }
+
+  bool CapacityIndex::restore(const std::shared_ptr<Executor> & node, Lease & lease)
+  {
+    std::lock_guard<std::mutex> lock{node->_capacity_mutex};
+    if(node->_bucket != -1)
+      _detach(*node);
+    bool leased = node->lease(lease);
+    _attach(node);
+    if(leased)
+      lease.node = node;
+    return leased;
+  }
+
+  void CapacityIndex::release(const std::shared_ptr<Executor> & node, const Lease & lease)
+  {
+    std::lock_guard<std::mutex> lock{node->_capacity_mutex};
+    if(node->_bucket != -1)
+      _detach(*node);
+    node->cancel_lease(lease);
+    _attach(node);
+  }
+
+  void CapacityIndex::suspend(const std::shared_ptr<Executor> & node)
+  {
+    std::lock_guard<std::mutex> lock{node->_capacity_mutex};
+    if(node->_bucket != -1)
+      _detach(*node);
+    node->_suspended = true;
+  }
+
+  void CapacityIndex::resume(const std::shared_ptr<Executor> & node)
+  {
+    std::lock_guard<std::mutex> lock{node->_capacity_mutex};
+    node->_suspended = false;
+    if(node->_bucket == -1)
+      _attach(node);
+  }
+
+  int CapacityIndex::max_free_cores() const
+  {
+    for(int b = CORE_BUCKETS - 1; b > 0; --b)
+      if(_buckets[b].size.load(std::memory_order_relaxed))
+        return b;
+    return 0;
+  }
+
+  bool CapacityIndex::_lease(const std::shared_ptr<Executor> & node, Lease & lease)
+  {
+    _detach(*node);
+    bool leased = node->lease(lease);
+    _attach(node);
+    if(leased)
+      lease.node = node;
+    return leased;
+  }
+
+  bool CapacityIndex::_fits(const Executor & node, const Lease & lease, const filter_t & filter)
+  {
+    // The last bucket holds nodes with different numbers of cores.
+    return node.is_initialized() && node._free_cores >= lease.cores && (!filter || filter(node));
+  }
+
+  std::shared_ptr<Executor> CapacityIndex::_candidate(int bucket, const Lease & lease, Order order, const filter_t & filter)
+  {
+    Bucket & b = _buckets[bucket];
+    std::lock_guard<std::mutex> lock{b.mutex};
+
+    // Resources of indexed nodes don't change while we hold the bucket lock.
+    // Removed nodes are dropped lazily.
+    auto drop = [&b](Executor::capacity_bucket_t::iterator pos) {
+      b.size.fetch_sub(1, std::memory_order_relaxed);
+      return b.nodes.erase(pos);
+    };
+
+    std::shared_ptr<Executor> node;
+    if(order == Order::BEST_FIT) {
+      auto it = b.nodes.lower_bound(lease.memory);
+      while(!node && it != b.nodes.end()) {
+        node = (*it).second.lock();
+        it = node ? std::next(it) : drop(it);
+        if(node && !_fits(*node, lease, filter))
+          node.reset();
+      }
+    } else {
+      auto it = b.nodes.end();
+      while(!node && it != b.nodes.begin() && (*std::prev(it)).first >= lease.memory) {
+        auto pos = std::prev(it);
+        node = (*pos).second.lock();
+        // Erasing an entry doesn't invalidate iterators to the others.
+        if(node)
+          it = pos;
+        else
+          drop(pos);
+        if(node && !_fits(*node, lease, filter))
+          node.reset();
+      }
+    }
+    return node;
+  }
+
+  void CapacityIndex::_attach(const std::shared_ptr<Executor> & node)
+  {
+    if(node->is_fully_leased() || node->_suspended) {
+      node->_bucket = -1;
+      return;
+    }
+
+    int bucket = _bucket(node->_free_cores);
+    Bucket & b = _buckets[bucket];
+    std::lock_guard<std::mutex> lock{b.mutex};
+    node->_bucket_pos = b.nodes.emplace(node->_free_memory, node);
+    node->_bucket = bucket;
+    b.size.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void CapacityIndex::_detach(Executor & node)
+  {
+    Bucket & b = _buckets[node._bucket];
+    std::lock_guard<std::mutex> lock{b.mutex};
+    b.nodes.erase(node._bucket_pos);
+    node._bucket = -1;
+    b.size.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+}
@@ -0,0 +1,77 @@
+
+#ifndef __RFAAS_RESOURCE_MANAGER_CAPACITY_INDEX_HPP__
+#define __RFAAS_RESOURCE_MANAGER_CAPACITY_INDEX_HPP__
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "executor.hpp"
+
+namespace rfaas { namespace resource_manager {
+
+  // Nodes with free resources, bucketed by the number of free cores.
+  // Each bucket orders its nodes by free memory, and a lease searches buckets
+  // in the order requested by the placement policy.
+  // Buckets and nodes are locked separately - leases on different nodes proceed concurrently.
+  // A node is removed from its bucket while its resources change, and candidates
+  // found in a bucket are verified again under the node's lock.
+  struct CapacityIndex
+  {
+    // Nodes with more free cores share the last bucket.
+    static constexpr int CORE_BUCKETS = 257;
+
+    enum class Order
+    {
+      // Fewest free cores, then least free memory.
+      BEST_FIT = 0,
+      // Most free cores, then most free memory.
+      WORST_FIT
+    };
+
+    // Called with the bucket lock held - resources of the node don't change.
+    typedef std::function<bool(const Executor &)> filter_t;
+
+    // Indexes the node with its current free resources; fully leased nodes are not indexed.
+    void insert(const std::shared_ptr<Executor> & node);
+    // Returns the node with resources of the lease already taken, nullptr when no node fits.
+    std::shared_ptr<Executor> lease(Lease & lease, Order order = Order::BEST_FIT, const filter_t & filter = nullptr);
+    // Leases on the given node only.
+    bool lease(const std::shared_ptr<Executor> & node, Lease & lease);
+    // Takes resources of a recovered lease; the node doesn't have to be connected yet.
+    bool restore(const std::shared_ptr<Executor> & node, Lease & lease);
+    // Returns resources of a closed lease and indexes the node again.
+    void release(const std::shared_ptr<Executor> & node, const Lease & lease);
+    // Removes the node from the index until it resumes; releases only return its resources.
+    void suspend(const std::shared_ptr<Executor> & node);
+    void resume(const std::shared_ptr<Executor> & node);
+    // Lower bound on the most free cores of a single node, without taking locks.
+    int max_free_cores() const;
+
+  private:
+    struct Bucket
+    {
+      std::mutex mutex;
+      Executor::capacity_bucket_t nodes;
+      // Lets the search skip empty buckets without taking their locks.
+      std::atomic<int> size{0};
+    };
+
+    std::array<Bucket, CORE_BUCKETS> _buckets;
+
+    static int _bucket(int cores);
+    std::shared_ptr<Executor> _candidate(int bucket, const Lease & lease, Order order, const filter_t & filter);
+    bool _fits(const Executor & node, const Lease & lease, const filter_t & filter);
+    // Called with the lock of the node held.
+    bool _lease(const std::shared_ptr<Executor> & node, Lease & lease);
+    void _attach(const std::shared_ptr<Executor> & node);
+    void _detach(Executor & node);
+  };
+
+}}
+
+#endif
+
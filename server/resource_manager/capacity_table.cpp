@@ -0,0 +1,80 @@
+
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+#include "capacity_table.hpp"
+
+namespace rfaas::resource_manager {
+
+  constexpr int CapacityTable::MAX_NODES;
+
+  CapacityTable::CapacityTable(ibv_pd* pd):
+    _slots(MAX_NODES),
+    _used(0)
+  {
+    memset(_slots.data(), 0, _slots.data_size());
+    _slots.register_memory(
+      pd, IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_ATOMIC
+    );
+  }
+
+  bool CapacityTable::attach(const std::shared_ptr<Executor> & node)
+  {
+    int slot = node->_capacity_slot;
+    if(slot == -1) {
+      // Slots are appended - the table read by clients stays short.
+      auto it = _node_slots.find(node->node);
+      if(it != _node_slots.end()) {
+        slot = it->second;
+      } else if(_used.load() < MAX_NODES) {
+        slot = _used.load();
+        _node_slots.emplace(node->node, slot);
+        // The counter of a new slot stays zero until the executor manager publishes its cores.
+        _used.store(slot + 1);
+      } else {
+        spdlog::error("Capacity table is full, node {} doesn't accept direct leases", node->node);
+        return false;
+      }
+      node->_capacity_slot = slot;
+    }
+
+    // The counter is reset by the executor manager with RDMA atomics when it receives the slot.
+    rfaas::NodeCapacity & entry = _slots[slot];
+    entry.port = node->port;
+    strncpy(entry.address, node->address.c_str(), sizeof(entry.address) - 1);
+    entry.available = 1;
+    return true;
+  }
+
+  void CapacityTable::detach(Executor & node)
+  {
+    if(node._capacity_slot == -1)
+      return;
+    // Stays reserved for the node; clients skip it until the node registers again.
+    _slots[node._capacity_slot].available = 0;
+    node._capacity_slot = -1;
+  }
+
+  void CapacityTable::set_available(const Executor & node, bool available)
+  {
+    if(node._capacity_slot != -1)
+      _slots[node._capacity_slot].available = available;
+  }
+
+  rdmalib::RemoteBuffer CapacityTable::remote(const Executor & node) const
+  {
+    return rdmalib::RemoteBuffer{
+      _slots.address() + node._capacity_slot * sizeof(rfaas::NodeCapacity),
+      _slots.rkey(),
+      sizeof(uint64_t)
+    };
+  }
+
+  rfaas::CapacityTableResponse CapacityTable::info() const
+  {
+    return rfaas::CapacityTableResponse{_slots.address(), _slots.rkey(), _used.load()};
+  }
+
+}
+
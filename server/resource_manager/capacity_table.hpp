@@ -0,0 +1,50 @@
+
+#ifndef __RFAAS_RESOURCE_MANAGER_CAPACITY_TABLE_HPP__
+#define __RFAAS_RESOURCE_MANAGER_CAPACITY_TABLE_HPP__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <rdmalib/buffer.hpp>
+
+#include <rfaas/allocation.hpp>
+
+#include "executor.hpp"
+
+namespace rfaas::resource_manager {
+
+  // Cores delegated by registered nodes, exposed to clients for one-sided leases.
+  // Clients take cores with RDMA compare-and-swap on the counter of a node, and
+  // executor managers return them with RDMA fetch-and-add - we only publish the slot
+  // when the node registers, and mark it unavailable when the node goes silent.
+  // Slots are changed only by the thread handling executor managers.
+  // A slot belongs to one node name forever - clients keep old copies of the table, and
+  // a reused slot would let them take cores of one node and connect to another. We never
+  // write the counter after the slot is created, as CPU stores race with NIC atomics.
+  struct CapacityTable
+  {
+    static constexpr int MAX_NODES = 1024;
+
+    CapacityTable(ibv_pd* pd);
+
+    // Returns false when the table is full; a node registering again gets its old slot.
+    bool attach(const std::shared_ptr<Executor> & node);
+    void detach(Executor & node);
+    void set_available(const Executor & node, bool available);
+    rdmalib::RemoteBuffer remote(const Executor & node) const;
+    // Location sent to clients; safe to call from any thread.
+    rfaas::CapacityTableResponse info() const;
+
+  private:
+    rdmalib::Buffer<rfaas::NodeCapacity> _slots;
+    std::unordered_map<std::string, int> _node_slots;
+    // Clients read the slots up to the highest one ever used.
+    std::atomic<int> _used;
+  };
+
+}
+
+#endif
+
@@ -54,6 +54,11 @@ int main(int argc, char ** argv)
   rfaas::resource_manager::Manager mgr(settings);
   instance = &mgr;
 
+  // Nodes of the input database are added to the recovered ones.
+  if(opts.state_directory != "" && !mgr.open_state(opts.state_directory)) {
+    spdlog::error("Couldn't open the state directory {}", opts.state_directory);
+    return 1;
+  }
   if(opts.initial_database != "") {
     mgr.read_database(opts.initial_database);
   }
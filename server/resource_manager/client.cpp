@@ -15,16 +15,17 @@ namespace rfaas::resource_manager {
   Client::Client(int client_id, rdmalib::Connection* conn, ibv_pd* pd):
     connection(conn),
     _response(1),
-    allocation_requests(RECV_BUF_SIZE),
+    allocation_requests(RECV_BUF_SIZE * RECV_SLOT_SIZE),
     allocation_time(0),
-    client_id(client_id)
+    client_id(client_id),
+    charge(0)
   {
     // Make the buffer accessible to clients
     allocation_requests.register_memory(pd, IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
     _response.register_memory(pd, IBV_ACCESS_LOCAL_WRITE);
 
     // Initialize batch receive WCs
-    connection->receive_wcs().initialize(allocation_requests);
+    connection->receive_wcs().initialize(allocation_requests, RECV_SLOT_SIZE * sizeof(rfaas::LeaseRequest));
   }
 
   Client::~Client()
@@ -58,6 +59,7 @@ namespace rfaas::resource_manager {
     obj.allocation_time = 0;
     this->client_id = obj.client_id;
     obj.client_id = 0;
+    this->charge = obj.charge;
 
     this->_cur_allocation_start = obj._cur_allocation_start;
   }
@@ -67,6 +69,16 @@ namespace rfaas::resource_manager {
     return _response;
   }
 
+  rfaas::LeaseBatchResponse& Client::batch_response()
+  {
+    return *reinterpret_cast<rfaas::LeaseBatchResponse*>(_response.data());
+  }
+
+  rfaas::LeaseRequest* Client::requests(uint64_t slot)
+  {
+    return &allocation_requests.data()[slot * RECV_SLOT_SIZE];
+  }
+
   void Client::disable()
   {
     rdma_disconnect(connection->id());
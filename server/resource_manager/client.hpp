@@ -21,11 +21,15 @@ namespace rfaas::resource_manager {
   struct Client
   {
     static constexpr int RECV_BUF_SIZE = 32;
+    // Each receive slot fits a full batch of requests.
+    static constexpr int RECV_SLOT_SIZE = rfaas::LeaseRequest::MAX_BATCH;
     rdmalib::Connection* connection;
     rdmalib::Buffer<rfaas::LeaseResponse> _response;
     rdmalib::Buffer<rfaas::LeaseRequest> allocation_requests;
     uint32_t allocation_time;
     int client_id;
+    // Cores received divided by the weight of requests, for fair share of waiting requests.
+    double charge;
     std::chrono::high_resolution_clock::time_point _cur_allocation_start;
 
     Client(int client_id, rdmalib::Connection* conn, ibv_pd* pd);
@@ -34,6 +38,10 @@ namespace rfaas::resource_manager {
     Client& operator=(Client&&);
 
     rdmalib::Buffer<rfaas::LeaseResponse>& response();
+    // Shares the buffer with the single response.
+    rfaas::LeaseBatchResponse& batch_response();
+    // Requests of the message received in the slot, batches have more than one.
+    rfaas::LeaseRequest* requests(uint64_t slot);
     void begin_allocation();
     void end_allocation();
     void reload_queue();
@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <fstream>
 
 #include <optional>
@@ -14,7 +15,7 @@
 
 namespace rfaas { namespace resource_manager {
 
-  ExecutorDB::ResultCode ExecutorDB::add(const std::string & node_name, const std::string & ip_address, int port, int cores, int memory)
+  ExecutorDB::ResultCode ExecutorDB::add(const std::string & node_name, const std::string & ip_address, int port, int cores, int memory, int sockets)
   {
     if(node_name.length() < rfaas::server_data::NODE_NAME_LENGTH) {
       return ResultCode::MALFORMED_DATA;
@@ -23,13 +24,19 @@ namespace rfaas { namespace resource_manager {
     // Obtain write access
     writer_lock_t lock(_mutex);
 
-    auto [ptr, success] = _executors.add_executor(node_name, ip_address, port, cores, memory);
+    auto [ptr, success] = _executors.add_executor(node_name, ip_address, port, cores, memory, sockets);
 
     if(!success) {
       return ResultCode::EXECUTOR_EXISTS;
     }
 
-    _free_nodes.push_back(ptr);
+    auto node = ptr.lock();
+    if(!node) {
+      return ResultCode::EXECUTOR_EXISTS;
+    }
+    _free_nodes.insert(node);
+    _journal_append(JournalRecord::node_added(*node));
+    _released.fetch_add(1, std::memory_order_release);
 
     spdlog::debug("Adding new executor {} with {}:{} address and {} cores", node_name, ip_address, port, cores);
     return ResultCode::OK;
@@ -40,93 +47,262 @@ namespace rfaas { namespace resource_manager {
     // Obtain write access
     writer_lock_t lock(_mutex);
     bool erased = _executors.remove_executor(node_name);
+    if(erased)
+      _journal_append(JournalRecord::node_removed(node_name));
     return erased ? ResultCode::OK : ResultCode::EXECUTOR_DOESNT_EXIST;
   }
 
-  std::shared_ptr<Executor> ExecutorDB::open_lease(int numcores, int memory, rfaas::LeaseResponse& lease)
+  std::vector<std::shared_ptr<Executor>> ExecutorDB::open_lease(
+    int numcores, int memory, uint64_t func_hash, int max_nodes, rfaas::LeaseResponse& lease
+  )
   {
-    // Obtain write access
-    writer_lock_t lock(_mutex);
+    std::vector<std::tuple<Lease, std::shared_ptr<Executor>>> parts;
+    Lease node_lease{numcores, memory};
+    if(auto node = _placement->place(node_lease, func_hash)) {
+      parts.emplace_back(std::move(node_lease), std::move(node));
+    } else if(max_nodes > 1) {
+      max_nodes = std::min(max_nodes, rfaas::LeaseResponse::MAX_NODES_PER_LEASE);
+      _split(numcores, memory, func_hash, max_nodes, parts);
+    }
 
-    if(!_free_nodes.size()) {
+    if(parts.empty()) {
       SPDLOG_DEBUG("No available executors!");
-      return nullptr;
+      return {};
     }
 
-    std::weak_ptr<Executor> used_node;
+    std::vector<std::shared_ptr<Executor>> nodes;
+    std::lock_guard<std::mutex> lock{_leases_mutex};
+    for(size_t i = 0; i < parts.size(); ++i) {
+
+      auto & [part, node] = parts[i];
+      rfaas::LeasedNode & leased = lease.nodes[i];
+      leased.lease_id = _lease_count.fetch_add(1, std::memory_order_relaxed);
+      leased.port = node->port;
+      leased.cores = part.cores;
+      leased.memory = part.memory;
+      strncpy(leased.address, node->address.c_str(), Executor::ADDRESS_LENGTH);
+
+      _journal_append(JournalRecord::lease_opened(leased.lease_id, *node, part.cores, part.memory));
+      _leases.emplace(leased.lease_id, std::move(part));
+      nodes.push_back(std::move(node));
+    }
 
-    auto it = _free_nodes.begin();
-    while(it != _free_nodes.end()) {
+    lease.lease_id = lease.nodes[0].lease_id;
+    lease.port = lease.nodes[0].port;
+    strncpy(lease.address, lease.nodes[0].address, Executor::ADDRESS_LENGTH);
+    if(nodes.size() > 1)
+      spdlog::info("Lease of {} cores is split across {} nodes", numcores, nodes.size());
 
-      std::weak_ptr<Executor>& ptr = *it;
-      auto shared_ptr = ptr.lock();
+    return nodes;
+  }
 
-      // Verify the node has not been removed
-      if(!shared_ptr) {
-        _free_nodes.erase(it++);
-        SPDLOG_DEBUG("Node cannot be used, no longer valid!");
-        continue;
+  bool ExecutorDB::_split(int numcores, int memory, uint64_t func_hash, int max_nodes,
+      std::vector<std::tuple<Lease, std::shared_ptr<Executor>>> & parts)
+  {
+    int remaining = numcores;
+    while(remaining > 0 && static_cast<int>(parts.size()) < max_nodes) {
+
+      // Largest parts first - concurrent leases can take the capacity, and we try smaller parts then.
+      int part_cores = std::min(remaining, _free_nodes.max_free_cores());
+      std::shared_ptr<Executor> node;
+      while(part_cores > 0) {
+        // Memory is split proportionally to cores.
+        int part_memory = (static_cast<int64_t>(memory) * part_cores + numcores - 1) / numcores;
+        Lease part{part_cores, part_memory};
+        node = _placement->place(part, func_hash);
+        if(node) {
+          parts.emplace_back(std::move(part), node);
+          break;
+        }
+        part_cores /= 2;
       }
 
-      // Can't use an executor that has not been used yet
-      if(!shared_ptr->is_initialized()) {
-        ++it;
-        SPDLOG_DEBUG("Node {} cannot be used, not initialized!", shared_ptr->node);
-        continue;
-      }
+      if(!node)
+        break;
+      remaining -= part_cores;
+    }
 
-      if(!shared_ptr->lease(numcores, memory)) {
-        ++it;
-        SPDLOG_DEBUG("Node {} cannot be used, not enough resources!", shared_ptr->node);
-        continue;
-      }
+    if(remaining > 0) {
+      SPDLOG_DEBUG("Lease of {} cores doesn't fit on {} nodes", numcores, max_nodes);
+      for(auto & [part, node] : parts)
+        _free_nodes.release(node, part);
+      parts.clear();
+      return false;
+    }
+    return true;
+  }
 
-      lease.lease_id = _lease_count++;
-      lease.port = shared_ptr->port;
-      strncpy(lease.address, shared_ptr->address.c_str(), Executor::ADDRESS_LENGTH);
+  void ExecutorDB::close_lease(common::LeaseDeallocation & msg)
+  {
+    if(cancel_lease(msg.lease_id)) {
+      SPDLOG_DEBUG("Cancelled lease {}, allocation took {} us.", msg.lease_id, msg.allocation_time);
+    }
+  }
 
-      bool is_total = shared_ptr->is_fully_leased();
-      if(is_total) {
-        _free_nodes.erase(it);
+  std::shared_ptr<Executor> ExecutorDB::cancel_lease(int32_t lease_id)
+  {
+    std::optional<Lease> lease;
+    {
+      std::lock_guard<std::mutex> lock{_leases_mutex};
+      auto it = _leases.find(lease_id);
+      if(it == _leases.end()) {
+        spdlog::warn("Ignoring non-existing lease {}", lease_id);
+        return nullptr;
       }
+      lease.emplace(std::move((*it).second));
+      _leases.erase(it);
+    }
+    _journal_append(JournalRecord::lease_closed(lease_id));
 
-      _leases.emplace(
-        std::piecewise_construct,
-        std::forward_as_tuple(lease.lease_id),
-        std::forward_as_tuple(numcores, memory, is_total, std::move(ptr))
-      );
+    auto shared_ptr = lease->node.lock();
+    if(!shared_ptr) {
+      return nullptr;
+    }
 
-      return shared_ptr;
+    _free_nodes.release(shared_ptr, *lease);
+    _released.fetch_add(1, std::memory_order_release);
+    return shared_ptr;
+  }
 
+  int ExecutorDB::reclaim(const std::shared_ptr<Executor> & node)
+  {
+    // Suspended first - released resources don't make the node available.
+    _free_nodes.suspend(node);
+
+    std::vector<Lease> leases;
+    {
+      std::lock_guard<std::mutex> lock{_leases_mutex};
+      for(auto it = _leases.begin(); it != _leases.end();) {
+        if((*it).second.node.lock() == node) {
+          SPDLOG_DEBUG("Reclaiming lease {} of node {}", (*it).first, node->node);
+          _journal_append(JournalRecord::lease_closed((*it).first));
+          leases.push_back(std::move((*it).second));
+          it = _leases.erase(it);
+        } else {
+          ++it;
+        }
+      }
     }
 
-    return nullptr;
+    for(const Lease & lease : leases)
+      _free_nodes.release(node, lease);
+    return leases.size();
   }
 
-  void ExecutorDB::close_lease(common::LeaseDeallocation & msg)
+  void ExecutorDB::restore_lease(const std::shared_ptr<Executor> & node, const common::LeaseReport & report)
   {
-    writer_lock_t lock(_mutex);
+    std::lock_guard<std::mutex> lock{_leases_mutex};
+    // Reported again when the node was suspended twice before it replied.
+    if(_leases.find(report.lease_id) != _leases.end())
+      return;
 
-    auto it = _leases.find(msg.lease_id);
-    if(it == _leases.end()) {
-      spdlog::warn("Ignoring non-existing lease {}", msg.lease_id);
+    Lease lease{report.cores, report.memory};
+    if(!_free_nodes.restore(node, lease)) {
+      spdlog::error("Couldn't restore lease {} of node {}", report.lease_id, node->node);
       return;
     }
+    SPDLOG_DEBUG("Restored lease {} of node {}", report.lease_id, node->node);
+    _journal_append(JournalRecord::lease_opened(report.lease_id, *node, lease.cores, lease.memory));
+    _leases.emplace(report.lease_id, std::move(lease));
+  }
 
-    auto ptr = (*it).second.node;
-    auto shared_ptr = ptr.lock();
-    if(!shared_ptr) {
-      return;
+  void ExecutorDB::resume(const std::shared_ptr<Executor> & node)
+  {
+    _free_nodes.resume(node);
+    _released.fetch_add(1, std::memory_order_release);
+  }
+
+  int ExecutorDB::delegate(const std::shared_ptr<Executor> & node, int cores)
+  {
+    revoke(node);
+
+    // Memory is delegated in proportion to the cores.
+    int delegated = std::min<int>(cores, node->cores);
+    Lease lease{delegated, node->cores > 0 ? static_cast<int>(static_cast<int64_t>(node->memory) * delegated / node->cores) : 0};
+    if(lease.cores <= 0 || !_free_nodes.lease(node, lease)) {
+      spdlog::warn("Couldn't delegate {} cores of node {} to direct leases", lease.cores, node->node);
+      return 0;
+    }
+    node->_delegated = std::move(lease);
+    return node->_delegated.cores;
+  }
+
+  void ExecutorDB::revoke(const std::shared_ptr<Executor> & node)
+  {
+    if(node->_delegated.cores > 0) {
+      _free_nodes.release(node, node->_delegated);
+      node->_delegated = Lease{0, 0};
+      _released.fetch_add(1, std::memory_order_release);
     }
+  }
 
-    SPDLOG_DEBUG("Cancelled lease {}, allocation took {} us.", msg.lease_id, msg.allocation_time);
+  uint64_t ExecutorDB::released() const
+  {
+    return _released.load(std::memory_order_acquire);
+  }
 
-    shared_ptr->cancel_lease((*it).second);
+  bool ExecutorDB::recover(StateJournal & journal)
+  {
+    {
+      writer_lock_t lock{_mutex};
+      if(!journal.recover([this](const JournalRecord & record) { _recover(record); }))
+        return false;
+      // New leases continue after all IDs ever handed out.
+      if(static_cast<uint32_t>(journal.next_lease_id()) > _lease_count.load())
+        _lease_count.store(journal.next_lease_id());
+    }
+    _journal = &journal;
+    return true;
+  }
 
-    if((*it).second.total) {
-      _free_nodes.push_back(ptr);
+  void ExecutorDB::_recover(const JournalRecord & record)
+  {
+    switch(record.type)
+    {
+      case JournalRecord::Type::NODE_ADD: {
+        auto [weak_ptr, success] = _executors.add_executor(
+          record.node, record.address, record.port, record.cores, record.memory, record.sockets
+        );
+        auto node = weak_ptr.lock();
+        if(success && node)
+          _free_nodes.insert(node);
+      } break;
+      case JournalRecord::Type::NODE_REMOVE:
+        _executors.remove_executor(record.node);
+      break;
+      case JournalRecord::Type::LEASE_OPEN: {
+        auto node = _executors.get_executor(record.node);
+        if(!node)
+          break;
+        // Nodes are not connected yet - the lease is taken without placement.
+        Lease lease{record.cores, record.memory};
+        if(!_free_nodes.restore(node, lease)) {
+          spdlog::warn("Lease {} doesn't fit on node {} anymore", record.lease_id, record.node);
+          break;
+        }
+        std::lock_guard<std::mutex> lock{_leases_mutex};
+        _leases.emplace(record.lease_id, std::move(lease));
+      } break;
+      case JournalRecord::Type::LEASE_CLOSE: {
+        std::optional<Lease> lease;
+        {
+          std::lock_guard<std::mutex> lock{_leases_mutex};
+          auto it = _leases.find(record.lease_id);
+          if(it == _leases.end())
+            break;
+          lease.emplace(std::move((*it).second));
+          _leases.erase(it);
+        }
+        if(auto node = lease->node.lock())
+          _free_nodes.release(node, *lease);
+      } break;
     }
+  }
 
+  void ExecutorDB::_journal_append(JournalRecord && record)
+  {
+    if(_journal)
+      _journal->append(std::move(record));
   }
 
   ExecutorDB::reader_lock_t ExecutorDB::read_lock()
@@ -147,10 +323,14 @@ namespace rfaas { namespace resource_manager {
 
     for(const auto & instance : servers._data) {
 
-      auto [weak_ptr, success] = _executors.add_executor(instance.node, instance.address, instance.port, instance.cores, instance.memory);
+      auto [weak_ptr, success] = _executors.add_executor(
+        instance.node, instance.address, instance.port, instance.cores, instance.memory, instance.sockets
+      );
 
-      if(success) {
-        _free_nodes.push_back(weak_ptr);
+      auto node = weak_ptr.lock();
+      if(success && node) {
+        _free_nodes.insert(node);
+        _journal_append(JournalRecord::node_added(*node));
       } else {
         spdlog::debug("Ignoring duplicate node: {}", instance.node);
       }
@@ -164,7 +344,9 @@ namespace rfaas { namespace resource_manager {
     rfaas::servers servers;
 
     for(const auto & [key, instance] : _executors) {
-      servers._data.emplace_back(instance->node, instance->address, instance->port, instance->cores, instance->memory);
+      servers._data.emplace_back(
+        instance->node, instance->address, instance->port, instance->cores, instance->memory, instance->sockets
+      );
     }
 
     std::ofstream out{path};
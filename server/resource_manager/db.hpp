@@ -2,7 +2,7 @@
 #ifndef __RFAAS_RESOURCE_MANAGER_DB_HPP__
 #define __RFAAS_RESOURCE_MANAGER_DB_HPP__
 
-#include <list>
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -10,13 +10,17 @@
 #include <shared_mutex>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include <rfaas/allocation.hpp>
 #include <rfaas/resources.hpp>
 
 #include <rdmalib/buffer.hpp>
 
+#include "capacity_index.hpp"
 #include "executor.hpp"
+#include "journal.hpp"
+#include "placement.hpp"
 
 namespace rfaas { namespace resource_manager {
 
@@ -33,12 +37,26 @@ namespace rfaas { namespace resource_manager {
   
     Executors& _executors;
 
+    std::mutex _leases_mutex;
     std::unordered_map<uint32_t, Lease> _leases;
-    uint32_t _lease_count;
+    std::atomic<uint32_t> _lease_count;
+    // Advanced whenever resources become available, for waiting lease requests.
+    std::atomic<uint64_t> _released;
 
-    std::list<std::weak_ptr<Executor>> _free_nodes;
+    // Leases don't take the reader-writer lock, only locks of the index and the chosen node.
+    CapacityIndex _free_nodes;
+    std::unique_ptr<PlacementPolicy> _placement;
+    // Receives all changes of nodes and leases; nullptr when state is not persisted.
+    StateJournal* _journal;
 
-    // Reader-writer lock
+    void _journal_append(JournalRecord && record);
+    void _recover(const JournalRecord & record);
+
+    // Places parts of a lease that doesn't fit on a single node; releases them on failure.
+    bool _split(int numcores, int memory, uint64_t func_hash, int max_nodes,
+        std::vector<std::tuple<Lease, std::shared_ptr<Executor>>> & parts);
+
+    // Reader-writer lock of the executors
     std::shared_mutex _mutex;
 
   public:
@@ -50,22 +68,47 @@ namespace rfaas { namespace resource_manager {
       MALFORMED_DATA = 3
     };
 
-    ExecutorDB(Executors& executors):
+    ExecutorDB(Executors& executors, const std::string & placement_policy):
       _executors(executors),
-      _lease_count(0)
+      _lease_count(0),
+      _released(0),
+      _placement(PlacementPolicy::create(placement_policy, _free_nodes)),
+      _journal(nullptr)
     {}
 
-    ResultCode add(const std::string& node_name, const std::string & ip_address, int port, int cores, int memory);
+    ResultCode add(const std::string& node_name, const std::string & ip_address, int port, int cores, int memory, int sockets = 1);
     ResultCode remove(const std::string& node_name);
 
-    std::shared_ptr<Executor> open_lease(int numcores, int memory, rfaas::LeaseResponse& lease);
+    // The library hash is used by the placement policy; zero when unknown.
+    // Leases that don't fit on a single node are split across up to max_nodes nodes,
+    // and each node receives its own lease ID. Returns the nodes in the order of the response.
+    std::vector<std::shared_ptr<Executor>> open_lease(
+      int numcores, int memory, uint64_t func_hash, int max_nodes, rfaas::LeaseResponse& lease
+    );
 
     void close_lease(common::LeaseDeallocation & msg);
-
-    void reclaim(const std::string& node_name, int numcores, int memory);
+    // Releases the lease without its executor manager; returns the node, nullptr when the lease doesn't exist.
+    std::shared_ptr<Executor> cancel_lease(int32_t lease_id);
+
+    // Returns all leases of a node whose executor manager stopped sending heartbeats,
+    // and stops placing leases on it. Returns the number of reclaimed leases.
+    int reclaim(const std::shared_ptr<Executor> & node);
+    // Lease reclaimed while the node was suspended, and reported by its executor manager as held.
+    void restore_lease(const std::shared_ptr<Executor> & node, const common::LeaseReport & report);
+    // Places leases on the node again once its executor manager reported its leases.
+    void resume(const std::shared_ptr<Executor> & node);
+    // Takes up to cores from the node for direct leases of clients, returns the number taken.
+    // Cores delegated before are returned first; memory is delegated in proportion to the cores.
+    int delegate(const std::shared_ptr<Executor> & node, int cores);
+    void revoke(const std::shared_ptr<Executor> & node);
+    // Changes when leases are closed or nodes are added; waiting requests are retried then.
+    uint64_t released() const;
 
     reader_lock_t read_lock();
 
+    // Restores nodes and leases, and records later changes in the journal.
+    bool recover(StateJournal & journal);
+
     void read(const std::string &);
     void write(const std::string &);
   };
@@ -1,6 +1,7 @@
 
 #include "executor.hpp"
 #include "rdmalib/connection.hpp"
+#include <algorithm>
 #include <utility>
 
 namespace rfaas::resource_manager {
@@ -9,29 +10,45 @@ namespace rfaas::resource_manager {
     _connection(nullptr),
     _free_cores(0),
     _free_memory(0),
+    _bucket(-1),
+    _suspended(false),
+    _liveness_slot(-1),
+    _capacity_slot(-1),
+    _delegated(0, 0),
     _receive_buffer(RECV_BUF_SIZE * MSG_SIZE),
-    _send_buffer(1)
+    _send_buffer(common::LeaseAllocation::MAX_BATCH)
   {}
 
-  Executor::Executor(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory):
+  Executor::Executor(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets):
     _connection(nullptr),
     _free_cores(0),
     _free_memory(0),
+    _bucket(-1),
+    _suspended(false),
+    _liveness_slot(-1),
+    _capacity_slot(-1),
+    _delegated(0, 0),
     _receive_buffer(RECV_BUF_SIZE * MSG_SIZE),
-    _send_buffer(1)
+    _send_buffer(common::LeaseAllocation::MAX_BATCH)
   {
-    this->initialize_data(node_name, ip, port, cores, memory);
+    this->initialize_data(node_name, ip, port, cores, memory, sockets);
   }
 
-  void Executor::initialize_data(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory)
+  void Executor::initialize_data(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets)
   {
     this->node = node_name;
     this->address = ip;
     this->port = port;
     this->cores = cores;
     this->memory = memory;
+    this->sockets = std::max<int16_t>(sockets, 1);
     this->_free_cores = cores;
     this->_free_memory = memory;
+
+    // The first sockets receive the remaining cores.
+    _free_socket_cores.assign(this->sockets, cores / this->sockets);
+    for(int i = 0; i < cores % this->sockets; ++i)
+      _free_socket_cores[i] += 1;
   }
 
   //void Executor::initialize_connection(rdmalib::Connection* conn)
@@ -46,32 +63,69 @@ namespace rfaas::resource_manager {
     return !node.empty() && _connection != nullptr;
   }
 
-  bool Executor::lease(int cores, int memory)
+  bool Executor::lease(Lease & lease)
   {
     // Not enough memory? skip
-    if(_free_memory < memory) {
+    if(_free_memory < lease.memory) {
       return false;
     }
 
-    if(_free_cores < cores) {
+    if(_free_cores < lease.cores) {
       return false;
     }
 
-    _free_cores -= cores;
-    _free_memory -= memory;
+    _free_cores -= lease.cores;
+    _free_memory -= lease.memory;
+
+    // The socket with the fewest free cores that fits the lease.
+    lease.sockets.assign(_free_socket_cores.size(), 0);
+    if(_free_socket_cores.empty())
+      return true;
+    int best = -1;
+    for(size_t i = 0; i < _free_socket_cores.size(); ++i) {
+      if(_free_socket_cores[i] >= lease.cores && (best == -1 || _free_socket_cores[i] < _free_socket_cores[best]))
+        best = i;
+    }
+    if(best != -1) {
+      _free_socket_cores[best] -= lease.cores;
+      lease.sockets[best] = lease.cores;
+      return true;
+    }
+
+    // Otherwise, spread over the sockets with most free cores.
+    int remaining = lease.cores;
+    while(remaining > 0) {
+      auto it = std::max_element(_free_socket_cores.begin(), _free_socket_cores.end());
+      int taken = std::min(*it, remaining);
+      *it -= taken;
+      lease.sockets[it - _free_socket_cores.begin()] += taken;
+      remaining -= taken;
+    }
 
     return true;
   }
 
+  int Executor::free_socket_cores() const
+  {
+    return _free_socket_cores.empty() ? 0 : *std::max_element(_free_socket_cores.begin(), _free_socket_cores.end());
+  }
+
   bool Executor::is_fully_leased() const
   {
     return _free_cores == 0 || _free_memory == 0;
   }
 
+  bool Executor::has_leases() const
+  {
+    return _free_cores < cores || _free_memory < memory;
+  }
+
   void Executor::cancel_lease(const Lease & lease)
   {
     _free_cores += lease.cores;
     _free_memory += lease.memory;
+    for(size_t i = 0; i < lease.sockets.size() && i < _free_socket_cores.size(); ++i)
+      _free_socket_cores[i] += lease.sockets[i];
   }
 
   Executors::Executors(ibv_pd* pd):
@@ -89,19 +143,22 @@ namespace rfaas::resource_manager {
     this->_connection->receive_wcs().initialize(_receive_buffer, MSG_SIZE);
   }
 
-  std::tuple<std::weak_ptr<Executor>, bool> Executors::add_executor(const std::string& name, const std::string & ip, int32_t port, int16_t cores, int32_t memory)
+  std::tuple<std::weak_ptr<Executor>, bool> Executors::add_executor(
+    const std::string& name, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets
+  )
   {
-    auto exec = std::make_shared<Executor>(name, ip, port, cores, memory);
+    auto exec = std::make_shared<Executor>(name, ip, port, cores, memory, sockets);
     auto [it, success] = _executors_by_name.insert(std::make_pair(name, exec));
 
     // Two possibilities: executor already exists or has been registered?
     if(!success) {
 
-      if((*it).second->is_initialized()) {
+      // Don't reset the resources of leases recovered for this node.
+      if((*it).second->is_initialized() || (*it).second->has_leases()) {
         return std::make_tuple(std::weak_ptr<Executor>{}, false);
       } else {
-        (*it).second->initialize_data(name, ip, port, cores, memory);
-        return std::make_tuple(exec, true);
+        (*it).second->initialize_data(name, ip, port, cores, memory, sockets);
+        return std::make_tuple((*it).second, true);
       }
 
     }
@@ -5,6 +5,8 @@
 #include <atomic>
 #include <cstdint>
 #include <chrono>
+#include <map>
+#include <mutex>
 
 #include <rdmalib/connection.hpp>
 #include <rdmalib/rdmalib.hpp>
@@ -13,6 +15,7 @@
 #include <rfaas/allocation.hpp>
 #include <rfaas/resources.hpp>
 #include <unordered_map>
+#include <vector>
 
 #include "../common/messages.hpp"
 
@@ -24,14 +27,13 @@ namespace rfaas { namespace resource_manager {
   {
     int cores;
     int memory;
-    bool total;
     std::weak_ptr<Executor> node;
+    // Cores taken from each socket of the node.
+    std::vector<int> sockets;
 
-    Lease(int cores, int memory, bool total, std::weak_ptr<Executor> && node):
+    Lease(int cores, int memory):
       cores(cores),
-      memory(memory),
-      total(total),
-      node(node)
+      memory(memory)
     {}
   };
 
@@ -40,22 +42,43 @@ namespace rfaas { namespace resource_manager {
     rdmalib::Connection* _connection;
     int _free_cores;
     int _free_memory;
+    std::vector<int> _free_socket_cores;
+
+    // Position in the capacity index; free resources change only with the lock held.
+    typedef std::multimap<int, std::weak_ptr<Executor>> capacity_bucket_t;
+    std::mutex _capacity_mutex;
+    int _bucket;
+    capacity_bucket_t::iterator _bucket_pos;
+    // Not indexed while its executor manager stops sending heartbeats.
+    bool _suspended;
+    // Slot in the liveness table, -1 when not monitored.
+    int _liveness_slot;
+    // Slot in the capacity table, and the cores delegated to it.
+    int _capacity_slot;
+    Lease _delegated;
 
     static constexpr int RECV_BUF_SIZE = 32;
     static constexpr int MSG_SIZE = std::max(sizeof(common::NodeRegistration), sizeof(common::LeaseDeallocation));
     rdmalib::Buffer<uint8_t> _receive_buffer;
     rdmalib::Buffer<common::LeaseAllocation> _send_buffer;
+    // Clients and requests forwarded by other shards are handled on separate threads.
+    std::mutex _send_mutex;
 
     Executor();
-    Executor(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory);
+    Executor(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets);
 
-    void initialize_data(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory);
+    void initialize_data(const std::string & node_name, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets);
     void initialize_connection(ibv_pd* pd, rdmalib::Connection* conn);
     bool is_initialized() const;
 
-    bool lease(int cores, int memory);
+    // Takes the cores from a single socket when possible.
+    bool lease(Lease & lease);
     bool is_fully_leased() const;
+    // Recovered or active leases still hold resources of this node.
+    bool has_leases() const;
     void cancel_lease(const Lease & lease);
+    // Most free cores available on a single socket.
+    int free_socket_cores() const;
 
     void merge(std::shared_ptr<Executor>& exec);
 
@@ -75,7 +98,9 @@ namespace rfaas { namespace resource_manager {
 
     Executors(ibv_pd* pd);
 
-    std::tuple<std::weak_ptr<Executor>, bool> add_executor(const std::string& name, const std::string & ip, int32_t port, int16_t cores, int32_t memory);
+    std::tuple<std::weak_ptr<Executor>, bool> add_executor(
+      const std::string& name, const std::string & ip, int32_t port, int16_t cores, int32_t memory, int16_t sockets = 1
+    );
     void connect_executor(std::shared_ptr<Executor> && exec);
     bool register_executor(uint32_t qp_num, const std::string& name);
 
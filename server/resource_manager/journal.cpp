@@ -0,0 +1,307 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <spdlog/spdlog.h>
+
+#include "executor.hpp"
+#include "journal.hpp"
+
+namespace rfaas::resource_manager {
+
+  constexpr int StateJournal::FLUSH_INTERVAL_MS;
+  constexpr int StateJournal::SNAPSHOT_RECORDS;
+  constexpr int StateJournal::SNAPSHOT_RETRY_MS;
+  constexpr uint64_t StateJournal::SNAPSHOT_MAGIC;
+  constexpr uint32_t StateJournal::SNAPSHOT_VERSION;
+
+  JournalRecord JournalRecord::node_added(const Executor & node)
+  {
+    JournalRecord record{};
+    record.type = Type::NODE_ADD;
+    strncpy(record.node, node.node.c_str(), sizeof(record.node) - 1);
+    strncpy(record.address, node.address.c_str(), sizeof(record.address) - 1);
+    record.port = node.port;
+    record.cores = node.cores;
+    record.memory = node.memory;
+    record.sockets = node.sockets;
+    return record;
+  }
+
+  JournalRecord JournalRecord::node_removed(const std::string & node)
+  {
+    JournalRecord record{};
+    record.type = Type::NODE_REMOVE;
+    strncpy(record.node, node.c_str(), sizeof(record.node) - 1);
+    return record;
+  }
+
+  JournalRecord JournalRecord::lease_opened(int32_t lease_id, const Executor & node, int cores, int memory)
+  {
+    JournalRecord record{};
+    record.type = Type::LEASE_OPEN;
+    record.lease_id = lease_id;
+    strncpy(record.node, node.node.c_str(), sizeof(record.node) - 1);
+    record.cores = cores;
+    record.memory = memory;
+    return record;
+  }
+
+  JournalRecord JournalRecord::lease_closed(int32_t lease_id)
+  {
+    JournalRecord record{};
+    record.type = Type::LEASE_CLOSE;
+    record.lease_id = lease_id;
+    return record;
+  }
+
+  StateJournal::StateJournal(const std::string & directory):
+    _snapshot_path(directory + "/snapshot.bin"),
+    _log_path(directory + "/journal.log"),
+    _log_fd(-1),
+    _sequence(0),
+    _stop(false),
+    _written(0),
+    _log_records(0),
+    _next_lease_id(0),
+    _failed(false),
+    _dropped(0)
+  {
+    mkdir(directory.c_str(), S_IRWXU);
+  }
+
+  StateJournal::~StateJournal()
+  {
+    stop();
+    if(_log_fd != -1)
+      close(_log_fd);
+  }
+
+  bool StateJournal::recover(const apply_t & apply)
+  {
+    auto begin = std::chrono::high_resolution_clock::now();
+    uint64_t snapshot_sequence = 0;
+
+    int fd = open(_snapshot_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd != -1) {
+
+      struct stat st;
+      void* ptr = MAP_FAILED;
+      if(!fstat(fd, &st) && st.st_size >= static_cast<off_t>(sizeof(SnapshotHeader)))
+        ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+
+      if(ptr != MAP_FAILED) {
+        auto header = static_cast<const SnapshotHeader*>(ptr);
+        size_t expected = sizeof(SnapshotHeader) + sizeof(JournalRecord) * header->records;
+        if(header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION || expected > static_cast<size_t>(st.st_size)) {
+          spdlog::error("Ignoring malformed snapshot {}", _snapshot_path);
+        } else {
+          auto records = reinterpret_cast<const JournalRecord*>(header + 1);
+          for(uint32_t i = 0; i < header->records; ++i) {
+            _apply(records[i]);
+            apply(records[i]);
+          }
+          snapshot_sequence = _sequence = header->sequence;
+          // Closed leases are not in the snapshot - their IDs must not be reused.
+          _next_lease_id = std::max(_next_lease_id, header->next_lease_id);
+        }
+        munmap(ptr, st.st_size);
+      }
+    }
+
+    _log_fd = open(_log_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if(_log_fd == -1) {
+      spdlog::error("Couldn't open the state log {}, reason {}", _log_path, strerror(errno));
+      return false;
+    }
+
+    // Records written before the last snapshot are skipped.
+    // A record cut short by a crash ends the log.
+    JournalRecord record;
+    off_t valid = 0;
+    while(read(_log_fd, &record, sizeof(record)) == sizeof(record)) {
+      valid += sizeof(record);
+      ++_log_records;
+      if(record.sequence <= snapshot_sequence)
+        continue;
+      _apply(record);
+      apply(record);
+      _sequence = record.sequence;
+    }
+    if(ftruncate(_log_fd, valid))
+      spdlog::warn("Couldn't truncate the state log {}", _log_path);
+    _written = _sequence;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    spdlog::info(
+      "Recovered {} nodes and {} leases in {} us",
+      _nodes.size(), _leases.size(),
+      std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()
+    );
+    return true;
+  }
+
+  void StateJournal::start()
+  {
+    if(_log_fd != -1 && !_writer.joinable())
+      _writer = std::thread(&StateJournal::_run, this);
+  }
+
+  int32_t StateJournal::next_lease_id() const
+  {
+    return _next_lease_id;
+  }
+
+  void StateJournal::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      _stop = true;
+    }
+    _cv.notify_one();
+    if(_writer.joinable())
+      _writer.join();
+  }
+
+  void StateJournal::append(JournalRecord && record)
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    record.sequence = ++_sequence;
+    _pending.push_back(std::move(record));
+  }
+
+  void StateJournal::_run()
+  {
+    std::vector<JournalRecord> records;
+    bool stop = false;
+    while(!stop) {
+
+      // Records of a failed flush are retried before the new ones.
+      {
+        std::unique_lock<std::mutex> lock{_mutex};
+        _cv.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this]() { return _stop; });
+        stop = _stop;
+        records.insert(records.end(), _pending.begin(), _pending.end());
+        _pending.clear();
+      }
+
+      if(_failed) {
+        _dropped += records.size();
+        records.clear();
+      } else if(!records.empty() && _flush(records)) {
+        records.clear();
+      }
+
+      if(!_failed && _log_records >= SNAPSHOT_RECORDS) {
+        auto now = std::chrono::steady_clock::now();
+        if(now >= _snapshot_retry && !_snapshot())
+          _snapshot_retry = now + std::chrono::milliseconds(SNAPSHOT_RETRY_MS);
+      }
+    }
+    _dropped += records.size();
+    if(_dropped)
+      spdlog::error("State log lost {} changes, the recovered state will be incomplete", _dropped);
+    spdlog::info("Background thread stops writing the state log");
+  }
+
+  bool StateJournal::_flush(std::vector<JournalRecord> & records)
+  {
+    const char* data = reinterpret_cast<const char*>(records.data());
+    size_t size = sizeof(JournalRecord) * records.size();
+    while(size > 0) {
+      ssize_t written = write(_log_fd, data, size);
+      if(written < 0) {
+        if(errno == EINTR)
+          continue;
+        spdlog::error("Couldn't write the state log, reason {}", strerror(errno));
+        // Every later record would be misaligned after a partial one.
+        if(ftruncate(_log_fd, static_cast<off_t>(sizeof(JournalRecord)) * _log_records)) {
+          spdlog::error("Couldn't remove a partial record from the state log {}, it's no longer written", _log_path);
+          _failed = true;
+        }
+        return false;
+      }
+      data += written;
+      size -= written;
+    }
+    fdatasync(_log_fd);
+
+    for(const JournalRecord & record : records)
+      _apply(record);
+    _log_records += records.size();
+    _written = records.back().sequence;
+    return true;
+  }
+
+  void StateJournal::_apply(const JournalRecord & record)
+  {
+    switch(record.type)
+    {
+      case JournalRecord::Type::NODE_ADD:
+        _nodes.insert_or_assign(record.node, record);
+      break;
+      case JournalRecord::Type::NODE_REMOVE:
+        _nodes.erase(record.node);
+      break;
+      case JournalRecord::Type::LEASE_OPEN:
+        _leases.emplace(record.lease_id, record);
+        _next_lease_id = std::max(_next_lease_id, record.lease_id + 1);
+      break;
+      case JournalRecord::Type::LEASE_CLOSE:
+        _leases.erase(record.lease_id);
+      break;
+    }
+  }
+
+  bool StateJournal::_snapshot()
+  {
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    // Nodes first - leases refer to them.
+    std::vector<JournalRecord> records;
+    records.reserve(_nodes.size() + _leases.size());
+    for(const auto & [name, record] : _nodes)
+      records.push_back(record);
+    for(const auto & [id, record] : _leases)
+      records.push_back(record);
+    SnapshotHeader header{SNAPSHOT_MAGIC, SNAPSHOT_VERSION, static_cast<uint32_t>(records.size()), _written, _next_lease_id, 0};
+
+    std::string tmp_path = _snapshot_path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if(fd == -1) {
+      spdlog::error("Couldn't create the snapshot {}, reason {}", tmp_path, strerror(errno));
+      return false;
+    }
+    size_t size = sizeof(JournalRecord) * records.size();
+    bool success = write(fd, &header, sizeof(header)) == sizeof(header) &&
+      write(fd, records.data(), size) == static_cast<ssize_t>(size) &&
+      !fdatasync(fd);
+    close(fd);
+    if(!success || rename(tmp_path.c_str(), _snapshot_path.c_str())) {
+      spdlog::error("Couldn't write the snapshot {}", _snapshot_path);
+      unlink(tmp_path.c_str());
+      return false;
+    }
+
+    // Records in the snapshot are skipped on recovery if we crash before truncating.
+    if(ftruncate(_log_fd, 0))
+      spdlog::warn("Couldn't truncate the state log {}", _log_path);
+    _log_records = 0;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    spdlog::info(
+      "Snapshot of {} nodes and {} leases written in {} us", _nodes.size(), _leases.size(),
+      std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()
+    );
+    return true;
+  }
+
+}
+
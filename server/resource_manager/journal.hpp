@@ -0,0 +1,122 @@
+
+#ifndef __RFAAS_RESOURCE_MANAGER_JOURNAL_HPP__
+#define __RFAAS_RESOURCE_MANAGER_JOURNAL_HPP__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/messages.hpp"
+
+namespace rfaas::resource_manager {
+
+  struct Executor;
+
+  // Fixed-size change of the resource manager state.
+  // The same layout is used in the log and in the snapshot.
+  struct JournalRecord
+  {
+    enum class Type : uint32_t
+    {
+      NODE_ADD = 1,
+      NODE_REMOVE = 2,
+      LEASE_OPEN = 3,
+      LEASE_CLOSE = 4
+    };
+
+    Type type;
+    int32_t lease_id;
+    uint64_t sequence;
+    char node[common::NodeRegistration::NODE_NAME_LENGTH];
+    char address[16];
+    int32_t port;
+    int32_t cores;
+    int32_t memory;
+    int32_t sockets;
+
+    static JournalRecord node_added(const Executor & node);
+    static JournalRecord node_removed(const std::string & node);
+    static JournalRecord lease_opened(int32_t lease_id, const Executor & node, int cores, int memory);
+    static JournalRecord lease_closed(int32_t lease_id);
+  };
+
+  // Persistent state of the resource manager: a compacted snapshot of nodes and leases,
+  // and an append-only log of changes made after it.
+  // Changes are appended to memory, and a background thread writes them to the log -
+  // allocations never wait for the disk. The log is compacted into a new snapshot
+  // once it grows past SNAPSHOT_RECORDS, and the snapshot is mapped on recovery.
+  struct StateJournal
+  {
+    static constexpr int FLUSH_INTERVAL_MS = 10;
+    static constexpr int SNAPSHOT_RECORDS = 65536;
+    static constexpr int SNAPSHOT_RETRY_MS = 5000;
+    static constexpr uint64_t SNAPSHOT_MAGIC = 0x7266616173736e70;
+    static constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+    typedef std::function<void(const JournalRecord &)> apply_t;
+
+    StateJournal(const std::string & directory);
+    ~StateJournal();
+
+    // Replays the snapshot and the log; called before the writer starts.
+    bool recover(const apply_t & apply);
+    void start();
+    // Lease IDs below this value were handed out before, including closed leases.
+    int32_t next_lease_id() const;
+    // Writes the remaining changes.
+    void stop();
+
+    // Thread-safe.
+    void append(JournalRecord && record);
+
+  private:
+    struct SnapshotHeader
+    {
+      uint64_t magic;
+      uint32_t version;
+      uint32_t records;
+      uint64_t sequence;
+      int32_t next_lease_id;
+      uint32_t reserved;
+    };
+
+    std::string _snapshot_path;
+    std::string _log_path;
+    int _log_fd;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<JournalRecord> _pending;
+    uint64_t _sequence;
+    bool _stop;
+    std::thread _writer;
+
+    // Accessed only by the writer thread after recovery.
+    std::unordered_map<std::string, JournalRecord> _nodes;
+    std::unordered_map<int32_t, JournalRecord> _leases;
+    uint64_t _written;
+    int _log_records;
+    int32_t _next_lease_id;
+    // Set when a partial record couldn't be removed from the log - nothing is written after it.
+    bool _failed;
+    uint64_t _dropped;
+    // A failed snapshot isn't retried before this time.
+    std::chrono::steady_clock::time_point _snapshot_retry;
+
+    void _run();
+    // Failed writes are removed from the log, and the records are kept for the next flush.
+    bool _flush(std::vector<JournalRecord> & records);
+    void _apply(const JournalRecord & record);
+    bool _snapshot();
+  };
+
+}
+
+#endif
+
@@ -0,0 +1,120 @@
+
+#include <algorithm>
+
+#include "lease_queue.hpp"
+
+namespace rfaas::resource_manager {
+
+  LeaseQueue::LeaseQueue(int max_size):
+    _max_size(max_size),
+    _arrivals(0),
+    _virtual_time(0),
+    _next_deadline(std::chrono::steady_clock::time_point::max())
+  {
+    _entries.reserve(std::max(max_size, 0));
+  }
+
+  bool LeaseQueue::empty() const
+  {
+    return _entries.empty();
+  }
+
+  int LeaseQueue::size() const
+  {
+    return _entries.size();
+  }
+
+  bool LeaseQueue::push(
+    uint32_t client, const rfaas::LeaseRequest & request, double charge,
+    std::chrono::steady_clock::time_point deadline
+  )
+  {
+    if(static_cast<int>(_entries.size()) >= _max_size)
+      return false;
+
+    double start = std::max(charge, _virtual_time);
+    Entry entry{client, request, start, this->charge(charge, request), _arrivals++, deadline};
+    _entries.insert(std::upper_bound(_entries.begin(), _entries.end(), entry, _before), entry);
+    _next_deadline = std::min(_next_deadline, deadline);
+    return true;
+  }
+
+  void LeaseQueue::remove(uint32_t client)
+  {
+    auto end = std::remove_if(
+      _entries.begin(), _entries.end(),
+      [client](const Entry & entry) { return entry.client == client; }
+    );
+    if(end != _entries.end()) {
+      _entries.erase(end, _entries.end());
+      _update_deadline();
+    }
+  }
+
+  int LeaseQueue::process(
+    std::chrono::steady_clock::time_point now, bool released,
+    const grant_t & grant, std::vector<Entry> & expired
+  )
+  {
+    if(!released && now < _next_deadline)
+      return 0;
+
+    // The first request that doesn't fit blocks lower priorities.
+    int granted = 0;
+    bool blocked = false;
+    int16_t blocked_priority = 0;
+    auto it = _entries.begin();
+    while(it != _entries.end()) {
+
+      bool eligible = released && (!blocked || (*it).request.priority >= blocked_priority);
+      if(eligible && grant(*it)) {
+        _virtual_time = std::max(_virtual_time, (*it).start);
+        it = _entries.erase(it);
+        ++granted;
+        continue;
+      }
+
+      if(eligible && !blocked) {
+        blocked = true;
+        blocked_priority = (*it).request.priority;
+      }
+      if((*it).deadline <= now) {
+        expired.push_back(std::move(*it));
+        it = _entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    _update_deadline();
+    return granted;
+  }
+
+  bool LeaseQueue::blocks(int16_t priority) const
+  {
+    return !_entries.empty() && _entries.front().request.priority > priority;
+  }
+
+  double LeaseQueue::charge(double charge, const rfaas::LeaseRequest & request) const
+  {
+    int weight = std::max<int>(request.weight, 1);
+    return std::max(charge, _virtual_time) + static_cast<double>(request.cores) / weight;
+  }
+
+  bool LeaseQueue::_before(const Entry & a, const Entry & b)
+  {
+    if(a.request.priority != b.request.priority)
+      return a.request.priority > b.request.priority;
+    if(a.finish != b.finish)
+      return a.finish < b.finish;
+    return a.arrival < b.arrival;
+  }
+
+  void LeaseQueue::_update_deadline()
+  {
+    _next_deadline = std::chrono::steady_clock::time_point::max();
+    for(const Entry & entry : _entries)
+      _next_deadline = std::min(_next_deadline, entry.deadline);
+  }
+
+}
+
@@ -0,0 +1,75 @@
+
+#ifndef __RFAAS_RESOURCE_MANAGER_LEASE_QUEUE_HPP__
+#define __RFAAS_RESOURCE_MANAGER_LEASE_QUEUE_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <rfaas/allocation.hpp>
+
+namespace rfaas::resource_manager {
+
+  // Lease requests waiting for resources when no node fits them.
+  // Requests are granted by priority, and clients of the same priority share nodes by weight:
+  // each client is charged the cores it receives divided by its weight, and the request that
+  // finishes with the least charge goes first. Smaller requests of the same priority can pass
+  // larger ones that don't fit yet, but lower priorities wait - released resources accumulate
+  // for the large request. Requests past their deadline are answered with an empty response,
+  // and requests over the size limit are not admitted. Accessed only by the thread handling clients.
+  struct LeaseQueue
+  {
+    struct Entry
+    {
+      uint32_t client;
+      rfaas::LeaseRequest request;
+      // Charge of the client before and after this request.
+      double start;
+      double finish;
+      uint64_t arrival;
+      std::chrono::steady_clock::time_point deadline;
+    };
+
+    // Returns false when the request still doesn't fit.
+    typedef std::function<bool(const Entry &)> grant_t;
+
+    LeaseQueue(int max_size);
+
+    bool empty() const;
+    int size() const;
+    // Returns false when the queue is full.
+    bool push(
+      uint32_t client, const rfaas::LeaseRequest & request, double charge,
+      std::chrono::steady_clock::time_point deadline
+    );
+    // Removes requests of a disconnected client.
+    void remove(uint32_t client);
+    // Tries all requests in order when resources were released, otherwise only expires them.
+    // Returns the number of granted requests.
+    int process(
+      std::chrono::steady_clock::time_point now, bool released,
+      const grant_t & grant, std::vector<Entry> & expired
+    );
+    // True when a request of a higher priority waits - new requests don't take resources released for it.
+    bool blocks(int16_t priority) const;
+    // Charge of a client after a lease granted without waiting.
+    double charge(double charge, const rfaas::LeaseRequest & request) const;
+
+  private:
+    // Sorted in the order of grants.
+    std::vector<Entry> _entries;
+    int _max_size;
+    uint64_t _arrivals;
+    // Start of the last granted request; clients that were idle don't start below it.
+    double _virtual_time;
+    std::chrono::steady_clock::time_point _next_deadline;
+
+    static bool _before(const Entry & a, const Entry & b);
+    void _update_deadline();
+  };
+
+}
+
+#endif
+
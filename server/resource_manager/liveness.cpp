@@ -0,0 +1,86 @@
+
+#include <spdlog/spdlog.h>
+
+#include "liveness.hpp"
+
+namespace rfaas::resource_manager {
+
+  constexpr int LivenessTable::MAX_NODES;
+
+  LivenessTable::LivenessTable(ibv_pd* pd):
+    _heartbeats(MAX_NODES),
+    _slots(MAX_NODES)
+  {
+    _heartbeats.register_memory(pd, IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+    for(int i = MAX_NODES - 1; i >= 0; --i)
+      _free.push_back(i);
+  }
+
+  bool LivenessTable::attach(const std::shared_ptr<Executor> & node)
+  {
+    // A manager registering again keeps its slot, and starts counting from zero.
+    int slot = node->_liveness_slot;
+    if(slot == -1) {
+      if(_free.empty()) {
+        spdlog::error("Liveness table is full, node {} is not monitored", node->node);
+        return false;
+      }
+      slot = _free.back();
+      _free.pop_back();
+      _slots[slot] = Slot{node, 0, std::chrono::steady_clock::now(), true};
+      node->_liveness_slot = slot;
+    }
+    _heartbeats[slot].sequence = 0;
+    _slots[slot].sequence = 0;
+    _slots[slot].last_seen = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  void LivenessTable::detach(Executor & node)
+  {
+    if(node._liveness_slot == -1)
+      return;
+    _slots[node._liveness_slot].node.reset();
+    _free.push_back(node._liveness_slot);
+    node._liveness_slot = -1;
+  }
+
+  rdmalib::RemoteBuffer LivenessTable::remote(const Executor & node) const
+  {
+    return rdmalib::RemoteBuffer{
+      _heartbeats.address() + node._liveness_slot * sizeof(common::NodeHeartbeat),
+      _heartbeats.rkey(),
+      sizeof(common::NodeHeartbeat)
+    };
+  }
+
+  void LivenessTable::scan(
+    std::chrono::steady_clock::time_point now, std::chrono::milliseconds timeout,
+    std::vector<std::shared_ptr<Executor>> & expired, std::vector<std::shared_ptr<Executor>> & revived
+  )
+  {
+    for(int i = 0; i < MAX_NODES; ++i) {
+
+      Slot & slot = _slots[i];
+      auto node = slot.node.lock();
+      if(!node)
+        continue;
+
+      // Written by the executor manager without our involvement.
+      uint64_t sequence = *reinterpret_cast<volatile uint64_t*>(&_heartbeats[i].sequence);
+      if(sequence != slot.sequence) {
+        slot.sequence = sequence;
+        slot.last_seen = now;
+        if(!slot.alive) {
+          slot.alive = true;
+          revived.push_back(std::move(node));
+        }
+      } else if(slot.alive && now - slot.last_seen > timeout) {
+        slot.alive = false;
+        expired.push_back(std::move(node));
+      }
+    }
+  }
+
+}
+
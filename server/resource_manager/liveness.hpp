@@ -0,0 +1,53 @@
+
+#ifndef __RFAAS_RESOURCE_MANAGER_LIVENESS_HPP__
+#define __RFAAS_RESOURCE_MANAGER_LIVENESS_HPP__
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <rdmalib/buffer.hpp>
+
+#include "common/messages.hpp"
+#include "executor.hpp"
+
+namespace rfaas::resource_manager {
+
+  // Heartbeats of executor managers, written by them directly with RDMA writes.
+  // Each registered manager owns a slot; a node whose heartbeat doesn't advance
+  // within the timeout is reported once as expired, and once as revived when it resumes.
+  // Accessed only by the thread handling executor managers.
+  struct LivenessTable
+  {
+    static constexpr int MAX_NODES = 1024;
+
+    LivenessTable(ibv_pd* pd);
+
+    // Returns false when the table is full.
+    bool attach(const std::shared_ptr<Executor> & node);
+    void detach(Executor & node);
+    rdmalib::RemoteBuffer remote(const Executor & node) const;
+
+    void scan(
+      std::chrono::steady_clock::time_point now, std::chrono::milliseconds timeout,
+      std::vector<std::shared_ptr<Executor>> & expired, std::vector<std::shared_ptr<Executor>> & revived
+    );
+
+  private:
+    struct Slot
+    {
+      std::weak_ptr<Executor> node;
+      uint64_t sequence;
+      std::chrono::steady_clock::time_point last_seen;
+      bool alive;
+    };
+
+    rdmalib::Buffer<common::NodeHeartbeat> _heartbeats;
+    std::vector<Slot> _slots;
+    std::vector<int> _free;
+  };
+
+}
+
+#endif
+
@@ -1,13 +1,17 @@
 
 
 
+#include <algorithm>
+#include <new>
 #include <stdexcept>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
 
 #include <spdlog/spdlog.h>
+#include <sys/eventfd.h>
 #include <sys/poll.h>
+#include <unistd.h>
 
 #include <rdmalib/buffer.hpp>
 #include <rdmalib/connection.hpp>
@@ -25,6 +29,11 @@ constexpr int Manager::POLLING_TIMEOUT_MS;
 
 Manager::Manager(Settings &settings):
     _executors_output_path(),
+    _lease_queue(settings.lease_queue_size),
+    _lease_queue_released(0),
+    _lease_waiting(false),
+    _lease_signaled(false),
+    _lease_release_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
     _client_id(0),
     _state(settings.device->ip_address, settings.rdma_device_port,
             settings.device->default_receive_buffer_size, true,
@@ -32,11 +41,21 @@ Manager::Manager(Settings &settings):
     _shutdown(false),
     _device(*settings.device),
     _executors(_state.pd()),
-    _executor_data(_executors),
+    _executor_data(_executors, settings.placement_policy),
+    _liveness(_state.pd()),
+    _capacity_table(_state.pd()),
     _http_server(_executor_data, settings),
+    _shards(settings),
     _settings(settings),
     _secret(settings.rdma_secret)
-  {}
+  {
+    rdmalib::impl::expect_nonnegative(_lease_release_fd);
+  }
+
+Manager::~Manager()
+{
+  close(_lease_release_fd);
+}
 
 void Manager::start() {
   // Start HTTP server on a new thread
@@ -45,14 +64,27 @@ void Manager::start() {
 
   _state.register_shared_queue(1);
   _state.register_shared_queue(2);
+  _state.register_shared_queue(ShardPeers::PEER_ID);
 
   std::thread listener(&Manager::listen_rdma, this);
+  // Requests forwarded by other shards never wait for clients of this one.
+  std::thread peer_poller;
+  if(!_settings.shards.empty()) {
+    spdlog::info("Running as shard {} out of {}", _settings.shard_id, _settings.shards.size());
+    peer_poller = std::thread(&Manager::process_peers, this);
+    _shards.start();
+  }
 
   if(_settings.rdma_sleep) {
 
     std::thread rdma_processer(&Manager::process_events_sleep, this);
     rdma_processer.join();
 
+  } else if(_settings.rdma_threads <= 1) {
+
+    std::thread rdma_poller(&Manager::process_rdma, this);
+    rdma_poller.join();
+
   } else {
 
     std::thread rdma_poller(&Manager::process_clients, this);
@@ -62,7 +94,10 @@ void Manager::start() {
     exec_poller.join();
 
   }
+  if(peer_poller.joinable())
+    peer_poller.join();
   listener.join();
+  _shards.disconnect();
 }
 
 void Manager::listen_rdma() {
@@ -90,6 +125,8 @@ void Manager::listen_rdma() {
 
       if (private_data.key() == 1) {
         _executor_queue.enqueue(std::make_tuple(Operation::DISCONNECT, conn));
+      } else if (private_data.key() == ShardPeers::PEER_ID) {
+        _peer_queue.enqueue(std::make_tuple(Operation::DISCONNECT, conn));
       } else {
         _client_queue.enqueue(std::make_tuple(Operation::DISCONNECT, conn));
       }
@@ -102,6 +139,22 @@ void Manager::listen_rdma() {
         spdlog::error("[Manager] Reject executor, wrong secret {}", private_data);
         _state.reject(conn);
 
+      } else if (private_data.key() == ShardPeers::PEER_ID && private_data.secret() != this->_secret) {
+
+        uint32_t private_data = (*conn).private_data();
+        spdlog::error("[Manager] Reject shard, wrong secret {}", private_data);
+        _state.reject(conn);
+
+      } else if (private_data.key() == ShardPeers::PEER_ID) {
+
+        _peer_queue.enqueue(
+            std::make_tuple(
+              Operation::CONNECT,
+              client_msg_t{Client{_client_id++, conn, _state.pd()}}
+            )
+        );
+        _state.accept(conn);
+
       } else if (private_data.key() == 1) {
 
         auto exec = std::make_shared<Executor>();
@@ -132,6 +185,8 @@ void Manager::listen_rdma() {
         SPDLOG_DEBUG("[Manager] Listen thread: connected new executor");
       } else if (private_data.key() == 2) {
         SPDLOG_DEBUG("[Manager] Listen thread: connected new client");
+      } else if (private_data.key() == ShardPeers::PEER_ID) {
+        SPDLOG_DEBUG("[Manager] Listen thread: connected new shard");
       } else {
         SPDLOG_DEBUG("[Manager] Listen thread: unknown connection!");
         conn->close();
@@ -165,12 +220,50 @@ void Manager::_handle_message(ibv_wc& wc)
   if(type == common::id_to_int(common::MessageIDs::NODE_REGISTRATION)) {
 
     auto ptr = reinterpret_cast<common::NodeRegistration*>(buf);
-    _executors.register_executor(qp_num, ptr->node_name);
+    // Leases recovered from the state log could have been closed while we were down,
+    // or lost with the state of a restarted executor manager. They are reclaimed before
+    // the node accepts new leases, and the executor manager reports the leases it still holds.
+    auto node = _executors.get_executor(ptr->node_name);
+    bool verify = node && !node->is_initialized() && node->has_leases();
+    if(verify) {
+      int leases = _executor_data.reclaim(node);
+      spdlog::info("Executor {} registered with {} recovered leases, waiting for its leases", node->node, leases);
+    }
+    if(_executors.register_executor(qp_num, ptr->node_name)) {
+      _start_heartbeats(qp_num);
+      // Suspended nodes receive direct cores once they reported their leases.
+      if(verify)
+        _request_lease_report(*node);
+      else
+        _delegate_cores(qp_num);
+    } else if(verify) {
+      _executor_data.resume(node);
+    }
+
+  } else if(type == common::id_to_int(common::MessageIDs::LEASE_REPORT)) {
+
+    auto ptr = reinterpret_cast<common::LeaseReport*>(buf);
+    _executor_data.restore_lease(exec, *ptr);
+
+  } else if(type == common::id_to_int(common::MessageIDs::NODE_SUSPENDED)) {
+
+    // All leases still held by the node are restored.
+    spdlog::info("Executor {} reported its leases, placing new leases again", exec->node);
+    _executor_data.resume(exec);
+    _capacity_table.set_available(*exec, true);
+    if(exec->_delegated.cores == 0)
+      _delegate_cores(qp_num);
 
   } else if(type == common::id_to_int(common::MessageIDs::LEASE_DEALLOCATION)) {
 
     auto ptr = reinterpret_cast<common::LeaseDeallocation*>(buf);
     _executor_data.close_lease(*ptr);
+    if(_lease_waiting.load(std::memory_order_relaxed) && !_lease_signaled.exchange(true)) {
+      uint64_t value = 1;
+      if(write(_lease_release_fd, &value, sizeof(value)) < 0) {
+        spdlog::warn("Couldn't wake up waiting lease requests");
+      }
+    }
 
   } else {
     spdlog::error("Unknown message from executor! Unknown message type {}", type);
@@ -196,7 +289,8 @@ std::tuple<Manager::Operation, Manager::exec_msg_t>* Manager::_check_queue(execu
 
 std::tuple<Manager::Operation, Manager::client_msg_t>* Manager::_check_queue(client_queue_t& queue, bool sleep)
 {
-  static std::tuple<Operation, client_msg_t> result;
+  // Clients of this shard and of its peers are dequeued on different threads.
+  static thread_local std::tuple<Operation, client_msg_t> result;
   bool updated = false;
 
   if(!sleep) {
@@ -213,63 +307,158 @@ void Manager::_handle_executor_connection(std::shared_ptr<Executor> && exec)
   _executors.connect_executor(std::move(exec));
 }
 
-void Manager::_handle_executor_disconnection(rdmalib::Connection* conn)
+void Manager::_start_heartbeats(uint32_t qp_num)
 {
-  _executors.remove_executor(conn->qp()->qp_num);
+  auto exec = _executors.get_executor(qp_num);
+  if(!exec || _settings.lease_ttl_ms <= 0 || !_liveness.attach(exec)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{exec->_send_mutex};
+  auto msg = new (exec->_send_buffer.data()) common::NodeLiveness{};
+  rdmalib::RemoteBuffer slot = _liveness.remote(*exec);
+  msg->address = slot.addr;
+  msg->rkey = slot.rkey;
+  msg->heartbeat_ms = _settings.heartbeat_ms;
+  msg->lease_ttl_ms = _settings.lease_ttl_ms;
+
+  rdmalib::ScatterGatherElement sge;
+  sge.add(exec->_send_buffer, sizeof(common::NodeLiveness), 0);
+  exec->_connection->post_send(sge, 0, sizeof(common::NodeLiveness) <= _device.max_inline_data);
+  exec->_connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+  SPDLOG_DEBUG("Executor {} sends heartbeats every {} ms", exec->node, _settings.heartbeat_ms);
 }
 
-void Manager::process_executors()
+void Manager::_delegate_cores(uint32_t qp_num)
 {
-  rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(1))};
-  int executor_count = 0;
+  auto exec = _executors.get_executor(qp_num);
+  if(!exec || _settings.direct_cores <= 0) {
+    return;
+  }
 
-  while (!_shutdown.load()) {
+  int cores = _executor_data.delegate(exec, _settings.direct_cores);
+  if(!cores || !_capacity_table.attach(exec)) {
+    _executor_data.revoke(exec);
+    return;
+  }
 
-    while(true) {
+  std::lock_guard<std::mutex> lock{exec->_send_mutex};
+  auto msg = new (exec->_send_buffer.data()) common::NodeCapacitySlot{};
+  rdmalib::RemoteBuffer slot = _capacity_table.remote(*exec);
+  msg->address = slot.addr;
+  msg->rkey = slot.rkey;
+  msg->cores = cores;
+  msg->memory = exec->_delegated.memory;
+
+  rdmalib::ScatterGatherElement sge;
+  sge.add(exec->_send_buffer, sizeof(common::NodeCapacitySlot), 0);
+  exec->_connection->post_send(sge, 0, sizeof(common::NodeCapacitySlot) <= _device.max_inline_data);
+  exec->_connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+  SPDLOG_DEBUG("Executor {} delegates {} cores to direct leases", exec->node, cores);
+}
 
-      auto ptr = _check_queue(_executor_queue, executor_count == 0);
-      if(!ptr) {
-        break;
-      }
+int Manager::_check_liveness()
+{
+  auto now = std::chrono::steady_clock::now();
+  if(_settings.lease_ttl_ms <= 0 || now < _next_liveness_check) {
+    return 0;
+  }
+  _next_liveness_check = now + std::chrono::milliseconds(_settings.heartbeat_ms);
+
+  std::vector<std::shared_ptr<Executor>> expired, revived;
+  _liveness.scan(now, std::chrono::milliseconds(_settings.lease_ttl_ms), expired, revived);
+
+  for(auto & node : expired) {
+    int leases = _executor_data.reclaim(node);
+    spdlog::warn("Executor {} stopped sending heartbeats, reclaimed {} leases", node->node, leases);
+    _capacity_table.set_available(*node, false);
+  }
+  // The executor manager could have been only partitioned, and its executors still run.
+  for(auto & node : revived) {
+    spdlog::info("Executor {} sends heartbeats again, waiting for its leases", node->node);
+    _request_lease_report(*node);
+  }
+  return expired.size() + revived.size();
+}
+
+void Manager::_request_lease_report(Executor & exec)
+{
+  std::lock_guard<std::mutex> lock{exec._send_mutex};
+  new (exec._send_buffer.data()) common::NodeSuspended{};
+
+  rdmalib::ScatterGatherElement sge;
+  sge.add(exec._send_buffer, sizeof(common::NodeSuspended), 0);
+  exec._connection->post_send(sge, 0, sizeof(common::NodeSuspended) <= _device.max_inline_data);
+  exec._connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+}
+
+void Manager::_handle_executor_disconnection(rdmalib::Connection* conn)
+{
+  if(auto exec = _executors.get_executor(conn->qp()->qp_num)) {
+    _liveness.detach(*exec);
+    _capacity_table.detach(*exec);
+    _executor_data.revoke(exec);
+  }
+  _executors.remove_executor(conn->qp()->qp_num);
+}
+
+void Manager::_add_executor_handlers(rdmalib::Reactor & reactor, rdmalib::Poller & poller)
+{
+  reactor.add_task([this]() { return _check_liveness(); });
 
+  reactor.add_task([this]() {
+    int count = 0;
+    while(auto ptr = _check_queue(_executor_queue, false)) {
       if (std::get<0>(*ptr) == Operation::CONNECT) {
         _handle_executor_connection(
           std::move(std::get<1>(std::get<1>(*ptr)))
         );
-        executor_count++;
       } else {
         _handle_executor_disconnection(
           std::get<0>(std::get<1>(*ptr))
         );
-        executor_count--;
       }
+      ++count;
     }
+    return count;
+  });
 
-    auto wcs = recv_poller.poll(false);
-    if(std::get<1>(wcs)) {
-      for (int j = 0; j < std::get<1>(wcs); ++j) {
-        _handle_message(std::get<0>(wcs)[j]);
-      }
+  reactor.add_channel(poller, [this, &poller]() {
+    auto [wcs, count] = poller.poll(false);
+    for (int j = 0; j < count; ++j) {
+      _handle_message(wcs[j]);
     }
+    return count;
+  });
+}
 
-  }
+void Manager::process_executors()
+{
+  rdmalib::Reactor reactor{_settings.rdma_spin_us};
+  rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(1))};
+  _add_executor_handlers(reactor, recv_poller);
+  reactor.run(_shutdown, POLLING_TIMEOUT_MS);
 
   spdlog::info("Background thread stops processing rdmacm events");
 }
 
-void Manager::_handle_client_connection(Client& client)
+void Manager::_handle_client_connection(Client& client, client_t & clients)
 {
   uint32_t qp_num = client.connection->qp()->qp_num;
-  _clients.insert_or_assign(qp_num, std::move(client));
+  clients.insert_or_assign(qp_num, std::move(client));
   spdlog::debug("[Manager] Connecting client {}", _client_id - 1);
 }
 
-void Manager::_handle_client_disconnection(rdmalib::Connection* conn)
+void Manager::_handle_client_disconnection(rdmalib::Connection* conn, client_t & clients)
 {
   _executors.remove_executor(conn->qp()->qp_num);
-  auto it = _clients.find(conn->qp()->qp_num);
-  if (it != _clients.end()) {
-    _clients.erase(it);
+  // Other shards don't wait, and their requests are handled on another thread.
+  if(&clients == &_clients) {
+    _lease_queue.remove(conn->qp()->qp_num);
+  }
+  auto it = clients.find(conn->qp()->qp_num);
+  if (it != clients.end()) {
+    clients.erase(it);
     spdlog::debug("[Manager] Disconnecting client {}",
                   it->second.client_id);
   } else {
@@ -277,7 +466,7 @@ void Manager::_handle_client_disconnection(rdmalib::Connection* conn)
   }
 }
 
-void Manager::_handle_client_message(ibv_wc& wc, std::vector<Client*>& poll_send)
+void Manager::_handle_client_message(ibv_wc& wc, std::vector<Client*>& poll_send, client_t & clients, bool forward)
 {
 
   if(wc.status != IBV_WC_SUCCESS) {
@@ -288,126 +477,382 @@ void Manager::_handle_client_message(ibv_wc& wc, std::vector<Client*>& poll_send
   uint64_t id = wc.wr_id;
   uint32_t qp_num = wc.qp_num;
 
-  auto it = _clients.find(qp_num);
-  if(it == _clients.end()) {
+  auto it = clients.find(qp_num);
+  if(it == clients.end()) {
     spdlog::warn("Polled work completion for QP {}, non-existing client!", qp_num);
     return;
   }
 
   Client& client = (*it).second;
-  int16_t cores = client.allocation_requests.data()[id].cores;
-  int32_t memory = client.allocation_requests.data()[id].memory;
+  rfaas::LeaseRequest* requests = client.requests(id);
+  int count = wc.byte_len / sizeof(rfaas::LeaseRequest);
+  int16_t cores = requests[0].cores;
+  int32_t memory = requests[0].memory;
 
-  if (cores > 0) {
-    spdlog::info("Client requests executor with {} threads, it should have {} memory", 
-                client.allocation_requests.data()[id].cores,
-                client.allocation_requests.data()[id].memory
-    );
+  if (cores > 0 && count > 1) {
+
+    _handle_lease_batch(client, requests, count, forward);
+    poll_send.emplace_back(&client);
+
+    client.connection->receive_wcs().update_requests(-1);
+    client.connection->receive_wcs().refill();
+
+  } else if (cores > 0) {
+    spdlog::info("Client requests executor with {} threads, it should have {} memory", cores, memory);
+
+    int nodes = _open_lease(client, requests[0], forward);
 
-    auto allocated = _executor_data.open_lease(cores, memory, *client.response().data());
-    if(allocated) {
+    if(nodes) {
       spdlog::info("[Manager] Client receives lease with id {}", client.response().data()->lease_id);
+      client.charge = _lease_queue.charge(client.charge, requests[0]);
     } else {
       spdlog::info("[Manager] Client request couldn't be satisfied");
     }
 
-    if(!allocated) {
-      // FIXME: Send empty response?
-      client.connection->post_send(
-        client.response(),
-        0,
-        client.response().size() <= _device.max_inline_data,
-        0
-      );
-    } else {
-
-      allocated->_send_buffer[0].lease_id = client.response()[0].lease_id;
-      allocated->_send_buffer[0].cores = cores;
-      allocated->_send_buffer[0].memory = memory;
-
-      allocated->_connection->post_send(
-        allocated->_send_buffer,
-        0,
-        allocated->_send_buffer.size() <= _device.max_inline_data,
-        1
-      );
-      allocated->_connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
-
-      client.connection->post_send(
-        client.response(),
-        0,
-        client.response().size() <= _device.max_inline_data,
-        1
-      );
+    // Requests of other shards are answered at once - the shard asks its next peer.
+    if(nodes || !forward || !_queue_lease(client, requests[0])) {
+      _send_lease(client, nodes);
+      poll_send.emplace_back(&client);
     }
+
+    client.connection->receive_wcs().update_requests(-1);
+    client.connection->receive_wcs().refill();
+
+  } else if (cores == 0) {
+
+    // Clients take cores of the table directly, without further requests.
+    bool enabled = _settings.direct_cores > 0;
+    *reinterpret_cast<rfaas::CapacityTableResponse*>(client.response().data()) = _capacity_table.info();
+    client.connection->post_send(
+      client.response(),
+      0,
+      client.response().size() <= _device.max_inline_data,
+      enabled
+    );
     poll_send.emplace_back(&client);
 
     client.connection->receive_wcs().update_requests(-1);
     client.connection->receive_wcs().refill();
 
+  } else if (cores == rfaas::LeaseRequest::CANCEL && !forward) {
+
+    // Requests of other shards are the only ones handled without forwarding.
+    _cancel_lease(requests[0].lease_id);
+
+    client.connection->receive_wcs().update_requests(-1);
+    client.connection->receive_wcs().refill();
+
   } else {
     spdlog::info("Client {} disconnects", client.client_id);
     client.disable();
-    _clients.erase(it);
+    clients.erase(it);
   }
 
   return;
 }
 
-void Manager::process_clients()
+int Manager::_open_lease(Client & client, const rfaas::LeaseRequest & request, bool forward)
 {
-  rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(2))};
-  int client_count = 0;
-  std::vector<Client*> poll_send;
-  std::vector<client_t::iterator> removals;
+  // New requests of lower priorities don't pass the waiting ones.
+  std::vector<std::shared_ptr<Executor>> allocated;
+  if(!forward || !_lease_queue.blocks(request.priority)) {
+    allocated = _executor_data.open_lease(
+      request.cores, request.memory, request.func_hash, request.max_nodes, *client.response().data()
+    );
+  }
+  int nodes = allocated.size();
+  // Nodes of other shards are used only when the local ones are full.
+  if(!nodes && forward && !_shards.empty()) {
+    nodes = _shards.steal(request, *client.response().data());
+  }
 
-  while (!_shutdown.load()) {
+  // Each node of the lease is notified with its own part.
+  // Leases placed by a peer are announced by that shard.
+  if(!allocated.empty()) {
+    _notify_executors(allocated, client.response().data()->nodes);
+  }
+  return nodes;
+}
 
-    while(true) {
+void Manager::_cancel_lease(int32_t lease_id)
+{
+  auto node = _executor_data.cancel_lease(lease_id);
+  if(!node) {
+    return;
+  }
+  spdlog::info("[Manager] Lease {} was granted too late for another shard, cancelling it", lease_id);
 
-      auto ptr = _check_queue(_client_queue, client_count == 0);
-      if(!ptr) {
-        break;
+  std::lock_guard<std::mutex> lock{node->_send_mutex};
+  auto msg = new (node->_send_buffer.data()) common::LeaseCancel{};
+  msg->lease_id = lease_id;
+
+  rdmalib::ScatterGatherElement sge;
+  sge.add(node->_send_buffer, sizeof(common::LeaseCancel), 0);
+  node->_connection->post_send(sge, 0, sizeof(common::LeaseCancel) <= _device.max_inline_data);
+  node->_connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+}
+
+void Manager::_send_lease(Client & client, int nodes)
+{
+  // An empty response with no nodes tells the client to give up.
+  client.connection->post_send(
+    client.response(),
+    0,
+    client.response().size() <= _device.max_inline_data,
+    nodes
+  );
+}
+
+bool Manager::_queue_lease(Client & client, const rfaas::LeaseRequest & request)
+{
+  if(_settings.max_lease_wait_ms <= 0 || request.wait_ms <= 0) {
+    return false;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() +
+    std::chrono::milliseconds(std::min(request.wait_ms, _settings.max_lease_wait_ms));
+  if(!_lease_queue.push(client.connection->qp()->qp_num, request, client.charge, deadline)) {
+    spdlog::warn("[Manager] Lease queue is full, client {} is rejected", client.client_id);
+    return false;
+  }
+  _lease_waiting.store(true, std::memory_order_relaxed);
+  SPDLOG_DEBUG("Client {} waits for {} cores, {} requests waiting", client.client_id, request.cores, _lease_queue.size());
+  return true;
+}
+
+int Manager::_process_lease_queue(client_t & clients, std::vector<Client*> & poll_send)
+{
+  uint64_t value;
+  if(_lease_signaled.exchange(false) && read(_lease_release_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+    spdlog::warn("Couldn't read the lease release event, reason {}", strerror(errno));
+  }
+  if(_lease_queue.empty()) {
+    return 0;
+  }
+
+  // Without released resources, waiting requests can only expire.
+  uint64_t released = _executor_data.released();
+  bool retry = released != _lease_queue_released;
+  _lease_queue_released = released;
+
+  std::vector<LeaseQueue::Entry> expired;
+  int granted = _lease_queue.process(
+    std::chrono::steady_clock::now(), retry,
+    [this, &clients, &poll_send](const LeaseQueue::Entry & entry) {
+      // Requests of disconnected clients are removed with them.
+      auto it = clients.find(entry.client);
+      if(it == clients.end()) {
+        return true;
       }
+      Client & client = (*it).second;
 
-      if (std::get<0>(*ptr) == Operation::CONNECT) {
-        _handle_client_connection(std::get<1>(std::get<1>(*ptr)));
-        client_count++;
-      } else {
-        _handle_client_disconnection(std::get<0>(std::get<1>(*ptr)));
-        client_count--;
+      // Other shards were asked when the request arrived.
+      int nodes = _open_lease(client, entry.request, false);
+      if(!nodes) {
+        return false;
       }
+      spdlog::info("[Manager] Waiting client receives lease with id {}", client.response().data()->lease_id);
+      client.charge = entry.finish;
+      _send_lease(client, nodes);
+      poll_send.emplace_back(&client);
+      return true;
+    },
+    expired
+  );
+
+  for(const LeaseQueue::Entry & entry : expired) {
+    auto it = clients.find(entry.client);
+    if(it != clients.end()) {
+      spdlog::info("[Manager] Waiting client request couldn't be satisfied");
+      _send_lease((*it).second, 0);
+      poll_send.emplace_back(&(*it).second);
+    }
+  }
+  _lease_waiting.store(!_lease_queue.empty(), std::memory_order_relaxed);
+  return granted + expired.size();
+}
+
+void Manager::_handle_lease_batch(Client & client, const rfaas::LeaseRequest* requests, int count, bool forward)
+{
+  rfaas::LeaseBatchResponse & response = client.batch_response();
+  std::vector<std::shared_ptr<Executor>> nodes(count);
+  int granted = 0;
+
+  // Each request of the batch is placed on a single node.
+  for(int i = 0; i < count; ++i) {
+
+    rfaas::LeasedNode & leased = response.leases[i];
+    leased.lease_id = -1;
+    if(requests[i].cores <= 0) {
+      continue;
     }
 
-    auto wcs = recv_poller.poll(false);
-    if(std::get<1>(wcs)) {
-      for (int j = 0; j < std::get<1>(wcs); ++j) {
-        _handle_client_message(std::get<0>(wcs)[j], poll_send);
+    rfaas::LeaseResponse lease;
+    auto allocated = _executor_data.open_lease(
+      requests[i].cores, requests[i].memory, requests[i].func_hash, 1, lease
+    );
+    if(!allocated.empty()) {
+      nodes[i] = std::move(allocated[0]);
+    } else if(forward && !_shards.empty()) {
+      rfaas::LeaseRequest request = requests[i];
+      request.max_nodes = 1;
+      if(!_shards.steal(request, lease)) {
+        continue;
       }
+    } else {
+      continue;
     }
+    leased = lease.nodes[0];
+    ++granted;
+  }
+  spdlog::info("[Manager] Client receives {} out of {} leases in a batch", granted, count);
 
-    if (poll_send.size()) {
+  _notify_executors(nodes, response.leases);
+
+  rdmalib::ScatterGatherElement sge;
+  uint32_t bytes = sizeof(rfaas::LeasedNode) * count;
+  sge.add(client.response(), bytes, 0);
+  client.connection->post_send(sge, 0, bytes <= _device.max_inline_data, granted);
+}
+
+void Manager::_notify_executors(const std::vector<std::shared_ptr<Executor>> & nodes, const rfaas::LeasedNode* leases)
+{
+  // Requests forwarded by other shards are handled on their own thread.
+  // Nodes are locked in address order, and stay locked until the sends complete.
+  std::vector<Executor*> locked;
+  for(auto & node : nodes) {
+    if(node) {
+      locked.push_back(node.get());
+    }
+  }
+  std::sort(locked.begin(), locked.end());
+  locked.erase(std::unique(locked.begin(), locked.end()), locked.end());
+  std::vector<std::unique_lock<std::mutex>> locks;
+  locks.reserve(locked.size());
+  for(Executor* node : locked) {
+    locks.emplace_back(node->_send_mutex);
+  }
+
+  // Allocations for the same executor manager are sent in one message.
+  std::vector<std::tuple<Executor*, int>> messages;
+  for(size_t i = 0; i < nodes.size(); ++i) {
+
+    if(!nodes[i]) {
+      continue;
+    }
+
+    auto it = std::find_if(messages.begin(), messages.end(),
+      [&nodes, i](const std::tuple<Executor*, int> & msg) { return std::get<0>(msg) == nodes[i].get(); }
+    );
+    if(it == messages.end()) {
+      it = messages.emplace(messages.end(), nodes[i].get(), 0);
+    }
+
+    // The buffer also carries other messages - the message ID is written again.
+    auto & [node, pos] = *it;
+    auto msg = new (&node->_send_buffer[pos]) common::LeaseAllocation{};
+    msg->lease_id = leases[i].lease_id;
+    msg->cores = leases[i].cores;
+    msg->memory = leases[i].memory;
+    ++pos;
+  }
+
+  for(auto & [node, count] : messages) {
+    rdmalib::ScatterGatherElement sge;
+    sge.add(node->_send_buffer, count);
+    node->_connection->post_send(
+      sge,
+      0,
+      count * sizeof(common::LeaseAllocation) <= _device.max_inline_data,
+      count
+    );
+  }
+
+  // Messages to different executor managers are in flight together.
+  for(auto & [node, count] : messages) {
+    node->_connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
+  }
+}
+
+void Manager::_add_client_handlers(
+  rdmalib::Reactor & reactor, rdmalib::Poller & poller, std::vector<Client*> & poll_send,
+  client_queue_t & queue, client_t & clients, bool forward
+)
+{
+  reactor.add_task([this, &queue, &clients]() {
+    int count = 0;
+    while(auto ptr = _check_queue(queue, false)) {
+      if (std::get<0>(*ptr) == Operation::CONNECT) {
+        _handle_client_connection(std::get<1>(std::get<1>(*ptr)), clients);
+      } else {
+        _handle_client_disconnection(std::get<0>(std::get<1>(*ptr)), clients);
+      }
+      ++count;
+    }
+    return count;
+  });
+
+  // Requests of our clients wait for released resources; the event arrives on every closed lease.
+  if(forward) {
+    reactor.add_fd(_lease_release_fd, [this, &poll_send, &clients]() {
+      int count = _process_lease_queue(clients, poll_send);
       for (auto client : poll_send) {
         client->connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
       }
       poll_send.clear();
-    }
+      return count;
+    });
+  }
 
-    if (removals.size()) {
-      for (auto it : removals) {
-        spdlog::info("Remove client id {}", it->second.client_id);
-        _clients.erase(it);
-      }
+  reactor.add_channel(poller, [this, &poller, &poll_send, &clients, forward]() {
+    auto [wcs, count] = poller.poll(false);
+    for (int j = 0; j < count; ++j) {
+      _handle_client_message(wcs[j], poll_send, clients, forward);
+    }
 
-      client_count -= removals.size();
-      removals.clear();
+    for (auto client : poll_send) {
+      client->connection->poll_wc(rdmalib::QueueType::SEND, true, 1);
     }
+    poll_send.clear();
+    return count;
+  });
+}
 
-  }
+void Manager::process_clients()
+{
+  rdmalib::Reactor reactor{_settings.rdma_spin_us};
+  rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(2))};
+  std::vector<Client*> poll_send;
+  _add_client_handlers(reactor, recv_poller, poll_send, _client_queue, _clients, true);
+  reactor.run(_shutdown, POLLING_TIMEOUT_MS);
 
   spdlog::info("Background thread stops processing client events");
 }
 
+void Manager::process_peers()
+{
+  rdmalib::Reactor reactor{_settings.rdma_spin_us};
+  rdmalib::Poller recv_poller{std::get<1>(*_state.shared_queue(ShardPeers::PEER_ID))};
+  std::vector<Client*> poll_send;
+  _add_client_handlers(reactor, recv_poller, poll_send, _peer_queue, _peer_clients, false);
+  reactor.run(_shutdown, POLLING_TIMEOUT_MS);
+
+  spdlog::info("Background thread stops processing requests of other shards");
+}
+
+void Manager::process_rdma()
+{
+  rdmalib::Reactor reactor{_settings.rdma_spin_us};
+  rdmalib::Poller client_poller{std::get<1>(*_state.shared_queue(2))};
+  rdmalib::Poller executor_poller{std::get<1>(*_state.shared_queue(1))};
+  std::vector<Client*> poll_send;
+  _add_executor_handlers(reactor, executor_poller);
+  _add_client_handlers(reactor, client_poller, poll_send, _client_queue, _clients, true);
+  reactor.run(_shutdown, POLLING_TIMEOUT_MS);
+
+  spdlog::info("Background thread stops processing client and executor events");
+}
+
 void Manager::process_events_sleep()
 {
   rdmalib::EventPoller event_poller;
@@ -426,6 +871,8 @@ void Manager::process_events_sleep()
 
   event_poller.add_channel(client_poller, 2);
   event_poller.add_channel(executor_poller, 1);
+  // Only wakes up the loop - waiting requests are processed below.
+  event_poller.add_fd(_lease_release_fd, 3);
 
   std::vector<Client*> poll_send;
 
@@ -440,9 +887,9 @@ void Manager::process_events_sleep()
 
       if(ptr) {
         if (std::get<0>(*ptr) == Operation::CONNECT) {
-          _handle_client_connection(std::get<1>(std::get<1>(*ptr)));
+          _handle_client_connection(std::get<1>(std::get<1>(*ptr)), _clients);
         } else {
-          _handle_client_disconnection(std::get<0>(std::get<1>(*ptr)));
+          _handle_client_disconnection(std::get<0>(std::get<1>(*ptr)), _clients);
         }
       }
 
@@ -477,7 +924,9 @@ void Manager::process_events_sleep()
 
     for(int i = 0; i < count; ++i) {
 
-      if(events[i].data.u32 == 2) {
+      if(events[i].data.u32 == 3) {
+        continue;
+      } else if(events[i].data.u32 == 2) {
 
         queue_client();
 
@@ -488,7 +937,7 @@ void Manager::process_events_sleep()
         auto wcs = client_poller.poll(false);
         if(std::get<1>(wcs)) {
           for (int j = 0; j < std::get<1>(wcs); ++j) {
-            _handle_client_message(std::get<0>(wcs)[j], poll_send);
+            _handle_client_message(std::get<0>(wcs)[j], poll_send, _clients, true);
           }
         }
 
@@ -513,6 +962,8 @@ void Manager::process_events_sleep()
 
     queue_client();
     queue_executor();
+    _check_liveness();
+    _process_lease_queue(_clients, poll_send);
 
     if (poll_send.size()) {
       for (auto client : poll_send) {
@@ -530,6 +981,16 @@ void Manager::shutdown() {
   _http_server.stop();
 }
 
+bool Manager::open_state(const std::string &directory) {
+  _journal = std::make_unique<StateJournal>(directory);
+  if (!_executor_data.recover(*_journal)) {
+    _journal.reset();
+    return false;
+  }
+  _journal->start();
+  return true;
+}
+
 void Manager::read_database(const std::string &path) {
   _executor_data.read(path);
 }
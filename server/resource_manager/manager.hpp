@@ -9,9 +9,11 @@
 #include <vector>
 #include <mutex>
 #include <map>
+#include <memory>
 #include <optional>
 
 #include <rdmalib/connection.hpp>
+#include <rdmalib/poller.hpp>
 #include <rdmalib/rdmalib.hpp>
 #include <rdmalib/server.hpp>
 #include <rdmalib/buffer.hpp>
@@ -19,10 +21,14 @@
 #include <rfaas/devices.hpp>
 
 #include "common/readerwriterqueue.h"
+#include "capacity_table.hpp"
 #include "client.hpp"
 #include "db.hpp"
 #include "http.hpp"
+#include "lease_queue.hpp"
+#include "liveness.hpp"
 #include "settings.hpp"
+#include "shards.hpp"
 
 namespace rdmalib {
   struct AllocationRequest;
@@ -34,6 +40,7 @@ namespace rfaas::resource_manager {
     std::string json_config;
     std::string initial_database;
     std::string output_database;
+    std::string state_directory;
     std::string device_database;
     bool verbose;
   };
@@ -65,6 +72,17 @@ namespace rfaas::resource_manager {
 
     typedef std::unordered_map<uint32_t, Client> client_t;
     client_t _clients;
+    // Requests of our clients waiting for resources, and the last release they were tried with.
+    LeaseQueue _lease_queue;
+    uint64_t _lease_queue_released;
+    // Set while requests wait; closed leases then wake up the thread handling clients.
+    std::atomic<bool> _lease_waiting;
+    // The event is read only when signaled - the handler runs on every reactor iteration.
+    std::atomic<bool> _lease_signaled;
+    int _lease_release_fd;
+    // Other shards forwarding requests, handled on their own thread.
+    client_queue_t _peer_queue;
+    client_t _peer_clients;
     int _client_id;
 
     rdmalib::RDMAPassive _state;
@@ -73,10 +91,16 @@ namespace rfaas::resource_manager {
 
     Executors _executors;
     ExecutorDB _executor_data;
+    std::unique_ptr<StateJournal> _journal;
+    LivenessTable _liveness;
+    CapacityTable _capacity_table;
+    std::chrono::steady_clock::time_point _next_liveness_check;
 
     // Handling HTTP events
     HTTPServer _http_server;
 
+    ShardPeers _shards;
+
     // configuration parameters
     Settings _settings;
     static constexpr int POLLING_TIMEOUT_MS = 100;
@@ -84,7 +108,10 @@ namespace rfaas::resource_manager {
     uint32_t _secret;
 
     Manager(Settings &);
+    ~Manager();
 
+    // Recovers nodes and leases, and persists their changes from now on.
+    bool open_state(const std::string & directory);
     void read_database(const std::string & name);
     void set_database_path(const std::string & name);
     void dump_database();
@@ -92,20 +119,50 @@ namespace rfaas::resource_manager {
     void shutdown();
 
     void listen_rdma();
+    // Clients and executors on separate threads, or together on one.
     void process_clients();
     void process_executors();
+    void process_peers();
+    void process_rdma();
     void process_events_sleep();
   private:
     void _handle_message(ibv_wc& wc);
     std::tuple<Manager::Operation, exec_msg_t>* _check_queue(executor_queue_t& queue, bool sleep);
     std::tuple<Manager::Operation, client_msg_t>* _check_queue(client_queue_t& queue, bool sleep);
 
+    void _add_executor_handlers(rdmalib::Reactor & reactor, rdmalib::Poller & poller);
+    // Requests of other shards are not forwarded again.
+    void _add_client_handlers(
+      rdmalib::Reactor & reactor, rdmalib::Poller & poller, std::vector<Client*> & poll_send,
+      client_queue_t & queue, client_t & clients, bool forward
+    );
+
     void _handle_executor_disconnection(rdmalib::Connection* conn);
     void _handle_executor_connection(std::shared_ptr<Executor> && exec);
-
-    void _handle_client_message(ibv_wc& wc, std::vector<Client*>& poll_send);
-    void _handle_client_connection(Client & client);
-    void _handle_client_disconnection(rdmalib::Connection* conn);
+    // Sends the heartbeat slot to a registered executor manager.
+    void _start_heartbeats(uint32_t qp_num);
+    void _delegate_cores(uint32_t qp_num);
+    // Reclaims leases of nodes without heartbeats; runs at most once per heartbeat period.
+    int _check_liveness();
+    // Asks a revived executor manager for leases it still holds; the node stays suspended until it replies.
+    void _request_lease_report(Executor & exec);
+
+    void _handle_client_message(ibv_wc& wc, std::vector<Client*>& poll_send, client_t & clients, bool forward);
+    // Places the lease and fills the client's response; returns the number of nodes.
+    int _open_lease(Client & client, const rfaas::LeaseRequest & request, bool forward);
+    void _send_lease(Client & client, int nodes);
+    // Releases a lease granted to another shard after it stopped waiting, and drops it on the executor manager.
+    void _cancel_lease(int32_t lease_id);
+    // Returns false when the request can't wait.
+    bool _queue_lease(Client & client, const rfaas::LeaseRequest & request);
+    // Grants waiting requests after resources were released, and answers expired ones.
+    int _process_lease_queue(client_t & clients, std::vector<Client*> & poll_send);
+    // Requests of a batch are answered together, each on a single node.
+    void _handle_lease_batch(Client & client, const rfaas::LeaseRequest* requests, int count, bool forward);
+    // Sends one message with all of its allocations to each executor manager.
+    void _notify_executors(const std::vector<std::shared_ptr<Executor>> & nodes, const rfaas::LeasedNode* leases);
+    void _handle_client_connection(Client & client, client_t & clients);
+    void _handle_client_disconnection(rdmalib::Connection* conn, client_t & clients);
   };
 
 }
@@ -16,6 +16,7 @@ namespace rfaas::resource_manager {
       ("i,input-database", "JSON with initial data of clients.",
        cxxopts::value<std::string>()->default_value(""))
       ("o,output-database", "Write and update JSON with data of clients.", cxxopts::value<std::string>()->default_value(""))
+      ("s,state-directory", "Directory with the persistent state of nodes and leases.", cxxopts::value<std::string>()->default_value(""))
       ("rdma-threads", "Threads handling RDMA requests.", cxxopts::value<int>())
       ("device-database", "JSON configuration of devices.", cxxopts::value<std::string>())
       ("v,verbose", "Verbose output", cxxopts::value<bool>()->default_value("false"))
@@ -32,6 +33,7 @@ namespace rfaas::resource_manager {
     result.json_config = parsed_options["config"].as<std::string>();
     result.initial_database = parsed_options["input-database"].as<std::string>();
     result.output_database = parsed_options["output-database"].as<std::string>();
+    result.state_directory = parsed_options["state-directory"].as<std::string>();
     result.device_database = parsed_options["device-database"].as<std::string>();
     result.verbose = parsed_options["verbose"].as<bool>();
     return result;
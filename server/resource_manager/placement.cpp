@@ -0,0 +1,99 @@
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+#include "placement.hpp"
+
+namespace rfaas::resource_manager {
+
+  constexpr int LibraryAffinityPlacement::NODES_PER_LIBRARY;
+
+  std::unique_ptr<PlacementPolicy> PlacementPolicy::create(const std::string & name, CapacityIndex & index)
+  {
+    if(name == "best-fit")
+      return std::make_unique<BestFitPlacement>(index);
+    else if(name == "spread")
+      return std::make_unique<SpreadPlacement>(index);
+    else if(name == "socket-fit")
+      return std::make_unique<SocketFitPlacement>(index);
+    else if(name == "library-affinity")
+      return std::make_unique<LibraryAffinityPlacement>(index);
+
+    spdlog::error("Unknown placement policy {}!", name);
+    throw std::runtime_error{"Unknown placement policy!"};
+  }
+
+  std::shared_ptr<Executor> BestFitPlacement::place(Lease & lease, uint64_t)
+  {
+    return _index.lease(lease, CapacityIndex::Order::BEST_FIT);
+  }
+
+  std::shared_ptr<Executor> SpreadPlacement::place(Lease & lease, uint64_t)
+  {
+    return _index.lease(lease, CapacityIndex::Order::WORST_FIT);
+  }
+
+  std::shared_ptr<Executor> SocketFitPlacement::place(Lease & lease, uint64_t)
+  {
+    int cores = lease.cores;
+    auto node = _index.lease(
+      lease, CapacityIndex::Order::BEST_FIT,
+      [cores](const Executor & exec) { return exec.free_socket_cores() >= cores; }
+    );
+    if(node)
+      return node;
+    SPDLOG_DEBUG("No node fits {} cores on a single socket", cores);
+    return _index.lease(lease, CapacityIndex::Order::BEST_FIT);
+  }
+
+  std::shared_ptr<Executor> LibraryAffinityPlacement::place(Lease & lease, uint64_t library_hash)
+  {
+    if(!library_hash)
+      return _index.lease(lease, CapacityIndex::Order::BEST_FIT);
+
+    std::vector<std::shared_ptr<Executor>> nodes;
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      auto it = _locations.find(library_hash);
+      if(it != _locations.end()) {
+        for(auto node = (*it).second.rbegin(); node != (*it).second.rend(); ++node)
+          if(auto ptr = (*node).lock())
+            nodes.push_back(std::move(ptr));
+      }
+    }
+
+    for(auto & node : nodes) {
+      if(_index.lease(node, lease)) {
+        SPDLOG_DEBUG("Node {} holds library {:x}", node->node, library_hash);
+        _record(library_hash, node);
+        return node;
+      }
+    }
+
+    auto node = _index.lease(lease, CapacityIndex::Order::BEST_FIT);
+    if(node)
+      _record(library_hash, node);
+    return node;
+  }
+
+  void LibraryAffinityPlacement::_record(uint64_t library_hash, const std::shared_ptr<Executor> & node)
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    auto & nodes = _locations[library_hash];
+    nodes.erase(
+      std::remove_if(nodes.begin(), nodes.end(),
+        [&node](const std::weak_ptr<Executor> & ptr) {
+          auto locked = ptr.lock();
+          return !locked || locked == node;
+        }
+      ),
+      nodes.end()
+    );
+    nodes.push_back(node);
+    if(nodes.size() > NODES_PER_LIBRARY)
+      nodes.erase(nodes.begin());
+  }
+
+}
@@ -0,0 +1,80 @@
+
+#ifndef __RFAAS_RESOURCE_MANAGER_PLACEMENT_HPP__
+#define __RFAAS_RESOURCE_MANAGER_PLACEMENT_HPP__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "capacity_index.hpp"
+#include "executor.hpp"
+
+namespace rfaas { namespace resource_manager {
+
+  // Chooses the node of a new lease among the nodes of the capacity index.
+  // Selected in the settings with "placement-policy".
+  struct PlacementPolicy
+  {
+    PlacementPolicy(CapacityIndex & index):
+      _index(index)
+    {}
+    virtual ~PlacementPolicy() = default;
+
+    // Returns the node with resources of the lease already taken, nullptr when no node fits.
+    // The library hash is zero when the client didn't send it.
+    virtual std::shared_ptr<Executor> place(Lease & lease, uint64_t library_hash) = 0;
+
+    // Accepts "best-fit", "spread", "socket-fit", and "library-affinity".
+    static std::unique_ptr<PlacementPolicy> create(const std::string & name, CapacityIndex & index);
+
+  protected:
+    CapacityIndex & _index;
+  };
+
+  // Fullest node that fits - keeps whole nodes free for large leases.
+  struct BestFitPlacement : PlacementPolicy
+  {
+    using PlacementPolicy::PlacementPolicy;
+    std::shared_ptr<Executor> place(Lease & lease, uint64_t library_hash) override;
+  };
+
+  // Emptiest node - leases share nodes with fewer neighbors.
+  struct SpreadPlacement : PlacementPolicy
+  {
+    using PlacementPolicy::PlacementPolicy;
+    std::shared_ptr<Executor> place(Lease & lease, uint64_t library_hash) override;
+  };
+
+  // Best fit among nodes where the lease fits on a single socket,
+  // and across sockets only when no such node is available.
+  struct SocketFitPlacement : PlacementPolicy
+  {
+    using PlacementPolicy::PlacementPolicy;
+    std::shared_ptr<Executor> place(Lease & lease, uint64_t library_hash) override;
+  };
+
+  // Nodes that recently received leases of the same library come first - their
+  // executor manager has the library cached and may keep an executor alive.
+  // Best fit otherwise.
+  struct LibraryAffinityPlacement : PlacementPolicy
+  {
+    static constexpr int NODES_PER_LIBRARY = 8;
+
+    using PlacementPolicy::PlacementPolicy;
+    std::shared_ptr<Executor> place(Lease & lease, uint64_t library_hash) override;
+
+  private:
+    std::mutex _mutex;
+    // Most recently used node last.
+    std::unordered_map<uint64_t, std::vector<std::weak_ptr<Executor>>> _locations;
+
+    void _record(uint64_t library_hash, const std::shared_ptr<Executor> & node);
+  };
+
+}}
+
+#endif
+
@@ -4,13 +4,29 @@
 #define __RFAAS_RESOURCE_MANAGER_SETTINGS_HPP__
 
 #include <string>
+#include <vector>
 
 #include <rfaas/devices.hpp>
 
 #include <cereal/details/helpers.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
 
 namespace rfaas::resource_manager {
 
+  // RDMA address of a resource manager shard.
+  struct ShardAddress
+  {
+    std::string address;
+    int port;
+
+    template <class Archive>
+    void serialize(Archive & ar)
+    {
+      ar(CEREAL_NVP(address), CEREAL_NVP(port));
+    }
+  };
+
   // Manager configuration settings.
   // Includes the RDMA connection, and the HTTP connection.
   struct Settings
@@ -22,9 +38,30 @@ namespace rfaas::resource_manager {
     std::string http_network_address;
     uint16_t http_network_port;
 
+    // One thread handles clients and executors, or each gets its own.
     int rdma_threads;
     uint32_t rdma_secret;
     bool rdma_sleep;
+    // Polling continues for this time after the last event, then the thread blocks.
+    int rdma_spin_us;
+    // See PlacementPolicy::create.
+    std::string placement_policy;
+    // All shards of the resource manager, including this one at shard_id.
+    // Empty when a single manager owns all nodes.
+    std::vector<ShardAddress> shards;
+    int shard_id;
+    // Executor managers send heartbeats with this period.
+    int heartbeat_ms;
+    // Leases of a node are reclaimed when its heartbeats stop for this long,
+    // and leases not claimed by a client in this time are returned. Zero disables both.
+    int lease_ttl_ms;
+    // Cores of each node delegated to the capacity table for one-sided leases of clients.
+    // Zero disables the table.
+    int direct_cores;
+    // Lease requests that can't be placed wait for released resources up to this time,
+    // and at most lease_queue_size of them at once. Zero disables waiting.
+    int max_lease_wait_ms;
+    int lease_queue_size;
 
     template <class Archive>
     void load(Archive & ar )
@@ -34,6 +71,15 @@ namespace rfaas::resource_manager {
         cereal::make_nvp("rdma-threads", rdma_threads),
         cereal::make_nvp("rdma-secret", rdma_secret),
         cereal::make_nvp("rdma-sleep", rdma_sleep),
+        cereal::make_nvp("rdma-spin-us", rdma_spin_us),
+        cereal::make_nvp("placement-policy", placement_policy),
+        cereal::make_nvp("shards", shards),
+        cereal::make_nvp("shard-id", shard_id),
+        cereal::make_nvp("heartbeat-ms", heartbeat_ms),
+        cereal::make_nvp("lease-ttl-ms", lease_ttl_ms),
+        cereal::make_nvp("direct-cores", direct_cores),
+        cereal::make_nvp("max-lease-wait-ms", max_lease_wait_ms),
+        cereal::make_nvp("lease-queue-size", lease_queue_size),
         CEREAL_NVP(http_network_address), CEREAL_NVP(http_network_port)
       );
     }
@@ -0,0 +1,211 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+
+#include <spdlog/spdlog.h>
+
+#include <rdmalib/connection.hpp>
+
+#include "shards.hpp"
+
+namespace rfaas::resource_manager {
+
+  constexpr int ShardPeers::PEER_ID;
+  constexpr int ShardPeers::RESPONSE_TIMEOUT_MS;
+  constexpr int ShardPeers::RETRY_MS;
+  constexpr int ShardPeers::MAX_LATE_RESPONSES;
+
+  ShardPeers::ShardPeers(const Settings & settings):
+    _secret(0),
+    _device(*settings.device),
+    _shutdown(false)
+  {
+    rdmalib::PrivateData data;
+    data.secret(settings.rdma_secret);
+    data.key(PEER_ID);
+    _secret = data.data();
+
+    // Peers are tried in order, starting with the next shard.
+    int shards = settings.shards.size();
+    for(int i = 1; i < shards; ++i) {
+      auto peer = std::make_unique<Peer>();
+      peer->address = settings.shards[(settings.shard_id + i) % shards];
+      peer->connected.store(false);
+      peer->late = 0;
+      _peers.push_back(std::move(peer));
+    }
+  }
+
+  bool ShardPeers::empty() const
+  {
+    return _peers.empty();
+  }
+
+  void ShardPeers::start()
+  {
+    if(!_peers.empty())
+      _connector = std::thread(&ShardPeers::_connect_peers, this);
+  }
+
+  int ShardPeers::steal(const rfaas::LeaseRequest & request, rfaas::LeaseResponse & response)
+  {
+    for(auto & peer : _peers) {
+
+      int nodes = _request(*peer, request, response);
+      if(nodes > 0) {
+        spdlog::info(
+          "[Manager] Lease {} with {} cores placed by shard {}:{}",
+          response.lease_id, request.cores, peer->address.address, peer->address.port
+        );
+        return nodes;
+      }
+    }
+    return 0;
+  }
+
+  void ShardPeers::disconnect()
+  {
+    {
+      std::lock_guard<std::mutex> lock{_connector_mutex};
+      _shutdown = true;
+    }
+    _connector_wakeup.notify_all();
+    if(_connector.joinable())
+      _connector.join();
+
+    for(auto & peer : _peers) {
+      if(peer->connection) {
+        peer->connection->disconnect();
+        peer->connection.reset();
+      }
+    }
+  }
+
+  void ShardPeers::_connect_peers()
+  {
+    // Shards start independently - peers are connected again until they accept.
+    std::unique_lock<std::mutex> lock{_connector_mutex};
+    while(!_shutdown) {
+      lock.unlock();
+      for(auto & peer : _peers) {
+        if(!peer->connected.load(std::memory_order_acquire))
+          _connect(*peer);
+      }
+      lock.lock();
+      _connector_wakeup.wait_for(lock, std::chrono::milliseconds(RETRY_MS));
+    }
+  }
+
+  bool ShardPeers::_connect(Peer & peer)
+  {
+    // Requests stopped using the failed connection before they cleared the flag.
+    peer.connection.reset();
+
+    auto conn = std::make_unique<rfaas::resource_mgr_connection>(
+      peer.address.address, peer.address.port,
+      _device.default_receive_buffer_size, _device.max_inline_data
+    );
+    if(!conn->connect(_secret)) {
+      spdlog::warn("Couldn't connect to shard {}:{}", peer.address.address, peer.address.port);
+      return false;
+    }
+    peer.connection = std::move(conn);
+    peer.late = 0;
+    peer.retry = std::chrono::steady_clock::time_point{};
+    peer.connected.store(true, std::memory_order_release);
+    SPDLOG_DEBUG("Connected to shard {}:{}", peer.address.address, peer.address.port);
+    return true;
+  }
+
+  int ShardPeers::_request(Peer & peer, const rfaas::LeaseRequest & request, rfaas::LeaseResponse & response)
+  {
+    if(!peer.connected.load(std::memory_order_acquire))
+      return 0;
+
+    // Late responses are released even while the peer is skipped.
+    auto now = std::chrono::steady_clock::now();
+    if(now < peer.retry) {
+      if(peer.late > 0)
+        _receive(peer, now, response);
+      return 0;
+    }
+
+    peer.connection->request() = request;
+    peer.connection->submit();
+
+    int nodes = _receive(peer, now + std::chrono::milliseconds(RESPONSE_TIMEOUT_MS), response);
+    if(nodes >= 0 || !peer.connected.load(std::memory_order_relaxed))
+      return std::max(nodes, 0);
+
+    spdlog::error("No response from shard {}:{}, skipping it for {} ms", peer.address.address, peer.address.port, RETRY_MS);
+    peer.retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(RETRY_MS);
+    if(++peer.late > MAX_LATE_RESPONSES) {
+      spdlog::error("Shard {}:{} doesn't answer, connecting again", peer.address.address, peer.address.port);
+      _fail(peer);
+    }
+    return 0;
+  }
+
+  int ShardPeers::_receive(Peer & peer, std::chrono::steady_clock::time_point end, rfaas::LeaseResponse & response)
+  {
+    rdmalib::Connection & conn = peer.connection->connection();
+    std::vector<int32_t> cancelled;
+    int nodes = -1;
+    while(nodes == -1) {
+
+      auto [wcs, count] = conn.poll_wc(rdmalib::QueueType::RECV, false);
+      for(int i = 0; i < count; ++i) {
+
+        if(wcs[i].status != IBV_WC_SUCCESS) {
+          spdlog::error("Failed response from shard {}:{}, connecting again", peer.address.address, peer.address.port);
+          _fail(peer);
+          return -1;
+        }
+
+        int received = ntohl(wcs[i].imm_data);
+        const rfaas::LeaseResponse & lease = peer.connection->response(wcs[i].wr_id);
+        if(peer.late > 0) {
+          --peer.late;
+          for(int j = 0; j < received; ++j)
+            cancelled.push_back(lease.nodes[j].lease_id);
+        } else {
+          nodes = received;
+          if(nodes > 0)
+            memcpy(&response, &lease, sizeof(rfaas::LeaseResponse));
+        }
+      }
+      if(count > 0) {
+        conn.receive_wcs().update_requests(-count);
+        conn.receive_wcs().refill();
+      }
+
+      if(nodes == -1 && std::chrono::steady_clock::now() >= end)
+        break;
+    }
+
+    _cancel(peer, cancelled);
+    return nodes;
+  }
+
+  void ShardPeers::_cancel(Peer & peer, const std::vector<int32_t> & leases)
+  {
+    for(int32_t lease_id : leases) {
+      spdlog::warn("Shard {}:{} granted lease {} too late, cancelling it", peer.address.address, peer.address.port, lease_id);
+      rfaas::LeaseRequest & request = peer.connection->request();
+      request = rfaas::LeaseRequest{};
+      request.cores = rfaas::LeaseRequest::CANCEL;
+      request.lease_id = lease_id;
+      peer.connection->submit();
+    }
+  }
+
+  void ShardPeers::_fail(Peer & peer)
+  {
+    peer.late = 0;
+    peer.connected.store(false, std::memory_order_release);
+    _connector_wakeup.notify_one();
+  }
+
+}
@@ -0,0 +1,84 @@
+
+#ifndef __RFAAS_RESOURCE_MANAGER_SHARDS_HPP__
+#define __RFAAS_RESOURCE_MANAGER_SHARDS_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <rfaas/allocation.hpp>
+#include <rfaas/connection.hpp>
+#include <rfaas/devices.hpp>
+
+#include "settings.hpp"
+
+namespace rfaas::resource_manager {
+
+  // Connections to the other shards of the resource manager.
+  // Each shard owns the executor managers registered with it, and a request that
+  // doesn't fit its nodes is forwarded to the peers, which place it on their own nodes.
+  // The owner of the node receives the lease deallocation from its executor manager.
+  // Peers answer forwarded requests on a separate thread and never forward them again,
+  // so two shards waiting for each other can't deadlock.
+  // Peers answer in the order of requests - a response arriving after we stopped waiting
+  // is recognized by its position, and its leases are cancelled on the peer.
+  struct ShardPeers
+  {
+    // Connection key of shards, next to executor managers (1) and clients (2).
+    static constexpr int PEER_ID = 3;
+    static constexpr int RESPONSE_TIMEOUT_MS = 100;
+    // Unreachable peers are connected again, and slow peers skipped, for this time.
+    static constexpr int RETRY_MS = 1000;
+    // Peers with more unanswered requests are connected again.
+    static constexpr int MAX_LATE_RESPONSES = 8;
+
+    ShardPeers(const Settings & settings);
+
+    bool empty() const;
+    // Peers are connected on a background thread, and skipped by requests until then.
+    void start();
+    // Tries each connected peer once, starting after this shard.
+    // Returns the number of leased nodes, and 0 when no peer could satisfy the request.
+    int steal(const rfaas::LeaseRequest & request, rfaas::LeaseResponse & response);
+    void disconnect();
+
+  private:
+    struct Peer
+    {
+      ShardAddress address;
+      std::unique_ptr<rfaas::resource_mgr_connection> connection;
+      // The connection is used by the connecting thread until set, and by requests until cleared.
+      std::atomic<bool> connected;
+      // Requests whose response didn't arrive in time.
+      int late;
+      std::chrono::steady_clock::time_point retry;
+    };
+
+    std::vector<std::unique_ptr<Peer>> _peers;
+    uint32_t _secret;
+    rfaas::device_data & _device;
+    std::thread _connector;
+    std::mutex _connector_mutex;
+    std::condition_variable _connector_wakeup;
+    bool _shutdown;
+
+    void _connect_peers();
+    bool _connect(Peer & peer);
+    int _request(Peer & peer, const rfaas::LeaseRequest & request, rfaas::LeaseResponse & response);
+    // Returns the number of nodes in the response to the last request, and -1 when it didn't arrive in time.
+    // Late responses to earlier requests are cancelled.
+    int _receive(Peer & peer, std::chrono::steady_clock::time_point end, rfaas::LeaseResponse & response);
+    void _cancel(Peer & peer, const std::vector<int32_t> & leases);
+    // The connection is released and connected again by the background thread.
+    void _fail(Peer & peer);
+  };
+
+}
+
+#endif
+
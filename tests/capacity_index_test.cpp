@@ -0,0 +1,163 @@
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "resource_manager/capacity_index.hpp"
+#include "nodes.hpp"
+
+#include <gtest/gtest.h>
+
+using rfaas::resource_manager::CapacityIndex;
+using rfaas::resource_manager::Executor;
+using rfaas::resource_manager::Lease;
+
+class CapacityIndexTest : public ::testing::Test {
+
+protected:
+  TestNodes _nodes;
+  CapacityIndex _index;
+
+  std::shared_ptr<Executor> add(const std::string & name, int cores, int memory, int sockets = 1)
+  {
+    auto node = _nodes.create(name, cores, memory, sockets);
+    _index.insert(node);
+    return node;
+  }
+};
+
+TEST_F(CapacityIndexTest, SearchOrder) {
+  auto small = add("small", 4, 100);
+  auto medium = add("medium", 8, 100);
+  auto large = add("large", 16, 100);
+
+  Lease best_fit{3, 10};
+  EXPECT_EQ(_index.lease(best_fit, CapacityIndex::Order::BEST_FIT), small);
+  EXPECT_EQ(best_fit.node.lock(), small);
+  EXPECT_EQ(small->_free_cores, 1);
+  EXPECT_EQ(small->_free_memory, 90);
+
+  Lease worst_fit{3, 10};
+  EXPECT_EQ(_index.lease(worst_fit, CapacityIndex::Order::WORST_FIT), large);
+
+  // Only the medium node has enough memory left after this lease.
+  Lease memory{2, 95};
+  EXPECT_EQ(_index.lease(memory, CapacityIndex::Order::BEST_FIT), medium);
+  EXPECT_EQ(_index.max_free_cores(), 13);
+}
+
+TEST_F(CapacityIndexTest, SkipsUnavailableNodes) {
+  auto full = add("full", 2, 100);
+  auto node = std::make_shared<Executor>("unconnected", "127.0.0.1", 10000, 8, 100, 1);
+  _index.insert(node);
+
+  Lease whole{2, 10};
+  EXPECT_EQ(_index.lease(whole), full);
+  // Fully leased nodes leave the index.
+  EXPECT_EQ(full->_bucket, -1);
+
+  Lease lease{1, 10};
+  EXPECT_EQ(_index.lease(lease), nullptr);
+
+  // The node is searched again once it connects.
+  _nodes.connect(*node);
+  EXPECT_EQ(_index.lease(lease), node);
+
+  _index.release(full, whole);
+  EXPECT_NE(full->_bucket, -1);
+  EXPECT_EQ(full->_free_cores, 2);
+}
+
+TEST_F(CapacityIndexTest, SuspendedNodes) {
+  auto node = add("node", 4, 100);
+  Lease lease{2, 10};
+  ASSERT_EQ(_index.lease(lease), node);
+
+  _index.suspend(node);
+  Lease other{1, 10};
+  EXPECT_EQ(_index.lease(other), nullptr);
+
+  // Releases return resources without indexing the node.
+  _index.release(node, lease);
+  EXPECT_EQ(node->_free_cores, 4);
+  EXPECT_EQ(_index.lease(other), nullptr);
+
+  _index.resume(node);
+  EXPECT_EQ(_index.lease(other), node);
+}
+
+TEST_F(CapacityIndexTest, RestoreUnconnectedNode) {
+  auto node = std::make_shared<Executor>("recovered", "127.0.0.1", 10000, 4, 100, 1);
+  _index.insert(node);
+
+  Lease lease{3, 50};
+  EXPECT_TRUE(_index.restore(node, lease));
+  EXPECT_EQ(lease.node.lock(), node);
+  EXPECT_EQ(node->_free_cores, 1);
+
+  Lease too_large{2, 10};
+  EXPECT_FALSE(_index.restore(node, too_large));
+  EXPECT_EQ(node->_free_cores, 1);
+}
+
+// Threads lease and release more cores than the nodes have together.
+// Candidates taken by another thread are searched again, and nodes are never overcommitted.
+TEST_F(CapacityIndexTest, ConcurrentLeaseAndRelease) {
+  const int nodes_count = 4;
+  const int cores = 4;
+  const int threads_count = 12;
+  const int iterations = 20000;
+
+  std::vector<std::shared_ptr<Executor>> nodes;
+  std::vector<std::atomic<int>> held(nodes_count);
+  for(int i = 0; i < nodes_count; ++i) {
+    nodes.push_back(add("node" + std::to_string(i), cores, cores * 10, 2));
+    held[i] = 0;
+  }
+
+  std::atomic<int> leased{0};
+  std::atomic<bool> overcommitted{false};
+  std::vector<std::thread> threads;
+  for(int t = 0; t < threads_count; ++t) {
+    threads.emplace_back([&, t]() {
+      for(int i = 0; i < iterations; ++i) {
+
+        Lease lease{2, 10};
+        auto order = (i + t) % 2 ? CapacityIndex::Order::BEST_FIT : CapacityIndex::Order::WORST_FIT;
+        auto node = _index.lease(lease, order);
+        if(!node)
+          continue;
+
+        int idx = std::find(nodes.begin(), nodes.end(), node) - nodes.begin();
+        if(held[idx].fetch_add(lease.cores) + lease.cores > cores)
+          overcommitted = true;
+        leased.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+
+        held[idx].fetch_sub(lease.cores);
+        _index.release(node, lease);
+      }
+    });
+  }
+  for(auto & thread : threads)
+    thread.join();
+
+  EXPECT_FALSE(overcommitted);
+  EXPECT_GT(leased.load(), 0);
+
+  // Every node is indexed exactly once with all of its resources.
+  for(auto & node : nodes) {
+    EXPECT_EQ(node->_free_cores, cores);
+    EXPECT_EQ(node->_free_memory, cores * 10);
+    EXPECT_EQ(node->_free_socket_cores, std::vector<int>({2, 2}));
+  }
+  for(int i = 0; i < nodes_count; ++i) {
+    Lease whole{cores, cores * 10};
+    EXPECT_NE(_index.lease(whole), nullptr);
+  }
+  Lease lease{1, 1};
+  EXPECT_EQ(_index.lease(lease), nullptr);
+}
+
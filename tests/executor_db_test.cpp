@@ -0,0 +1,111 @@
+
+#include <set>
+#include <string>
+
+#include <rfaas/allocation.hpp>
+
+#include "resource_manager/db.hpp"
+#include "resource_manager/executor.hpp"
+#include "nodes.hpp"
+
+#include <gtest/gtest.h>
+
+using rfaas::resource_manager::Executor;
+using rfaas::resource_manager::ExecutorDB;
+using rfaas::resource_manager::Executors;
+
+class ExecutorDBTest : public ::testing::Test {
+
+protected:
+  TestNodes _nodes;
+  Executors _executors{nullptr};
+  ExecutorDB _db{_executors, "best-fit"};
+
+  std::shared_ptr<Executor> add(const std::string & name, int cores, int memory)
+  {
+    // Node names are padded to the length sent by executor managers.
+    std::string node_name = name;
+    node_name.resize(rfaas::server_data::NODE_NAME_LENGTH, '_');
+    EXPECT_EQ(_db.add(node_name, "127.0.0.1", 10000, cores, memory), ExecutorDB::ResultCode::OK);
+    auto node = _executors.get_executor(node_name);
+    _nodes.connect(*node);
+    return node;
+  }
+};
+
+TEST_F(ExecutorDBTest, SingleNode) {
+  auto small = add("small", 4, 100);
+  add("large", 16, 100);
+
+  rfaas::LeaseResponse response{};
+  auto nodes = _db.open_lease(4, 10, 0, 4, response);
+  ASSERT_EQ(nodes.size(), 1);
+  EXPECT_EQ(nodes[0], small);
+  EXPECT_EQ(response.lease_id, response.nodes[0].lease_id);
+  EXPECT_EQ(response.nodes[0].cores, 4);
+}
+
+TEST_F(ExecutorDBTest, SplitAcrossNodes) {
+  std::vector<std::shared_ptr<Executor>> added;
+  for(int i = 0; i < 3; ++i)
+    added.push_back(add("node" + std::to_string(i), 4, 100));
+
+  rfaas::LeaseResponse response{};
+  auto nodes = _db.open_lease(10, 30, 0, 4, response);
+  ASSERT_EQ(nodes.size(), 3);
+
+  // Largest parts first, and memory in proportion to the cores.
+  EXPECT_EQ(response.nodes[0].cores, 4);
+  EXPECT_EQ(response.nodes[1].cores, 4);
+  EXPECT_EQ(response.nodes[2].cores, 2);
+  EXPECT_EQ(response.nodes[0].memory, 12);
+  EXPECT_EQ(response.nodes[2].memory, 6);
+
+  std::set<int32_t> ids;
+  std::set<std::shared_ptr<Executor>> distinct{nodes.begin(), nodes.end()};
+  for(size_t i = 0; i < nodes.size(); ++i)
+    ids.insert(response.nodes[i].lease_id);
+  EXPECT_EQ(ids.size(), 3);
+  EXPECT_EQ(distinct.size(), 3);
+  EXPECT_EQ(response.lease_id, response.nodes[0].lease_id);
+
+  // Each part is closed on its own.
+  for(size_t i = 0; i < nodes.size(); ++i)
+    EXPECT_EQ(_db.cancel_lease(response.nodes[i].lease_id), nodes[i]);
+  for(auto & node : added)
+    EXPECT_EQ(node->_free_cores, 4);
+}
+
+TEST_F(ExecutorDBTest, SplitSmallerParts) {
+  // The largest part doesn't fit anywhere with its memory, and half of it goes to another node.
+  auto large = add("large", 4, 100);
+  auto low_memory = add("low_memory", 4, 3);
+  auto single = add("single", 1, 100);
+
+  rfaas::LeaseResponse response{};
+  auto nodes = _db.open_lease(6, 12, 0, 4, response);
+  ASSERT_EQ(nodes.size(), 3);
+  EXPECT_EQ(nodes[0], large);
+  EXPECT_EQ(nodes[1], single);
+  EXPECT_EQ(nodes[2], low_memory);
+  EXPECT_EQ(response.nodes[1].cores, 1);
+  EXPECT_EQ(response.nodes[2].cores, 1);
+}
+
+TEST_F(ExecutorDBTest, SplitReleasesPartsOnFailure) {
+  std::vector<std::shared_ptr<Executor>> added;
+  for(int i = 0; i < 3; ++i)
+    added.push_back(add("node" + std::to_string(i), 4, 100));
+
+  rfaas::LeaseResponse response{};
+  EXPECT_TRUE(_db.open_lease(10, 30, 0, 2, response).empty());
+  EXPECT_TRUE(_db.open_lease(16, 30, 0, 4, response).empty());
+  // Requests of a single node are not split.
+  EXPECT_TRUE(_db.open_lease(6, 30, 0, 1, response).empty());
+
+  for(auto & node : added) {
+    EXPECT_EQ(node->_free_cores, 4);
+    EXPECT_EQ(node->_free_memory, 100);
+  }
+}
+
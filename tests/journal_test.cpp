@@ -0,0 +1,183 @@
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "resource_manager/executor.hpp"
+#include "resource_manager/journal.hpp"
+
+#include <gtest/gtest.h>
+
+using rfaas::resource_manager::Executor;
+using rfaas::resource_manager::JournalRecord;
+using rfaas::resource_manager::StateJournal;
+
+class StateJournalTest : public ::testing::Test {
+
+protected:
+  std::string _directory;
+  Executor _node{"node", "127.0.0.1", 10000, 16, 1024, 1};
+
+  // State rebuilt by the resource manager during recovery.
+  std::set<std::string> _nodes;
+  std::set<int32_t> _leases;
+  int _opened;
+
+  void SetUp() override
+  {
+    char directory[] = "/tmp/rfaas_journal_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    _directory = directory;
+  }
+
+  void TearDown() override
+  {
+    unlink(path("journal.log").c_str());
+    unlink(path("snapshot.bin").c_str());
+    rmdir(_directory.c_str());
+  }
+
+  std::string path(const std::string & file) const
+  {
+    return _directory + "/" + file;
+  }
+
+  off_t size(const std::string & file) const
+  {
+    struct stat st;
+    return stat(path(file).c_str(), &st) ? -1 : st.st_size;
+  }
+
+  bool recover(StateJournal & journal)
+  {
+    _nodes.clear();
+    _leases.clear();
+    _opened = 0;
+    return journal.recover([this](const JournalRecord & record) {
+      switch(record.type)
+      {
+        case JournalRecord::Type::NODE_ADD:
+          _nodes.insert(record.node);
+        break;
+        case JournalRecord::Type::NODE_REMOVE:
+          _nodes.erase(record.node);
+        break;
+        case JournalRecord::Type::LEASE_OPEN:
+          _leases.insert(record.lease_id);
+          ++_opened;
+        break;
+        case JournalRecord::Type::LEASE_CLOSE:
+          _leases.erase(record.lease_id);
+        break;
+      }
+    });
+  }
+};
+
+TEST_F(StateJournalTest, ReplayAfterSnapshot) {
+  std::string old_log;
+  {
+    StateJournal journal{_directory};
+    ASSERT_TRUE(recover(journal));
+    journal.append(JournalRecord::node_added(_node));
+    for(int i = 0; i < 10; ++i)
+      journal.append(JournalRecord::lease_opened(i, _node, 1, 1));
+    journal.start();
+    journal.stop();
+
+    std::ifstream in{path("journal.log"), std::ios::binary};
+    old_log.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+    ASSERT_EQ(old_log.size(), 11 * sizeof(JournalRecord));
+  }
+
+  // Enough short leases to compact the log into a snapshot.
+  // Appended before the writer starts - it writes them in one batch, and the log is empty afterwards.
+  const int leases = StateJournal::SNAPSHOT_RECORDS / 2 + 10;
+  {
+    StateJournal journal{_directory};
+    ASSERT_TRUE(recover(journal));
+    EXPECT_EQ(_leases.size(), 10U);
+    for(int i = 10; i < 10 + leases; ++i) {
+      journal.append(JournalRecord::lease_opened(i, _node, 1, 1));
+      if(i >= 20)
+        journal.append(JournalRecord::lease_closed(i));
+    }
+    journal.start();
+    journal.stop();
+  }
+  ASSERT_GT(size("snapshot.bin"), 0);
+  EXPECT_EQ(size("journal.log"), 0);
+
+  // A crash before the log was truncated leaves records that are already in the snapshot.
+  {
+    std::ofstream out{path("journal.log"), std::ios::binary};
+    out.write(old_log.data(), old_log.size());
+  }
+
+  {
+    StateJournal journal{_directory};
+    ASSERT_TRUE(recover(journal));
+    EXPECT_EQ(_nodes.size(), 1U);
+    EXPECT_EQ(_leases.size(), 20U);
+    EXPECT_EQ(_opened, 20);
+    // IDs of closed leases are not handed out again.
+    EXPECT_EQ(journal.next_lease_id(), 10 + leases);
+
+    journal.append(JournalRecord::lease_opened(10 + leases, _node, 1, 1));
+    journal.append(JournalRecord::lease_closed(0));
+    journal.start();
+    journal.stop();
+  }
+
+  // Changes after the snapshot are replayed from the log.
+  StateJournal journal{_directory};
+  ASSERT_TRUE(recover(journal));
+  EXPECT_EQ(_leases.size(), 20U);
+  EXPECT_EQ(_leases.count(0), 0U);
+  EXPECT_EQ(_leases.count(10 + leases), 1U);
+  EXPECT_EQ(journal.next_lease_id(), 11 + leases);
+}
+
+TEST_F(StateJournalTest, TruncatedLog) {
+  {
+    StateJournal journal{_directory};
+    ASSERT_TRUE(recover(journal));
+    journal.append(JournalRecord::node_added(_node));
+    for(int i = 0; i < 3; ++i)
+      journal.append(JournalRecord::lease_opened(i, _node, 1, 1));
+    journal.start();
+    journal.stop();
+  }
+
+  // A record cut short by a crash.
+  {
+    JournalRecord record = JournalRecord::lease_opened(3, _node, 1, 1);
+    std::ofstream out{path("journal.log"), std::ios::binary | std::ios::app};
+    out.write(reinterpret_cast<const char*>(&record), sizeof(record) / 2);
+  }
+
+  {
+    StateJournal journal{_directory};
+    ASSERT_TRUE(recover(journal));
+    EXPECT_EQ(_nodes.size(), 1U);
+    EXPECT_EQ(_leases, std::set<int32_t>({0, 1, 2}));
+    EXPECT_EQ(journal.next_lease_id(), 3);
+    // The partial record is removed.
+    EXPECT_EQ(size("journal.log"), static_cast<off_t>(4 * sizeof(JournalRecord)));
+
+    journal.append(JournalRecord::lease_opened(3, _node, 1, 1));
+    journal.start();
+    journal.stop();
+  }
+
+  // New records are not hidden behind the partial one.
+  StateJournal journal{_directory};
+  ASSERT_TRUE(recover(journal));
+  EXPECT_EQ(_leases, std::set<int32_t>({0, 1, 2, 3}));
+}
+
@@ -0,0 +1,164 @@
+
+#include <chrono>
+#include <vector>
+
+#include <rfaas/allocation.hpp>
+
+#include "resource_manager/lease_queue.hpp"
+
+#include <gtest/gtest.h>
+
+using rfaas::resource_manager::LeaseQueue;
+
+namespace {
+
+  rfaas::LeaseRequest request(int16_t cores, int16_t priority = 0, int16_t weight = 1)
+  {
+    rfaas::LeaseRequest request{};
+    request.cores = cores;
+    request.memory = 1;
+    request.priority = priority;
+    request.weight = weight;
+    return request;
+  }
+
+  auto later(int ms = 3600 * 1000)
+  {
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  }
+
+}
+
+TEST(LeaseQueueTest, Priority) {
+  LeaseQueue queue{8};
+  ASSERT_TRUE(queue.push(1, request(1, 0), 0, later()));
+  ASSERT_TRUE(queue.push(2, request(1, 5), 0, later()));
+  ASSERT_TRUE(queue.push(3, request(1, 1), 0, later()));
+
+  std::vector<uint32_t> granted;
+  std::vector<LeaseQueue::Entry> expired;
+  int count = queue.process(
+    std::chrono::steady_clock::now(), true,
+    [&granted](const LeaseQueue::Entry & entry) { granted.push_back(entry.client); return true; },
+    expired
+  );
+  EXPECT_EQ(count, 3);
+  EXPECT_EQ(granted, std::vector<uint32_t>({2, 3, 1}));
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(expired.empty());
+}
+
+// Smaller requests of the same priority pass a request that doesn't fit, lower priorities wait for it.
+TEST(LeaseQueueTest, LowerPrioritiesWait) {
+  LeaseQueue queue{8};
+  ASSERT_TRUE(queue.push(1, request(4, 5), 0, later()));
+  ASSERT_TRUE(queue.push(2, request(1, 0), 0, later()));
+  ASSERT_TRUE(queue.push(3, request(1, 5), 10, later()));
+
+  int free_cores = 2;
+  std::vector<uint32_t> granted;
+  auto grant = [&](const LeaseQueue::Entry & entry) {
+    if(entry.request.cores > free_cores)
+      return false;
+    free_cores -= entry.request.cores;
+    granted.push_back(entry.client);
+    return true;
+  };
+
+  std::vector<LeaseQueue::Entry> expired;
+  EXPECT_EQ(queue.process(std::chrono::steady_clock::now(), true, grant, expired), 1);
+  EXPECT_EQ(granted, std::vector<uint32_t>({3}));
+  EXPECT_EQ(queue.size(), 2);
+  EXPECT_TRUE(queue.blocks(0));
+  EXPECT_FALSE(queue.blocks(5));
+
+  free_cores = 5;
+  EXPECT_EQ(queue.process(std::chrono::steady_clock::now(), true, grant, expired), 2);
+  EXPECT_EQ(granted, std::vector<uint32_t>({3, 1, 2}));
+  EXPECT_FALSE(queue.blocks(0));
+}
+
+// Clients of the same priority receive cores in proportion to their weights.
+TEST(LeaseQueueTest, FairShare) {
+  LeaseQueue queue{8};
+  double charges[] = {0, 0};
+  ASSERT_TRUE(queue.push(0, request(2, 0, 1), charges[0], later()));
+  ASSERT_TRUE(queue.push(1, request(2, 0, 2), charges[1], later()));
+
+  // One request fits at a time, and each client asks again once granted.
+  int grants[] = {0, 0};
+  std::vector<LeaseQueue::Entry> expired;
+  for(int i = 0; i < 6; ++i) {
+    std::vector<LeaseQueue::Entry> granted;
+    queue.process(
+      std::chrono::steady_clock::now(), true,
+      [&granted](const LeaseQueue::Entry & entry) {
+        if(!granted.empty())
+          return false;
+        granted.push_back(entry);
+        return true;
+      },
+      expired
+    );
+    ASSERT_EQ(granted.size(), 1U);
+    uint32_t client = granted[0].client;
+    grants[client] += 1;
+    charges[client] = granted[0].finish;
+    ASSERT_TRUE(queue.push(client, granted[0].request, charges[client], later()));
+  }
+  EXPECT_EQ(grants[0], 2);
+  EXPECT_EQ(grants[1], 4);
+}
+
+TEST(LeaseQueueTest, IdleClientsStartAtVirtualTime) {
+  LeaseQueue queue{8};
+  ASSERT_TRUE(queue.push(1, request(2), 10, later()));
+  std::vector<LeaseQueue::Entry> expired;
+  EXPECT_EQ(queue.process(std::chrono::steady_clock::now(), true, [](const LeaseQueue::Entry &) { return true; }, expired), 1);
+
+  // A client without leases doesn't go ahead of clients that waited.
+  EXPECT_DOUBLE_EQ(queue.charge(0, request(1)), 11);
+  EXPECT_DOUBLE_EQ(queue.charge(20, request(4, 0, 2)), 22);
+}
+
+TEST(LeaseQueueTest, Deadlines) {
+  LeaseQueue queue{8};
+  auto now = std::chrono::steady_clock::now();
+  ASSERT_TRUE(queue.push(1, request(1), 0, now + std::chrono::milliseconds(10)));
+  ASSERT_TRUE(queue.push(2, request(1), 0, now + std::chrono::hours(1)));
+
+  int calls = 0;
+  auto grant = [&calls](const LeaseQueue::Entry &) { ++calls; return false; };
+  std::vector<LeaseQueue::Entry> expired;
+
+  // Nothing was released and no deadline passed.
+  EXPECT_EQ(queue.process(now, false, grant, expired), 0);
+  EXPECT_TRUE(expired.empty());
+
+  // Requests are only expired when nothing was released.
+  EXPECT_EQ(queue.process(now + std::chrono::milliseconds(20), false, grant, expired), 0);
+  EXPECT_EQ(calls, 0);
+  ASSERT_EQ(expired.size(), 1U);
+  EXPECT_EQ(expired[0].client, 1U);
+  EXPECT_EQ(queue.size(), 1);
+
+  // Requests that don't fit expire as well.
+  expired.clear();
+  EXPECT_EQ(queue.process(now + std::chrono::hours(2), true, grant, expired), 0);
+  EXPECT_EQ(calls, 1);
+  ASSERT_EQ(expired.size(), 1U);
+  EXPECT_EQ(expired[0].client, 2U);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(LeaseQueueTest, SizeLimitAndRemoval) {
+  LeaseQueue queue{2};
+  EXPECT_TRUE(queue.push(1, request(1), 0, later()));
+  EXPECT_TRUE(queue.push(1, request(2), 0, later()));
+  EXPECT_FALSE(queue.push(2, request(1), 0, later()));
+
+  queue.remove(1);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(queue.push(2, request(1), 0, later()));
+}
+
@@ -0,0 +1,38 @@
+
+#ifndef __RFAAS_TESTS_NODES_HPP__
+#define __RFAAS_TESTS_NODES_HPP__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rdmalib/connection.hpp>
+
+#include "resource_manager/executor.hpp"
+
+// Executors of the resource manager without executor managers.
+// Nodes count as connected once they have a connection object, which is never initialized.
+struct TestNodes
+{
+  std::vector<std::unique_ptr<rdmalib::Connection>> _connections;
+
+  void connect(rfaas::resource_manager::Executor & node)
+  {
+    _connections.push_back(std::make_unique<rdmalib::Connection>(1));
+    node._connection = _connections.back().get();
+  }
+
+  std::shared_ptr<rfaas::resource_manager::Executor> create(
+    const std::string & name, int cores, int memory, int sockets = 1
+  )
+  {
+    auto node = std::make_shared<rfaas::resource_manager::Executor>(
+      name, "127.0.0.1", 10000, cores, memory, sockets
+    );
+    connect(*node);
+    return node;
+  }
+};
+
+#endif
+
@@ -0,0 +1,103 @@
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "resource_manager/capacity_index.hpp"
+#include "resource_manager/placement.hpp"
+#include "nodes.hpp"
+
+#include <gtest/gtest.h>
+
+using rfaas::resource_manager::CapacityIndex;
+using rfaas::resource_manager::Executor;
+using rfaas::resource_manager::Lease;
+using rfaas::resource_manager::PlacementPolicy;
+
+class PlacementTest : public ::testing::Test {
+
+protected:
+  TestNodes _nodes;
+  CapacityIndex _index;
+
+  std::shared_ptr<Executor> add(const std::string & name, int cores, int memory, int sockets = 1)
+  {
+    auto node = _nodes.create(name, cores, memory, sockets);
+    _index.insert(node);
+    return node;
+  }
+};
+
+TEST_F(PlacementTest, BestFit) {
+  auto policy = PlacementPolicy::create("best-fit", _index);
+  auto small = add("small", 4, 100);
+  auto large = add("large", 16, 100);
+
+  Lease lease{4, 10};
+  EXPECT_EQ(policy->place(lease, 0), small);
+  Lease next{1, 10};
+  EXPECT_EQ(policy->place(next, 0), large);
+}
+
+TEST_F(PlacementTest, Spread) {
+  auto policy = PlacementPolicy::create("spread", _index);
+  auto first = add("first", 8, 100);
+  auto second = add("second", 8, 100);
+
+  // Leases alternate between the nodes as their free cores change.
+  Lease lease{2, 10};
+  auto node = policy->place(lease, 0);
+  ASSERT_NE(node, nullptr);
+  Lease next{2, 10};
+  EXPECT_EQ(policy->place(next, 0), node == first ? second : first);
+  EXPECT_EQ(first->_free_cores, 6);
+  EXPECT_EQ(second->_free_cores, 6);
+}
+
+TEST_F(PlacementTest, SocketFit) {
+  auto policy = PlacementPolicy::create("socket-fit", _index);
+  // Best fit for six cores, but only across both sockets.
+  auto split = add("split", 8, 100, 2);
+  auto single = add("single", 12, 100, 2);
+
+  Lease lease{6, 10};
+  EXPECT_EQ(policy->place(lease, 0), single);
+  EXPECT_EQ(lease.sockets, std::vector<int>({6, 0}));
+
+  // No node fits the lease on a single socket anymore.
+  Lease spread{7, 10};
+  EXPECT_EQ(policy->place(spread, 0), split);
+  EXPECT_EQ(spread.sockets, std::vector<int>({4, 3}));
+  EXPECT_EQ(split->free_socket_cores(), 1);
+}
+
+TEST_F(PlacementTest, LibraryAffinity) {
+  auto policy = PlacementPolicy::create("library-affinity", _index);
+  auto small = add("small", 4, 100);
+  auto large = add("large", 16, 100);
+  const uint64_t library = 0x1234;
+
+  Lease first{6, 10};
+  EXPECT_EQ(policy->place(first, library), large);
+
+  // The node with the library is preferred over the best fit.
+  Lease second{2, 10};
+  EXPECT_EQ(policy->place(second, library), large);
+
+  // Other libraries and unknown libraries use the best fit.
+  Lease other{2, 10};
+  EXPECT_EQ(policy->place(other, library + 1), small);
+  Lease unknown{1, 10};
+  EXPECT_EQ(policy->place(unknown, 0), small);
+
+  // Best fit when the node with the library is full.
+  Lease rest{8, 10};
+  EXPECT_EQ(policy->place(rest, 0), large);
+  Lease last{1, 10};
+  EXPECT_EQ(policy->place(last, library), small);
+}
+
+TEST_F(PlacementTest, UnknownPolicy) {
+  EXPECT_THROW(PlacementPolicy::create("first-fit", _index), std::runtime_error);
+}
+